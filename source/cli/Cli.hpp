@@ -18,6 +18,12 @@
 // --cull_invalid
 // --recompute_normals off
 // --fuse_vertices on
+// --texture-cache <folder>
+// --cmpr-quality 1
+// --auto-texture-format
+//
+// cli.exe batch <manifest.jsonl>
+// --jobs 0
 //
 using bool32 = uint32_t;
 
@@ -37,6 +43,9 @@ enum {
   // SZS
   TYPE_EXTRACT,
   TYPE_CREATE,
+
+  // JSON lines manifest of the above
+  TYPE_BATCH,
 };
 
 template <size_t L> struct CFixedString {
@@ -66,6 +75,22 @@ struct CliOptions {
   bool32 no_tristrip = false;
   bool32 ai_json = false;
   bool32 verbose = false;
+
+  // TYPE_COMPRESS
+  uint32_t szs_level = 1;
+
+  // TYPE_BATCH: 0 for one job per core
+  uint32_t batch_jobs = 0;
+
+  // TYPE_IMPORT_BRRES: folder of encoded textures reused across imports.
+  // Empty to always encode.
+  CFixedString<256> texture_cache;
+
+  // TYPE_IMPORT_BRRES: librii::image::CmprQuality of CMPR textures
+  uint32_t cmpr_quality = 1;
+
+  // TYPE_IMPORT_BRRES: pick each texture's format from its content, not CMPR
+  bool32 auto_texture_format = false;
 };
 
 std::optional<CliOptions> parse(int argc, const char** argv);
@@ -5,7 +5,9 @@
 #include <librii/assimp/LRAssimp.hpp>
 #include <librii/assimp2rhst/Assimp.hpp>
 #include <librii/assimp2rhst/SupportedFiles.hpp>
+#include <librii/sched/TaskScheduler.hpp>
 #include <librii/szs/SZS.hpp>
+#include <librii/szs/SZSStream.hpp>
 #include <librii/u8/U8.hpp>
 #include <mutex>
 #include <plugins/g3d/G3dIo.hpp>
@@ -13,6 +15,7 @@
 #include <plugins/j3d/J3dIo.hpp>
 #include <plugins/rhst/RHSTImporter.hpp>
 #include <sstream>
+#include <vendor/nlohmann/json.hpp>
 
 namespace riistudio {
 const char* translateString(std::string_view str) { return str.data(); }
@@ -31,8 +34,12 @@ static void setFlag(u32& f, u32 m, bool sel) {
 }
 
 std::mutex s_progressLock;
+// Concurrent batch jobs would draw over each other's bars
+std::atomic<bool> s_progressEnabled = true;
 
 static void progress_put(std::string status, float percent, int barWidth = 70) {
+  if (!s_progressEnabled)
+    return;
   std::stringstream ss;
   ss << status;
   for (size_t i = status.size(); i < 32; ++i) {
@@ -55,13 +62,59 @@ static void progress_put(std::string status, float percent, int barWidth = 70) {
   std::cout.flush();
 }
 static void progress_end() {
+  if (!s_progressEnabled)
+    return;
   std::unique_lock g(s_progressLock);
   std::cout << std::endl;
 }
 
+// .rspreset files of a folder, keyed by material name
+using PresetMap =
+    std::unordered_map<std::string, librii::crate::CrateAnimation>;
+
+static PresetMap LoadPresets(const std::filesystem::path& folder) {
+  PresetMap presets;
+  for (auto it : std::filesystem::directory_iterator(folder)) {
+    if (it.path().extension() == ".rspreset") {
+      auto file = ReadFile(it.path().string());
+      if (!file) {
+        fmt::print(stderr, "Failed to read rspreset: {}\n",
+                   it.path().string());
+        continue;
+      }
+      auto preset = librii::crate::ReadRSPreset(*file);
+      if (!preset) {
+        fmt::print(stderr, "Failed to parse rspreset: {}\n",
+                   it.path().string());
+        continue;
+      }
+      presets[it.path().stem().string()] = *preset;
+    }
+  }
+  return presets;
+}
+
+// Shares parsed preset folders between the jobs of a batch
+class PresetCache {
+public:
+  std::shared_ptr<const PresetMap> get(const std::filesystem::path& folder) {
+    std::unique_lock g(m_lock);
+    auto& presets = m_presets[folder.lexically_normal().string()];
+    if (!presets) {
+      presets = std::make_shared<const PresetMap>(LoadPresets(folder));
+    }
+    return presets;
+  }
+
+private:
+  std::mutex m_lock;
+  std::map<std::string, std::shared_ptr<const PresetMap>> m_presets;
+};
+
 class ImportBRRES {
 public:
-  ImportBRRES(const CliOptions& opt) : m_opt(opt) {}
+  ImportBRRES(const CliOptions& opt, PresetCache* presets = nullptr)
+      : m_opt(opt), m_presetCache(presets) {}
 
   Result<void> execute() {
     if (m_opt.verbose) {
@@ -73,6 +126,11 @@ public:
     if (!librii::assimp2rhst::IsExtensionSupported(m_from.string())) {
       return std::unexpected("File format is unsupported");
     }
+    if (m_opt.cmpr_quality >
+        static_cast<u32>(librii::image::CmprQuality::Cluster)) {
+      return std::unexpected(
+          std::format("Invalid CMPR quality {}", m_opt.cmpr_quality));
+    }
     auto file = ReadFile(m_opt.from.view());
     if (!file.has_value()) {
       return std::unexpected("Failed to read file");
@@ -108,38 +166,31 @@ public:
       on_log(kpi::IOMessageClass::Information, c, v);
     };
     auto m_result = std::make_unique<riistudio::g3d::Collection>();
-    bool ok = riistudio::rhst::CompileRHST(*tree, *m_result, m_from.string(),
-                                           info, progress, !m_opt.no_tristrip,
-                                           m_opt.verbose);
+    std::optional<riistudio::rhst::TextureCache> texture_cache;
+    if (!m_opt.texture_cache.view().empty()) {
+      texture_cache.emplace(std::string{m_opt.texture_cache.view()});
+    }
+    bool ok = riistudio::rhst::CompileRHST(
+        *tree, *m_result, m_from.string(), info, progress, !m_opt.no_tristrip,
+        m_opt.verbose, texture_cache ? &*texture_cache : nullptr,
+        static_cast<librii::image::CmprQuality>(m_opt.cmpr_quality),
+        m_opt.auto_texture_format);
     if (!ok) {
       return std::unexpected("Failed to parse RHST");
     }
-    std::unordered_map<std::string, librii::crate::CrateAnimation> presets;
     if (std::filesystem::exists(m_presets) &&
         std::filesystem::is_directory(m_presets)) {
-      for (auto it : std::filesystem::directory_iterator(m_presets)) {
-        if (it.path().extension() == ".rspreset") {
-          auto file = ReadFile(it.path().string());
-          if (!file) {
-            fmt::print(stderr, "Failed to read rspreset: {}\n",
-                       it.path().string());
-            continue;
-          }
-          auto preset = librii::crate::ReadRSPreset(*file);
-          if (!preset) {
-            fmt::print(stderr, "Failed to parse rspreset: {}\n",
-                       it.path().string());
-            continue;
-          }
-          presets[it.path().stem().string()] = *preset;
-        }
-      }
+      auto presets = m_presetCache != nullptr
+                         ? m_presetCache->get(m_presets)
+                         : std::make_shared<const PresetMap>(
+                               LoadPresets(m_presets));
       auto& mdl = m_result->getModels()[0];
       for (size_t i = 0; i < mdl.getMaterials().size(); ++i) {
         auto& target_mat = mdl.getMaterials()[i];
-        if (!presets.contains(target_mat.name))
+        auto it = presets->find(target_mat.name);
+        if (it == presets->end())
           continue;
-        auto& source_mat = presets[target_mat.name];
+        auto& source_mat = it->second;
         auto ok =
             riistudio::g3d::ApplyCratePresetToMaterial(target_mat, source_mat);
         if (!ok) {
@@ -218,11 +269,60 @@ private:
   }
 
   CliOptions m_opt;
+  PresetCache* m_presetCache = nullptr;
   std::filesystem::path m_from;
   std::filesystem::path m_to;
   std::filesystem::path m_presets;
 };
 
+// Read size for the streaming SZS commands
+static constexpr size_t StreamChunkSize = 0x10000;
+
+// Streams into "<path>.tmp", which only replaces |path| on commit(). Until
+// then |path| is untouched, so a failed job never leaves a truncated file and
+// the input may be the output. The temporary is removed if not committed.
+class PendingFile {
+public:
+  explicit PendingFile(const std::filesystem::path& path)
+      : m_path(path), m_tmp(path) {
+    m_tmp += ".tmp";
+    m_stream.open(m_tmp, std::ios::binary);
+  }
+  ~PendingFile() {
+    if (!m_committed) {
+      m_stream.close();
+      std::error_code ec;
+      std::filesystem::remove(m_tmp, ec);
+    }
+  }
+  PendingFile(const PendingFile&) = delete;
+  PendingFile& operator=(const PendingFile&) = delete;
+
+  std::ofstream& stream() { return m_stream; }
+
+  Result<void> commit() {
+    m_stream.close();
+    if (!m_stream) {
+      return std::unexpected(
+          std::format("Error: Failed to write file {}", m_tmp.string()));
+    }
+    std::error_code ec;
+    std::filesystem::rename(m_tmp, m_path, ec);
+    if (ec) {
+      return std::unexpected(std::format("Error: Failed to replace {}: {}",
+                                         m_path.string(), ec.message()));
+    }
+    m_committed = true;
+    return {};
+  }
+
+private:
+  std::filesystem::path m_path;
+  std::filesystem::path m_tmp;
+  std::ofstream m_stream;
+  bool m_committed = false;
+};
+
 class DecompressSZS {
 public:
   DecompressSZS(const CliOptions& opt) : m_opt(opt) {}
@@ -236,19 +336,28 @@ public:
     }
     fmt::print(stderr, "Decompressing SZS: {} => {}\n", m_from.string(),
                m_to.string());
-    auto file = ReadFile(m_opt.from.view());
-    if (!file.has_value()) {
-      return std::unexpected("Error: Failed to read file");
-    }
-    // Max 4GB
-    u32 size = TRY(librii::szs::getExpandedSize(*file));
-    std::vector<u8> buf(size);
-    TRY(librii::szs::decode(buf, *file));
     if (std::filesystem::is_directory(m_to)) {
       return std::unexpected("Failed to extract: |to| is a folder, not a file");
     }
-    plate::Platform::writeFile(buf, m_to.string());
-    return {};
+    std::ifstream in(m_from, std::ios::binary);
+    if (!in) {
+      return std::unexpected("Error: Failed to read file");
+    }
+    PendingFile out(m_to);
+    librii::szs::StreamDecoder decoder([&](std::span<const u8> chunk) {
+      out.stream().write(reinterpret_cast<const char*>(chunk.data()),
+                         chunk.size());
+    });
+    // Constant memory: only one chunk of the file is resident at a time
+    std::vector<u8> chunk(StreamChunkSize);
+    while (in) {
+      in.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+      TRY(decoder.feed(std::span(chunk).first(in.gcount())));
+    }
+    TRY(decoder.finish());
+    // Closed first: Windows cannot replace a file that is still open
+    in.close();
+    return out.commit();
   }
 
 private:
@@ -289,34 +398,75 @@ public:
       fmt::print(stderr, "Error: failed to parse args\n");
       return false;
     }
-    if (false) {
-      fmt::print(stderr, "Error: file format is unsupported\n");
+    if (m_opt.szs_level > static_cast<u32>(librii::szs::Level::Optimal)) {
+      fmt::print(stderr, "Error: invalid compression level {}\n",
+                 m_opt.szs_level);
       return false;
     }
     auto from = std::filesystem::absolute(m_from);
+    auto level = static_cast<librii::szs::Level>(m_opt.szs_level);
+    fmt::print(stderr, "Compressing SZS: {} => {} ({} strategy)\n",
+               m_from.string(), m_to.string(), magic_enum::enum_name(level));
+    if (level != librii::szs::Level::Optimal) {
+      return compressStream(from, level);
+    }
+
+    // The optimal parse needs the entire file
     auto file = ReadFile(from.string());
     if (!file.has_value()) {
       fmt::print(stderr, "Error: Failed to read file {}\n", from.string());
       return false;
     }
-
-    fmt::print(stderr,
-               "Compressing SZS: {} => {} (Boyer-Moore-Horspool strategy)\n",
-               m_from.string(), m_to.string());
-    std::vector<u8> buf(file->size() * 2);
-    int size = librii::szs::encodeBoyerMooreHorspool(file->data(), buf.data(),
-                                                     file->size());
-    if (size < 0 || size > buf.size()) {
-      fmt::print(stderr, "Error: Failed to compress file\n");
-      return false;
-    }
-    buf.resize(roundUp(size, 32));
+    auto buf = librii::szs::encode(*file, level);
+    buf.resize(roundUp(buf.size(), 32));
 
     plate::Platform::writeFile(buf, m_to.string());
     return true;
   }
 
 private:
+  bool compressStream(const std::filesystem::path& from,
+                      librii::szs::Level level) {
+    const auto size = std::filesystem::file_size(from);
+    if (size > std::numeric_limits<u32>::max()) {
+      fmt::print(stderr, "Error: {} is too large for YAZ0 (4 GiB max)\n",
+                 from.string());
+      return false;
+    }
+    std::ifstream in(from, std::ios::binary);
+    if (!in) {
+      fmt::print(stderr, "Error: Failed to read file {}\n", from.string());
+      return false;
+    }
+    PendingFile out(m_to);
+    librii::szs::StreamEncoder encoder(
+        size,
+        [&](std::span<const u8> chunk) {
+          out.stream().write(reinterpret_cast<const char*>(chunk.data()),
+                             chunk.size());
+        },
+        level);
+    std::vector<u8> chunk(StreamChunkSize);
+    while (in) {
+      in.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+      encoder.feed(std::span(chunk).first(in.gcount()));
+    }
+    if (auto ok = encoder.finish(); !ok) {
+      fmt::print(stderr, "Error: Failed to compress file: {}\n", ok.error());
+      return false;
+    }
+    // Pad to 32 bytes, like the in-memory path
+    for (u64 i = encoder.written(); i % 32; ++i) {
+      out.stream().put(0);
+    }
+    in.close();
+    if (auto ok = out.commit(); !ok) {
+      fmt::print(stderr, "{}\n", ok.error());
+      return false;
+    }
+    return true;
+  }
+
   bool parseArgs() {
     m_from = m_opt.from.view();
     m_to = m_opt.to.view();
@@ -449,7 +599,7 @@ public:
     fmt::print(stderr, "Extracting ARC.SZS,{} => {}\n", m_from.string(),
                m_to.string());
 
-    auto arc = TRY(librii::U8::LoadU8Archive(buf));
+    auto arc = TRY(librii::U8::LoadU8ArchiveView(buf));
     TRY(librii::U8::Extract(arc, m_to));
 
     return {};
@@ -501,16 +651,11 @@ public:
 
     auto arc = TRY(librii::U8::Create(m_from));
     auto buf = librii::U8::SaveU8Archive(arc);
-    std::vector<u8> szs(librii::szs::getWorstEncodingSize(buf));
     fmt::print(stderr,
                "Compressing SZS: {} => {} (Boyer-Moore-Horspool strategy)\n",
                m_from.string(), m_to.string());
-    int sz = librii::szs::encodeBoyerMooreHorspool(buf.data(), szs.data(),
-                                                   buf.size());
-    if (sz <= 0 || sz > szs.size()) {
-      return std::unexpected("SZS encoding failed");
-    }
-    szs.resize(roundUp(sz, 32));
+    auto szs = librii::szs::encodeBoyerMooreHorspoolParallel(buf);
+    szs.resize(roundUp(szs.size(), 32));
 
     plate::Platform::writeFile(szs, m_to.string());
 
@@ -544,6 +689,211 @@ private:
   std::filesystem::path m_to;
 };
 
+// rszst batch <manifest.jsonl>
+//
+// Each line is one job, named like the corresponding subcommand:
+//   {"command": "import-command", "from": "a.dae", "preset_path": "presets"}
+//   {"command": "compress", "from": "b.arc", "to": "b.szs", "level": 2}
+// Remaining keys match the CliOptions fields.
+class Batch {
+public:
+  Batch(const CliOptions& opt) : m_opt(opt) {}
+
+  Result<void> execute() {
+    if (m_opt.verbose) {
+      rsl::logging::init();
+    }
+    auto jobs = TRY(readManifest(m_opt.from.view()));
+
+    // Jobs and the work they fan out (encoders, U8 I/O, importers) share one
+    // scheduler, so the machine is never asked for more than a thread per core
+    auto& scheduler = librii::sched::TaskScheduler::shared();
+    u32 max_in_flight = jobs.size();
+    if (m_opt.batch_jobs != 0) {
+      max_in_flight = std::min<u32>(max_in_flight, m_opt.batch_jobs);
+    }
+    fmt::print(stdout, "Running {} jobs, up to {} at once, on {} threads\n",
+               jobs.size(), max_in_flight, scheduler.numThreads());
+
+    s_progressEnabled = false;
+    using clock_t = std::chrono::steady_clock;
+    const auto start = clock_t::now();
+    std::atomic<size_t> next = max_in_flight;
+    std::atomic<size_t> num_failed = 0;
+    std::atomic<u64> job_us = 0;
+    librii::sched::TaskGroup group;
+    // One task per job, so a thread that picks one up while waiting on its own
+    // subtasks only runs that job. Each finished job queues the next to keep
+    // at most |max_in_flight| running.
+    std::function<void(size_t)> run = [&](size_t i) {
+      const auto job_start = clock_t::now();
+      auto ok = runJob(jobs[i].options);
+      const std::chrono::duration<double, std::milli> elapsed =
+          clock_t::now() - job_start;
+      job_us += static_cast<u64>(elapsed.count() * 1000.0);
+      {
+        std::unique_lock g(s_progressLock);
+        if (ok) {
+          fmt::print(stdout, "[{}/{}] OK     {} ({:.1f} ms)\n", i + 1,
+                     jobs.size(), jobs[i].description, elapsed.count());
+        } else {
+          ++num_failed;
+          fmt::print(stdout, "[{}/{}] FAILED {} ({:.1f} ms): {}\n", i + 1,
+                     jobs.size(), jobs[i].description, elapsed.count(),
+                     ok.error());
+        }
+      }
+      if (const size_t n = next++; n < jobs.size()) {
+        scheduler.spawn(group, [&, n] { run(n); });
+      }
+    };
+    for (size_t i = 0; i < max_in_flight; ++i) {
+      scheduler.spawn(group, [&, i] { run(i); });
+    }
+    scheduler.wait(group);
+    s_progressEnabled = true;
+
+    const std::chrono::duration<double, std::milli> wall =
+        clock_t::now() - start;
+    fmt::print(stdout,
+               "Batch: {} jobs, {} failed. Wall time {:.1f} ms, job time "
+               "{:.1f} ms\n",
+               jobs.size(), num_failed.load(), wall.count(),
+               job_us / 1000.0);
+    if (num_failed) {
+      return std::unexpected(
+          std::format("{} of {} jobs failed", num_failed.load(), jobs.size()));
+    }
+    return {};
+  }
+
+private:
+  struct Job {
+    CliOptions options;
+    std::string description;
+  };
+
+  static Result<void> setString(CFixedString<256>& dst, std::string_view str) {
+    if (str.size() >= sizeof(dst.buf)) {
+      return std::unexpected(std::format("Path too long: {}", str));
+    }
+    std::ranges::fill(dst.buf, 0);
+    std::ranges::copy(str, dst.buf);
+    return {};
+  }
+
+  static Result<Job> parseJob(std::string_view line) {
+    static const std::map<std::string_view, u32> commands{
+        {"import-command", TYPE_IMPORT_BRRES},
+        {"decompress", TYPE_DECOMPRESS},
+        {"compress", TYPE_COMPRESS},
+        {"rhst2-brres", TYPE_COMPILE_RHST_BRRES},
+        {"rhst2-bmd", TYPE_COMPILE_RHST_BMD},
+        {"extract", TYPE_EXTRACT},
+        {"create", TYPE_CREATE},
+    };
+    auto json = nlohmann::json::parse(line, nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+      return std::unexpected("Expected a JSON object");
+    }
+    Job job;
+    auto& opt = job.options;
+    // Type mismatches throw
+    try {
+      const auto command = json.value("command", std::string{});
+      if (!commands.contains(command)) {
+        return std::unexpected(std::format("Unknown command \"{}\"", command));
+      }
+      opt.type = commands.at(command);
+      const auto from = json.value("from", std::string{});
+      if (from.empty()) {
+        return std::unexpected("Missing \"from\"");
+      }
+      TRY(setString(opt.from, from));
+      TRY(setString(opt.to, json.value("to", std::string{})));
+      TRY(setString(opt.preset_path, json.value("preset_path", std::string{})));
+      TRY(setString(opt.texture_cache,
+                    json.value("texture_cache", std::string{})));
+      opt.scale = json.value("scale", opt.scale);
+      opt.brawlbox_scale = json.value("brawlbox_scale", false);
+      opt.mipmaps = json.value("mipmaps", true);
+      opt.min_mip = json.value("min_mip", opt.min_mip);
+      opt.max_mips = json.value("max_mips", opt.max_mips);
+      opt.auto_transparency = json.value("auto_transparency", true);
+      opt.merge_mats = json.value("merge_mats", true);
+      opt.bake_uvs = json.value("bake_uvs", false);
+      if (json.contains("tint")) {
+        // Same "#RRGGBB" form as --tint
+        const auto tint = json["tint"].get<std::string>();
+        if (tint.size() != 7 || tint[0] != '#') {
+          return std::unexpected("Tint must be of the form #RRGGBB");
+        }
+        opt.hexcode = std::stoul(tint.substr(1), nullptr, 16);
+      }
+      opt.cull_degenerates = json.value("cull_degenerates", true);
+      opt.cull_invalid = json.value("cull_invalid", true);
+      opt.recompute_normals = json.value("recompute_normals", false);
+      opt.fuse_vertices = json.value("fuse_vertices", true);
+      opt.no_tristrip = json.value("no_tristrip", false);
+      opt.ai_json = json.value("ai_json", false);
+      opt.szs_level = json.value("level", opt.szs_level);
+      opt.cmpr_quality = json.value("cmpr_quality", opt.cmpr_quality);
+      opt.auto_texture_format = json.value("auto_texture_format", false);
+      job.description = std::format("{} {}", command, from);
+    } catch (const std::exception& e) {
+      return std::unexpected(std::format("Invalid job: {}", e.what()));
+    }
+    return job;
+  }
+
+  static Result<std::vector<Job>> readManifest(std::string_view path) {
+    std::ifstream stream{std::string(path)};
+    if (!stream) {
+      return std::unexpected(std::format("Failed to read manifest {}", path));
+    }
+    std::vector<Job> jobs;
+    std::string line;
+    for (int line_no = 1; std::getline(stream, line); ++line_no) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        continue;
+      }
+      auto job = parseJob(line);
+      if (!job) {
+        return std::unexpected(
+            std::format("{}:{}: {}", path, line_no, job.error()));
+      }
+      jobs.push_back(std::move(*job));
+    }
+    return jobs;
+  }
+
+  Result<void> runJob(const CliOptions& opt) {
+    switch (opt.type) {
+    case TYPE_IMPORT_BRRES:
+      return ImportBRRES(opt, &m_presets).execute();
+    case TYPE_DECOMPRESS:
+      return DecompressSZS(opt).execute();
+    case TYPE_COMPRESS:
+      if (!CompressSZS(opt).execute()) {
+        return std::unexpected("Failed to compress");
+      }
+      return {};
+    case TYPE_COMPILE_RHST_BRRES:
+      return CompileRHST<riistudio::g3d::Collection>(opt).execute();
+    case TYPE_COMPILE_RHST_BMD:
+      return CompileRHST<riistudio::j3d::Collection>(opt).execute();
+    case TYPE_EXTRACT:
+      return ExtractSZS(opt).execute();
+    case TYPE_CREATE:
+      return CreateSZS(opt).execute();
+    }
+    return std::unexpected("Unknown command");
+  }
+
+  CliOptions m_opt;
+  PresetCache m_presets;
+};
+
 int main(int argc, const char** argv) {
   fmt::print(stdout, "RiiStudio CLI {}\n", RII_TIME_STAMP);
   auto args = parse(argc, argv);
@@ -613,6 +963,14 @@ int main(int argc, const char** argv) {
       fmt::print(stdout, "{}\n", ok.error());
       return -1;
     }
+  } else if (args->type == TYPE_BATCH) {
+    Batch cmd(*args);
+    auto ok = cmd.execute();
+    if (!ok) {
+      fmt::print(stderr, "{}\n", ok.error());
+      fmt::print(stdout, "{}\n", ok.error());
+      return -1;
+    }
   }
   return 0;
 }
@@ -0,0 +1,75 @@
+#include "DecodedTextureCache.hpp"
+
+namespace riistudio::lib3d {
+
+namespace {
+
+// The generation ID counts edits in its low 32 bits
+constexpr GenerationIDTracked::GenerationID ObjectOf(
+    GenerationIDTracked::GenerationID id) {
+  return id >> 32;
+}
+
+} // namespace
+
+DecodedTextureCache::DecodedTextureCache(size_t budget_bytes)
+    : mBudget(budget_bytes) {}
+
+DecodedTextureCache& DecodedTextureCache::shared() {
+  static DecodedTextureCache cache(64 * 1024 * 1024);
+  return cache;
+}
+
+Result<DecodedTextureCache::Pixels>
+DecodedTextureCache::get(const Texture& tex) {
+  const auto id = tex.getGenerationId();
+  {
+    std::scoped_lock g(mMutex);
+    if (auto it = mIndex.find(id); it != mIndex.end()) {
+      mEntries.splice(mEntries.begin(), mEntries, it->second);
+      return it->second->pixels;
+    }
+  }
+
+  // Decode unlocked, so other textures are not held up. Two threads missing
+  // on one texture both decode it; the second result is discarded.
+  auto pixels = std::make_shared<std::vector<u8>>();
+  TRY(tex.decode(*pixels, true));
+
+  std::scoped_lock g(mMutex);
+  if (auto it = mIndex.find(id); it != mIndex.end()) {
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return it->second->pixels;
+  }
+  // Earlier generations of the same texture will never be asked for again
+  for (auto it = mIndex.lower_bound(ObjectOf(id) << 32);
+       it != mIndex.end() && ObjectOf(it->first) == ObjectOf(id);) {
+    mBytes -= it->second->pixels->size();
+    mEntries.erase(it->second);
+    it = mIndex.erase(it);
+  }
+  mEntries.push_front({id, pixels});
+  mIndex.emplace(id, mEntries.begin());
+  mBytes += pixels->size();
+  evict();
+  return pixels;
+}
+
+void DecodedTextureCache::clear() {
+  std::scoped_lock g(mMutex);
+  mEntries.clear();
+  mIndex.clear();
+  mBytes = 0;
+}
+
+void DecodedTextureCache::evict() {
+  // The newest entry is kept even if it alone exceeds the budget
+  while (mBytes > mBudget && mEntries.size() > 1) {
+    const auto& last = mEntries.back();
+    mBytes -= last.pixels->size();
+    mIndex.erase(last.id);
+    mEntries.pop_back();
+  }
+}
+
+} // namespace riistudio::lib3d
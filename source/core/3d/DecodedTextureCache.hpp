@@ -0,0 +1,52 @@
+#pragma once
+
+#include <core/3d/Texture.hpp>
+#include <list>
+#include <mutex>
+
+namespace riistudio::lib3d {
+
+//! @brief Least-recently-used cache of textures decoded to RGBA32.
+//!
+//! Entries are keyed by Texture::getGenerationId(), so an edited texture is
+//! decoded again only once its generation is bumped. Older generations of a
+//! texture are dropped as soon as a newer one is decoded.
+//!
+class DecodedTextureCache {
+public:
+  //! Decoded RGBA32 of every level of detail, one after another.
+  using Pixels = std::shared_ptr<const std::vector<u8>>;
+
+  explicit DecodedTextureCache(size_t budget_bytes);
+
+  //! @brief Cache shared by the previews, icons and GL uploads.
+  //!
+  static DecodedTextureCache& shared();
+
+  //! @brief Decode every level of |tex|, or return the cached decode.
+  //!
+  //! The pixels stay valid while the pointer is held, even once evicted.
+  //!
+  Result<Pixels> get(const Texture& tex);
+
+  void clear();
+
+private:
+  using GenerationID = GenerationIDTracked::GenerationID;
+
+  struct Entry {
+    GenerationID id;
+    Pixels pixels;
+  };
+
+  void evict();
+
+  std::mutex mMutex;
+  //! Most recently used first.
+  std::list<Entry> mEntries;
+  std::map<GenerationID, std::list<Entry>::iterator> mIndex;
+  size_t mBytes = 0;
+  size_t mBudget;
+};
+
+} // namespace riistudio::lib3d
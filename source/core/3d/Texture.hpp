@@ -66,7 +66,28 @@ struct Texture : public virtual kpi::IObject, public GenerationIDTracked {
     }
   }
   virtual u32 getEncodedSize(bool mip) const = 0;
-  virtual Result<void> decode(std::vector<u8>& out, bool mip) const = 0;
+
+  //! @brief Decode the texture to RGBA32.
+  //!
+  //! @param[out] out Target, sized at least getDecodedSize(mip).
+  //! @param[in]  mip If all levels of detail should be decoded, one after
+  //!                 another.
+  //!
+  virtual Result<void> decodeInto(std::span<u8> out, bool mip) const = 0;
+
+  //! @brief Decode the texture to RGBA32, growing |out| to
+  //! getDecodedSize(mip) if smaller. Capacity is kept, so the vector may be
+  //! reused across textures.
+  //!
+  virtual Result<void> decode(std::vector<u8>& out, bool mip) const {
+    const u32 size = getDecodedSize(mip);
+    if (size == 0)
+      return std::unexpected("Decoded size is 0");
+    if (out.size() < size) {
+      out.resize(size);
+    }
+    return decodeInto(out, mip);
+  }
 
   virtual u32 getImageCount() const = 0;
   virtual void setImageCount(u32 c) = 0;
@@ -12,7 +12,9 @@ Result<Archive> ReadArchive(std::span<const u8> buf) {
     return std::unexpected("Invalid .szs file");
   }
 
-  std::vector<u8> decoded(*expanded);
+  // Shared by every ArchiveFile we hand out, so payloads are never copied
+  auto backing = std::make_shared<std::vector<u8>>(*expanded);
+  auto& decoded = *backing;
   auto err = librii::szs::decode(decoded, buf);
   if (!err) {
     rsl::error("Failed to decode SZS");
@@ -25,12 +27,12 @@ Result<Archive> ReadArchive(std::span<const u8> buf) {
     return std::unexpected("Not a U8 archive");
   }
 
-  auto tarc = librii::U8::LoadU8Archive(decoded);
+  auto tarc = librii::U8::LoadU8ArchiveView(decoded);
   if (!tarc) {
     rsl::error("Failed to read archive");
     return std::unexpected("Invalid U8 archive");
   }
-  auto arc = *tarc;
+  auto& arc = *tarc;
 
   Archive n_arc;
 
@@ -44,7 +46,7 @@ Result<Archive> ReadArchive(std::span<const u8> buf) {
 
   n_path.push_back(
       Pair{.folder = &n_arc, .sibling_next = arc.nodes[0].folder.sibling_next});
-  for (int i = 1; i < arc.nodes.size(); ++i) {
+  for (size_t i = 1; i < arc.nodes.size(); ++i) {
     auto& node = arc.nodes[i];
 
     while (!n_path.empty() && i == n_path.back().sibling_next)
@@ -57,12 +59,8 @@ Result<Archive> ReadArchive(std::span<const u8> buf) {
       auto& parent = n_path[n_path.size() - 2];
       parent.folder->folders.emplace(node.name, std::move(tmp));
     } else {
-      const u32 start_pos = node.file.offset;
-      const u32 end_pos = node.file.offset + node.file.size;
-      assert(node.file.offset + node.file.size <= arc.file_data.size());
-      std::vector<u8> vec(arc.file_data.data() + start_pos,
-                          arc.file_data.data() + end_pos);
-      n_path.back().folder->files.emplace(node.name, std::move(vec));
+      n_path.back().folder->files.emplace(node.name,
+                                          ArchiveFile(backing, arc.getFile(i)));
     }
 
     while (!n_path.empty() && i + 1 == n_path.back().sibling_next)
@@ -104,7 +102,8 @@ static void ProcessArcs(const Archive* arc, std::string_view name,
           u8.file_data.size(); // Note: relative->abs translation handled later
       node.file.size = f.size();
       u8.nodes.push_back(node);
-      u8.file_data.insert(u8.file_data.end(), f.begin(), f.end());
+      auto data = f.span();
+      u8.file_data.insert(u8.file_data.end(), data.begin(), data.end());
     }
   }
 
@@ -123,7 +122,8 @@ std::vector<u8> WriteArchive(const Archive& arc) {
   return szs_buf;
 }
 
-std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path) {
+std::optional<std::span<const u8>> FindFile(const Archive& arc,
+                                            std::string path) {
   std::filesystem::path _path = path;
   _path = _path.lexically_normal();
 
@@ -141,7 +141,7 @@ std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path) {
       if (it != cur_arc->files.end()) {
         // TODO: This will ignore everything else in the path and accept invalid
         // item e.g. source/file.txt/invalid/other would ignore invalid/other
-        return it->second;
+        return it->second.span();
       }
     }
   }
@@ -154,10 +154,48 @@ FindFileWithOverloads(const Archive& arc, std::vector<std::string> paths) {
   for (auto& path : paths) {
     auto found = FindFile(arc, path);
     if (found.has_value()) {
-      return ResolveQuery{.file_data = std::move(*found),
+      return ResolveQuery{.file_data = *found,
                           .resolved_path = path};
     }
   }
 
   return std::nullopt;
 }
+
+ArchiveIndex::ArchiveIndex(const Archive& arc)
+    : mArchive(arc), mIndex(librii::U8::PathIndex::Match::Exact) {
+  add(arc, "");
+}
+
+void ArchiveIndex::add(const Archive& arc, std::string prefix) {
+  for (auto& [name, folder] : arc.folders) {
+    add(*folder, prefix + name + "/");
+  }
+  for (auto& [name, file] : arc.files) {
+    if (mIndex.insert(prefix + name, static_cast<s32>(mFiles.size())))
+      mFiles.push_back(&file);
+  }
+}
+
+std::optional<std::span<const u8>>
+ArchiveIndex::find(std::string_view path) const {
+  auto found = mIndex.find(path);
+  if (!found)
+    return FindFile(mArchive, std::string(path));
+  if (*found < 0)
+    return std::nullopt;
+  return mFiles[*found]->span();
+}
+
+std::optional<ResolveQuery>
+FindFileWithOverloads(const ArchiveIndex& index,
+                      std::vector<std::string> paths) {
+  for (auto& path : paths) {
+    auto found = index.find(path);
+    if (found.has_value()) {
+      return ResolveQuery{.file_data = *found, .resolved_path = path};
+    }
+  }
+
+  return std::nullopt;
+}
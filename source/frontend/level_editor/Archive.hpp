@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/common.h>
+#include <librii/u8/U8.hpp>
 #include <map>
 #include <memory>
 #include <optional>
@@ -8,9 +9,31 @@
 #include <string>
 #include <vector>
 
+//! File stored in an Archive. Files read from disk borrow from the shared
+//! decompressed buffer; files assigned by the editor own their data.
+class ArchiveFile {
+public:
+  ArchiveFile() = default;
+  ArchiveFile(std::vector<u8> data)
+      : mOwned(std::make_shared<const std::vector<u8>>(std::move(data))),
+        mData(*mOwned) {}
+  ArchiveFile(std::shared_ptr<const std::vector<u8>> backing,
+              std::span<const u8> data)
+      : mOwned(std::move(backing)), mData(data) {}
+
+  std::span<const u8> span() const { return mData; }
+  std::size_t size() const { return mData.size(); }
+  //! Copy the contents out for callers that need ownership
+  std::vector<u8> toVector() const { return {mData.begin(), mData.end()}; }
+
+private:
+  std::shared_ptr<const std::vector<u8>> mOwned;
+  std::span<const u8> mData;
+};
+
 struct Archive {
   std::map<std::string, std::shared_ptr<Archive>> folders;
-  std::map<std::string, std::vector<u8>> files;
+  std::map<std::string, ArchiveFile> files;
 };
 
 //! Read a .szs/.carc file to a generic Archive
@@ -24,13 +47,37 @@ FindFile(arc, "pictures/dogs/1.png");
 
 return arc.folders.find("pictures")?.folders.find("dogs")?.files.find("1.png");
 */
-std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path);
+std::optional<std::span<const u8>> FindFile(const Archive& arc,
+                                            std::string path);
 
+//! file_data is borrowed from the Archive that was queried.
 struct ResolveQuery {
-  std::vector<u8> file_data;
+  std::span<const u8> file_data;
   std::string resolved_path;
 };
 
 //! Check the first path, then the second, and so on
 std::optional<ResolveQuery>
 FindFileWithOverloads(const Archive& arc, std::vector<std::string> paths);
+
+//! Flat path -> file lookup for an Archive, built once after loading. Names
+//! are matched exactly, like FindFile. The Archive must outlive the index and
+//! must not have files removed while it is in use.
+class ArchiveIndex {
+public:
+  explicit ArchiveIndex(const Archive& arc);
+
+  //! Falls back to FindFile for paths the index cannot normalize.
+  std::optional<std::span<const u8>> find(std::string_view path) const;
+
+private:
+  void add(const Archive& arc, std::string prefix);
+
+  const Archive& mArchive;
+  librii::U8::PathIndex mIndex;
+  std::vector<const ArchiveFile*> mFiles;
+};
+
+std::optional<ResolveQuery>
+FindFileWithOverloads(const ArchiveIndex& index,
+                      std::vector<std::string> paths);
@@ -26,7 +26,7 @@ struct SimpleTransaction {
   kpi::LightIOTransaction trans;
 };
 
-std::unique_ptr<g3d::Collection> ReadBRRES(const std::vector<u8>& buf,
+std::unique_ptr<g3d::Collection> ReadBRRES(std::span<const u8> buf,
                                            std::string path,
                                            NeedResave need_resave) {
   auto result = std::make_unique<g3d::Collection>();
@@ -46,7 +46,7 @@ std::unique_ptr<g3d::Collection> ReadBRRES(const std::vector<u8>& buf,
   return result;
 }
 
-std::unique_ptr<librii::kmp::CourseMap> ReadKMP(const std::vector<u8>& buf,
+std::unique_ptr<librii::kmp::CourseMap> ReadKMP(std::span<const u8> buf,
                                                 std::string path) {
   auto map = librii::kmp::readKMP(buf);
   if (!map) {
@@ -64,7 +64,7 @@ std::vector<u8> WriteKMP(const librii::kmp::CourseMap& map) {
 }
 
 std::unique_ptr<librii::kcol::KCollisionData>
-ReadKCL(const std::vector<u8>& buf, std::string path) {
+ReadKCL(std::span<const u8> buf, std::string path) {
   auto result = std::make_unique<librii::kcol::KCollisionData>();
 
   auto res = librii::kcol::ReadKCollisionData(*result, buf, buf.size());
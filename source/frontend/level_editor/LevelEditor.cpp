@@ -73,10 +73,12 @@ void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
 
   setName("Level Editor: " + path);
 
+  const ArchiveIndex index(mLevel.root_archive);
+
   // Read course_model.brres
   {
     auto course_model_brres = FindFileWithOverloads(
-        mLevel.root_archive, {"course_d_model.brres", "course_model.brres"});
+        index, {"course_d_model.brres", "course_model.brres"});
     if (course_model_brres.has_value()) {
       auto b = ReadBRRES(course_model_brres->file_data,
                          course_model_brres->resolved_path);
@@ -88,7 +90,7 @@ void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
   // Read vrcorn_model.brres
   {
     auto vrcorn_model_brres = FindFileWithOverloads(
-        mLevel.root_archive, {"vrcorn_d_model.brres", "vrcorn_model.brres"});
+        index, {"vrcorn_d_model.brres", "vrcorn_model.brres"});
     if (vrcorn_model_brres.has_value()) {
       auto b = ReadBRRES(vrcorn_model_brres->file_data,
                          vrcorn_model_brres->resolved_path);
@@ -99,8 +101,7 @@ void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
 
   // Read map_model.brres
   {
-    auto map_model =
-        FindFileWithOverloads(mLevel.root_archive, {"map_model.brres"});
+    auto map_model = FindFileWithOverloads(index, {"map_model.brres"});
     if (map_model.has_value()) {
       auto b = ReadBRRES(map_model->file_data, map_model->resolved_path);
       if (b)
@@ -110,8 +111,7 @@ void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
 
   // Read course.kcl
   {
-    auto course_kcl =
-        FindFileWithOverloads(mLevel.root_archive, {"course.kcl"});
+    auto course_kcl = FindFileWithOverloads(index, {"course.kcl"});
     if (course_kcl.has_value()) {
       mCourseKcl = ReadKCL(course_kcl->file_data, course_kcl->resolved_path);
     }
@@ -125,8 +125,7 @@ void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
 
   // Read course.kmp
   {
-    auto course_kmp =
-        FindFileWithOverloads(mLevel.root_archive, {"course.kmp"});
+    auto course_kmp = FindFileWithOverloads(index, {"course.kmp"});
     if (course_kmp.has_value()) {
       mKmp = ReadKMP(course_kmp->file_data, course_kmp->resolved_path);
     }
@@ -174,9 +173,10 @@ GatherNodes(Archive& arc) {
       ImGui::TreePop();
     }
   }
-  for (auto& f : arc.files) {
-    if (ImGui::Selectable(f.first.c_str())) {
-      clicked = f;
+  for (auto& [name, file] : arc.files) {
+    if (ImGui::Selectable(name.c_str())) {
+      // Only copy out the file that was actually opened
+      clicked = std::make_pair(name, file.toVector());
     }
   }
 
@@ -422,10 +422,9 @@ Result<librii::g3d::TextureData> ReadTexture(const rsl::File& file) {
                     "recognize it or didn't exist.",
                     path));
   }
-  std::vector<u8> scratch;
   riistudio::g3d::Texture tex;
   const auto ok = riistudio::rhst::importTexture(
-      tex, image->data, scratch, true, 64, 4, image->width, image->height,
+      tex, image->data, true, 64, 4, image->width, image->height,
       image->channels);
   if (!ok) {
     return std::unexpected(
@@ -899,6 +898,7 @@ struct AdvancedTextureConverter {
 
   librii::image::ResizingAlgorithm resizer{
       librii::image::ResizingAlgorithm::Lanczos};
+  librii::image::MipGenOptions mip_options{};
 
   [[nodiscard]] Result<void> Populate(const libcube::Texture& tex) {
     format = tex.getTextureFormat();
@@ -990,12 +990,11 @@ struct AdvancedTextureConverter {
     u32 src_size = first_width * first_height * 4;
     // If mips are also sent, just ignore
     EXPECT(source_data.size() >= src_size);
-    std::vector<u8> scratch;
     if (should_throw || (is_power_of_2(width) && is_power_of_2(height) &&
                          width > 4 && height > 4)) {
       TRY(riistudio::rhst::importTextureImpl(
-          dst_encoded, source_data, scratch, mip_levels - 1, width, height,
-          first_width, first_height, format, resizer));
+          dst_encoded, source_data, mip_levels - 1, width, height, first_width,
+          first_height, format, resizer, mip_options));
     }
     // Bust cache
     dst_encoded.nextGenerationId();
@@ -1119,6 +1118,18 @@ Result<TCResult> DrawAdvTexConv(AdvancedTextureConverter& action) {
       TRY(action.SetConstrain(aspect));
     }
     action.resizer = imcxx::EnumCombo("Resizing algorithm", action.resizer);
+    if (action.mip_levels > 1) {
+      auto mip_options = action.mip_options;
+      mip_options.filter = imcxx::EnumCombo("Mip filter", mip_options.filter);
+      if (mip_options.filter != librii::image::MipFilter::Resample) {
+        ImGui::Checkbox("Gamma-correct mips", &mip_options.gamma_correct);
+      }
+      if (mip_options.filter != action.mip_options.filter ||
+          mip_options.gamma_correct != action.mip_options.gamma_correct) {
+        action.mip_options = mip_options;
+        TRY(action.ReEncode());
+      }
+    }
   }
   ImGui::Separator();
 
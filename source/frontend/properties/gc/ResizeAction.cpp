@@ -117,6 +117,17 @@ bool ReformatAction::reformat_draw(Texture& data, bool* changed) {
 
   reformatOpt = static_cast<int>(
       TexFormatCombo(static_cast<librii::gx::TextureFormat>(reformatOpt)));
+  ImGui::SameLine();
+  if (ImGui::Button("Auto"_j)) {
+    // Smallest format that keeps the base level close to its current look
+    std::vector<u8> rgba;
+    if (auto d_ok = data.decode(rgba, false); !d_ok) {
+      rsl::ErrorDialogFmt("Failed to decode\n {}", d_ok.error());
+    } else {
+      reformatOpt = static_cast<int>(librii::image::ChooseTextureFormat(
+          rgba, data.getWidth(), data.getHeight()));
+    }
+  }
 
   const auto ok = std::string((const char*)ICON_FA_CHECK u8" ") + "Okay"_j;
   if (ImGui::Button(ok.c_str())) {
@@ -1,4 +1,5 @@
 #include "IconManager.hpp"
+#include <core/3d/DecodedTextureCache.hpp>
 #include <core/3d/gl.hpp> // for glGenTextures
 #include <imgui/imgui.h>  // for ImGui::Image
 #include <librii/image/ImagePlatform.hpp>
@@ -23,7 +24,6 @@ void IconDatabase::drawIcon(Key id, int wd, int ht) const {
 
 // TODO: Not threadsafe
 static std::array<u8, 128 * 128 * 4> scratch;
-static std::vector<u8> tmp;
 
 IconDatabase::Icon::Icon(const lib3d::Texture& texture, u32 dimension) {
 #ifdef RII_GL
@@ -37,9 +37,15 @@ IconDatabase::Icon::Icon(const lib3d::Texture& texture, u32 dimension) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
   assert(dimension <= 128);
-  texture.decode(tmp, false);
-  librii::image::resize(scratch, dimension, dimension, tmp, texture.getWidth(),
-                        texture.getHeight(), librii::image::Lanczos);
+  // Shared with the texture's preview, which decodes the same pixels
+  auto pixels = lib3d::DecodedTextureCache::shared().get(texture);
+  if (pixels) {
+    librii::image::resize(scratch, dimension, dimension, **pixels,
+                          texture.getWidth(), texture.getHeight(),
+                          librii::image::Lanczos);
+  } else {
+    std::ranges::fill(scratch, 0);
+  }
 
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimension, dimension, 0, GL_RGBA,
                GL_UNSIGNED_BYTE, (void*)scratch.data());
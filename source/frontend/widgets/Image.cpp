@@ -1,4 +1,5 @@
 #include "Image.hpp"
+#include <core/3d/DecodedTextureCache.hpp>
 #include <core/3d/gl.hpp>
 #include <imgui/imgui.h>
 #undef min
@@ -23,12 +24,12 @@ void ImagePreview::setFromImage(const lib3d::Texture& tex) {
   height = tex.getHeight();
   mNumMipMaps = tex.getMipmapCount();
   mLod = std::min(static_cast<u32>(mLod), mNumMipMaps);
-  tex.decode(mDecodeBuf, true);
+  auto pixels = lib3d::DecodedTextureCache::shared().get(tex);
 
   if (mTexUploaded) {
     glDeleteTextures(1, &mGpuTexId);
   }
-  if (mDecodeBuf.size() && width && height) {
+  if (pixels && width && height) {
     glGenTextures(1, &mGpuTexId);
   } else {
     mTexUploaded = false;
@@ -49,10 +50,9 @@ void ImagePreview::setFromImage(const lib3d::Texture& tex) {
   for (u32 i = 0; i <= tex.getMipmapCount(); ++i) {
     glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, tex.getWidth() >> i,
                  tex.getHeight() >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 mDecodeBuf.data() + slide);
+                 (*pixels)->data() + slide);
     slide += (tex.getWidth() >> i) * (tex.getHeight() >> i) * 4;
   }
-  mDecodeBuf.clear();
 #endif
 }
 
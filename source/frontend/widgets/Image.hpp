@@ -20,8 +20,6 @@ private:
   u16 height = 0;
 
 public:
-  std::vector<u8> mDecodeBuf;
-
   u32 mGpuTexId = 0;
   bool mTexUploaded = false;
 
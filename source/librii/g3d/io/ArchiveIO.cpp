@@ -6,6 +6,7 @@
 
 #include <librii/g3d/io/AnimIO.hpp>
 #include <librii/g3d/io/TextureIO.hpp>
+#include <librii/sched/TaskScheduler.hpp>
 
 namespace librii::g3d {
 
@@ -44,8 +45,157 @@ struct BRRESHeader2 {
   }
 };
 
+namespace {
+
+enum class SubFileKind { Model, Texture, Clr, Pat, Srt, Vis };
+
+struct SubFile {
+  SubFileKind kind;
+  std::string folder;
+  BetterNode node;
+  //! Index into the archive's vector of this kind
+  size_t index = 0;
+};
+
+Result<void> ReadSubFile(BinaryArchive& arc, const SubFile& sub,
+                         oishii::BinaryReader& reader,
+                         kpi::LightIOTransaction& transaction) {
+  EXPECT(sub.node.stream_pos);
+  reader.seekSet(sub.node.stream_pos);
+  const auto& name = sub.node.name;
+
+  switch (sub.kind) {
+  case SubFileKind::Model: {
+    auto& mdl = arc.models[sub.index];
+    bool isValid = true;
+    auto ok = mdl.read(reader, transaction,
+                       "/" + sub.folder + "/" + name + "/", isValid);
+    if (!ok) {
+      return std::unexpected(
+          std::format("Failed to read MDL0 {}: {}", name, ok.error()));
+    }
+    (void)isValid;
+    break;
+  }
+  case SubFileKind::Texture: {
+    auto& tex = arc.textures[sub.index];
+    const bool ok = librii::g3d::ReadTexture(tex, SliceStream(reader), name);
+
+    if (!ok) {
+      transaction.callback(kpi::IOMessageClass::Warning, "/" + sub.folder,
+                           "Failed to read texture: " + name);
+    }
+    break;
+  }
+  case SubFileKind::Clr: {
+    auto ok = arc.clrs[sub.index].read(reader);
+    if (!ok) {
+      return std::unexpected(
+          std::format("Failed to read CLR0 {}: {}", name, ok.error()));
+    }
+    break;
+  }
+  case SubFileKind::Pat: {
+    auto ok = arc.pats[sub.index].read(reader);
+    if (!ok) {
+      return std::unexpected(
+          std::format("Failed to read PAT0 {}: {}", name, ok.error()));
+    }
+    break;
+  }
+  case SubFileKind::Srt: {
+    auto ok = arc.srts[sub.index].read(reader);
+    if (!ok) {
+      return std::unexpected(
+          std::format("Failed to read SRT0 {}: {}", name, ok.error()));
+    }
+    break;
+  }
+  case SubFileKind::Vis: {
+    auto ok = arc.viss[sub.index].read(reader);
+    if (!ok) {
+      return std::unexpected(
+          std::format("Failed to read VIS0 {}: {}", name, ok.error()));
+    }
+    break;
+  }
+  }
+
+  return {};
+}
+
+//! @brief Transaction that holds back diagnostics of work done on another
+//! thread, to be forwarded in a deterministic order once it has finished.
+//!
+struct DeferredTransaction {
+  struct Message {
+    kpi::IOMessageClass message_class;
+    std::string domain;
+    std::string body;
+  };
+
+  explicit DeferredTransaction(kpi::TransactionState state) {
+    transaction.state = state;
+    transaction.callback = [this](kpi::IOMessageClass message_class,
+                                  std::string_view domain,
+                                  std::string_view body) {
+      messages.push_back(
+          {message_class, std::string(domain), std::string(body)});
+    };
+  }
+  DeferredTransaction(const DeferredTransaction&) = delete;
+
+  void forward(kpi::LightIOTransaction& out) const {
+    for (auto& msg : messages) {
+      out.callback(msg.message_class, msg.domain, msg.body);
+    }
+    if (transaction.state != kpi::TransactionState::Complete) {
+      out.state = transaction.state;
+    }
+  }
+
+  kpi::LightIOTransaction transaction;
+  std::vector<Message> messages;
+};
+
+// Sub-files reference the archive-wide string pool, so each one reads through
+// a view of the whole archive rather than a slice of it.
+Result<void> ReadSubFilesParallel(BinaryArchive& arc,
+                                  std::span<const SubFile> subs,
+                                  const oishii::BinaryReader& reader,
+                                  kpi::LightIOTransaction& transaction) {
+  auto& scheduler = sched::TaskScheduler::shared();
+  sched::TaskGroup group;
+
+  std::deque<DeferredTransaction> deferred;
+  for (size_t i = 0; i < subs.size(); ++i) {
+    deferred.emplace_back(transaction.state);
+  }
+  std::vector<Result<void>> results(subs.size());
+
+  for (size_t i = 0; i < subs.size(); ++i) {
+    scheduler.spawn(group, [&, i] {
+      auto view = oishii::BinaryReader::ViewOf(reader);
+      results[i] = ReadSubFile(arc, subs[i], view, deferred[i].transaction);
+    });
+  }
+  scheduler.wait(group);
+
+  // Report as if read in dictionary order, stopping at the first failure
+  for (size_t i = 0; i < subs.size(); ++i) {
+    deferred[i].forward(transaction);
+    if (!results[i]) {
+      return std::unexpected(results[i].error());
+    }
+  }
+  return {};
+}
+
+} // namespace
+
 Result<void> BinaryArchive::read(oishii::BinaryReader& reader,
-                                 kpi::LightIOTransaction& transaction) {
+                                 kpi::LightIOTransaction& transaction,
+                                 bool parallel) {
   rsl::SafeReader safe(reader);
   TRY(BRRESHeader2::read(safe)); // TODO: Validate fields
 
@@ -55,6 +205,27 @@ Result<void> BinaryArchive::read(oishii::BinaryReader& reader,
   TRY(safe.U32());
   auto rootDict = TRY(ReadDictionary(safe));
 
+  // Sub-files are read in place when sequential, else after the whole
+  // directory has been walked.
+  std::vector<SubFile> pending;
+  const auto add_folder = [&](SubFileKind kind, const BetterNode& node,
+                              const BetterDictionary& cdic,
+                              auto& out) -> Result<void> {
+    for (auto& sub : cdic.nodes) {
+      SubFile file{.kind = kind,
+                   .folder = node.name,
+                   .node = sub,
+                   .index = out.size()};
+      out.emplace_back();
+      if (parallel) {
+        pending.push_back(std::move(file));
+      } else {
+        TRY(ReadSubFile(*this, file, reader, transaction));
+      }
+    }
+    return {};
+  };
+
   for (auto& node : rootDict.nodes) {
     EXPECT(node.stream_pos);
     reader.seekSet(node.stream_pos);
@@ -67,80 +238,17 @@ Result<void> BinaryArchive::read(oishii::BinaryReader& reader,
             "This file has multiple MDL0 files within it. "
             "Only single-MDL0 BRRES files are currently supported.");
       }
-      for (auto& sub : cdic.nodes) {
-        EXPECT(sub.stream_pos);
-        reader.seekSet(sub.stream_pos);
-        auto& mdl = models.emplace_back();
-        bool isValid = true;
-        auto ok = mdl.read(reader, transaction,
-                           "/" + node.name + "/" + sub.name + "/", isValid);
-        if (!ok) {
-          return std::unexpected(
-              std::format("Failed to read MDL0 {}: {}", sub.name, ok.error()));
-        }
-        (void)isValid;
-      }
+      TRY(add_folder(SubFileKind::Model, node, cdic, models));
     } else if (node.name == "Textures(NW4R)") {
-      for (auto& sub : cdic.nodes) {
-        EXPECT(sub.stream_pos);
-        reader.seekSet(sub.stream_pos);
-        auto& tex = textures.emplace_back();
-        const bool ok =
-            librii::g3d::ReadTexture(tex, SliceStream(reader), sub.name);
-
-        if (!ok) {
-          transaction.callback(kpi::IOMessageClass::Warning, "/" + node.name,
-                               "Failed to read texture: " + sub.name);
-        }
-      }
+      TRY(add_folder(SubFileKind::Texture, node, cdic, textures));
     } else if (node.name == "AnmClr(NW4R)") {
-      for (auto& sub : cdic.nodes) {
-        EXPECT(sub.stream_pos);
-        reader.seekSet(sub.stream_pos);
-
-        auto& clr = clrs.emplace_back();
-        auto ok = clr.read(reader);
-        if (!ok) {
-          return std::unexpected(
-              std::format("Failed to read CLR0 {}: {}", sub.name, ok.error()));
-        }
-      }
+      TRY(add_folder(SubFileKind::Clr, node, cdic, clrs));
     } else if (node.name == "AnmTexPat(NW4R)") {
-      for (auto& sub : cdic.nodes) {
-        EXPECT(sub.stream_pos);
-        reader.seekSet(sub.stream_pos);
-
-        auto& pat = pats.emplace_back();
-        auto ok = pat.read(reader);
-        if (!ok) {
-          return std::unexpected(
-              std::format("Failed to read PAT0 {}: {}", sub.name, ok.error()));
-        }
-      }
+      TRY(add_folder(SubFileKind::Pat, node, cdic, pats));
     } else if (node.name == "AnmTexSrt(NW4R)") {
-      for (auto& sub : cdic.nodes) {
-        EXPECT(sub.stream_pos);
-        reader.seekSet(sub.stream_pos);
-
-        auto& srt = srts.emplace_back();
-        auto ok = srt.read(reader);
-        if (!ok) {
-          return std::unexpected(
-              std::format("Failed to read SRT0 {}: {}", sub.name, ok.error()));
-        }
-      }
+      TRY(add_folder(SubFileKind::Srt, node, cdic, srts));
     } else if (node.name == "AnmVis(NW4R)") {
-      for (auto& sub : cdic.nodes) {
-        EXPECT(sub.stream_pos);
-        reader.seekSet(sub.stream_pos);
-
-        auto& vis = viss.emplace_back();
-        auto ok = vis.read(reader);
-        if (!ok) {
-          return std::unexpected(
-              std::format("Failed to read VIS0 {}: {}", sub.name, ok.error()));
-        }
-      }
+      TRY(add_folder(SubFileKind::Vis, node, cdic, viss));
     } else {
       transaction.callback(kpi::IOMessageClass::Warning, "/" + node.name,
                            "[WILL NOT BE SAVED] Unsupported folder: " +
@@ -150,6 +258,10 @@ Result<void> BinaryArchive::read(oishii::BinaryReader& reader,
     }
   }
 
+  if (!pending.empty()) {
+    TRY(ReadSubFilesParallel(*this, pending, reader, transaction));
+  }
+
   return {};
 }
 
@@ -441,32 +553,79 @@ Result<void> BinaryArchive::write(oishii::Writer& writer) {
 //
 // Intermediate
 //
+static Result<SrtAnim> ConvertSrt(const BinarySrt& srt,
+                                  kpi::LightIOTransaction& transaction) {
+  auto srt_warn = [&](std::string_view msg) {
+    transaction.callback(kpi::IOMessageClass::Warning,
+                         std::format("SRT0 {}", srt.name), msg);
+  };
+  SrtAnim json = TRY(SrtAnim::read(srt, srt_warn));
+  auto b2 = SrtAnim::write(json);
+  if (srt != b2) {
+    transaction.callback(kpi::IOMessageClass::Warning,
+                         std::format("SRT0 {}", srt.name),
+                         "SrtAnim re-encode will not be byte-matching.");
+  }
+  return json;
+}
+
 Result<Archive> Archive::from(const BinaryArchive& archive,
-                              kpi::LightIOTransaction& transaction) {
+                              kpi::LightIOTransaction& transaction,
+                              bool parallel) {
   Archive tmp;
-  for (auto& mdl : archive.models) {
-    tmp.models.emplace_back(
-        TRY(Model::from(mdl, transaction, "MDL0 " + mdl.name)));
+  if (!parallel) {
+    for (auto& mdl : archive.models) {
+      tmp.models.emplace_back(
+          TRY(Model::from(mdl, transaction, "MDL0 " + mdl.name)));
+    }
+    tmp.textures = archive.textures;
+    tmp.clrs = archive.clrs;
+    tmp.pats = archive.pats;
+    for (auto& srt : archive.srts) {
+      tmp.srts.emplace_back(TRY(ConvertSrt(srt, transaction)));
+    }
+    tmp.viss = archive.viss;
+    return tmp;
+  }
+
+  auto& scheduler = sched::TaskScheduler::shared();
+  sched::TaskGroup group;
+
+  // Models first, then SRT0s: the order they are reported in
+  const size_t num_models = archive.models.size();
+  std::deque<DeferredTransaction> deferred;
+  for (size_t i = 0; i < num_models + archive.srts.size(); ++i) {
+    deferred.emplace_back(transaction.state);
+  }
+  std::vector<Result<Model>> models(num_models);
+  std::vector<Result<SrtAnim>> srts(archive.srts.size());
+  for (size_t i = 0; i < num_models; ++i) {
+    scheduler.spawn(group, [&, i] {
+      auto& mdl = archive.models[i];
+      models[i] =
+          Model::from(mdl, deferred[i].transaction, "MDL0 " + mdl.name);
+    });
   }
-  tmp.textures = archive.textures;
+  for (size_t i = 0; i < srts.size(); ++i) {
+    scheduler.spawn(group, [&, i] {
+      srts[i] = ConvertSrt(archive.srts[i],
+                           deferred[num_models + i].transaction);
+    });
+  }
+  scheduler.spawn(group, [&] { tmp.textures = archive.textures; });
   tmp.clrs = archive.clrs;
   tmp.pats = archive.pats;
+  tmp.viss = archive.viss;
+  scheduler.wait(group);
 
-  for (auto& srt : archive.srts) {
-    auto srt_warn = [&](std::string_view msg) {
-      transaction.callback(kpi::IOMessageClass::Warning,
-                           std::format("SRT0 {}", srt.name), msg);
-    };
-    SrtAnim json = TRY(SrtAnim::read(srt, srt_warn));
-    auto b2 = SrtAnim::write(json);
-    if (srt != b2) {
-      transaction.callback(kpi::IOMessageClass::Warning,
-                           std::format("SRT0 {}", srt.name),
-                           "SrtAnim re-encode will not be byte-matching.");
-    }
-    tmp.srts.emplace_back(json);
+  for (size_t i = 0; i < num_models; ++i) {
+    deferred[i].forward(transaction);
+    tmp.models.emplace_back(TRY(std::move(models[i])));
+  }
+  for (size_t i = 0; i < srts.size(); ++i) {
+    deferred[num_models + i].forward(transaction);
+    tmp.srts.emplace_back(TRY(std::move(srts[i])));
   }
-  tmp.viss = archive.viss;
   return tmp;
 }
 Result<BinaryArchive> Archive::binary() const {
@@ -21,8 +21,11 @@ struct BinaryArchive {
   std::vector<librii::g3d::BinarySrt> srts;
   std::vector<librii::g3d::BinaryVis> viss;
 
+  //! @param parallel Parse sub-files on the shared task scheduler. Results and
+  //! diagnostics still come in dictionary order.
   Result<void> read(oishii::BinaryReader& reader,
-                    kpi::LightIOTransaction& transaction);
+                    kpi::LightIOTransaction& transaction,
+                    bool parallel = false);
   Result<void> write(oishii::Writer& writer);
 };
 struct Archive {
@@ -33,8 +36,11 @@ struct Archive {
   std::vector<librii::g3d::SrtAnim> srts;
   std::vector<librii::g3d::BinaryVis> viss;
 
+  //! @param parallel Convert models and animations on the shared task
+  //! scheduler. Results and diagnostics still come in archive order.
   static Result<Archive> from(const BinaryArchive& model,
-                              kpi::LightIOTransaction& transaction);
+                              kpi::LightIOTransaction& transaction,
+                              bool parallel = false);
   Result<BinaryArchive> binary() const;
 };
 
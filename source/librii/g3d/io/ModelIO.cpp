@@ -10,6 +10,8 @@
 #include <librii/gpu/DLPixShader.hpp>
 #include <librii/gpu/GPUMaterial.hpp>
 #include <librii/gx.h>
+#include <librii/sched/TaskScheduler.hpp>
+#include <rsl/Timer.hpp>
 
 ///// Headers of glm_io.hpp
 #include <oishii/reader/binary_reader.hxx>
@@ -288,13 +290,45 @@ Result<void> BinaryModel::read(oishii::BinaryReader& unsafeReader,
 //
 
 namespace {
+//! Vertex data of a buffer, quantized ahead of layout.
+template <typename T> struct EncodedBuffer {
+  std::vector<u8> entries;
+  std::optional<librii::g3d::MinMax<T>> bounds;
+};
+
+// Only reads |buf|, so buffers may be encoded concurrently.
+template <typename T, bool HasMinimum, bool HasDivisor,
+          librii::gx::VertexBufferKind kind>
+[[nodiscard]] Result<EncodedBuffer<T>> encodeGenericBuffer(
+    const librii::g3d::GenericBuffer<T, HasMinimum, HasDivisor, kind>& buf) {
+  EncodedBuffer<T> result;
+  if constexpr (HasMinimum) {
+    // Necessary for matching as it is not re-quantized in original files.
+    result.bounds = buf.mCachedMinMax.has_value()
+                        ? *buf.mCachedMinMax
+                        : librii::g3d::ComputeMinMax(buf);
+  }
+
+  const auto nComponents =
+      librii::gx::computeComponentCount(kind, buf.mQuantize.mComp);
+  EXPECT(nComponents.has_value());
+
+  oishii::Writer writer(0);
+  for (auto& entry : buf.mEntries) {
+    librii::gx::writeComponents(writer, entry, buf.mQuantize.mType,
+                                *nComponents, buf.mQuantize.divisor);
+  }
+  result.entries = writer.takeBuf();
+  return result;
+}
+
 // Does not write size or mdl0 offset
 template <typename T, bool HasMinimum, bool HasDivisor,
           librii::gx::VertexBufferKind kind>
-[[nodiscard]] Result<void> writeGenericBuffer(
+void writeGenericBuffer(
     const librii::g3d::GenericBuffer<T, HasMinimum, HasDivisor, kind>& buf,
-    oishii::Writer& writer, u32 header_start, NameTable& names, auto&& vc,
-    auto&& vt) {
+    const EncodedBuffer<T>& encoded, oishii::Writer& writer, u32 header_start,
+    NameTable& names, auto&& vc, auto&& vt) {
   const auto backpatch_array_ofs = writePlaceholder(writer);
   writeNameForward(names, writer, header_start, buf.mName);
   writer.write<u32>(buf.mId);
@@ -308,32 +342,57 @@ template <typename T, bool HasMinimum, bool HasDivisor,
     writer.write<u8>(0);
   }
   writer.write<u16>(buf.mEntries.size());
-  // TODO: min/max
   if constexpr (HasMinimum) {
-    auto mm = librii::g3d::ComputeMinMax(buf);
-
-    // Necessary for matching as it is not re-quantized in original files.
-    if (buf.mCachedMinMax.has_value()) {
-      mm = *buf.mCachedMinMax;
-    }
-
-    mm.min >> writer;
-    mm.max >> writer;
+    encoded.bounds->min >> writer;
+    encoded.bounds->max >> writer;
   }
 
   writer.alignTo(32);
   writeOffsetBackpatch(writer, backpatch_array_ofs, header_start);
 
-  const auto nComponents =
-      librii::gx::computeComponentCount(kind, buf.mQuantize.mComp);
-  EXPECT(nComponents.has_value());
-
-  for (auto& entry : buf.mEntries) {
-    librii::gx::writeComponents(writer, entry, buf.mQuantize.mType,
-                                *nComponents, buf.mQuantize.divisor);
-  }
+  writer.writeBytes(encoded.entries);
   writer.alignTo(32);
-  return {};
+}
+
+//! Section payloads that do not depend on where they are placed.
+struct EncodedModel {
+  std::vector<Result<EncodedMesh>> meshes;
+  std::vector<Result<EncodedBuffer<glm::vec3>>> positions;
+  std::vector<Result<EncodedBuffer<glm::vec3>>> normals;
+  std::vector<Result<EncodedBuffer<librii::gx::Color>>> colors;
+  std::vector<Result<EncodedBuffer<glm::vec2>>> texcoords;
+};
+
+// Encodes every mesh and vertex buffer concurrently, so that the layout pass
+// only has to copy them into place.
+EncodedModel encodeModel(const librii::g3d::BinaryModel& bin,
+                         std::span<const std::bitset<8>> mesh_texmtx) {
+  auto& scheduler = sched::TaskScheduler::shared();
+  sched::TaskGroup group;
+  EncodedModel result;
+
+  const auto encode_all = [&](auto& out, const auto& src, auto encode) {
+    out.resize(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+      scheduler.spawn(group, [&out, &src, encode, i] {
+        out[i] = encode(src[i], i);
+      });
+    }
+  };
+  const auto encode_buffer = [](const auto& buf, size_t) {
+    return encodeGenericBuffer(buf);
+  };
+  encode_all(result.meshes, bin.meshes,
+             [&](const librii::g3d::PolygonData& mesh, size_t i) {
+               return EncodeMesh(mesh, bin, i, mesh_texmtx[i]);
+             });
+  encode_all(result.positions, bin.positions, encode_buffer);
+  encode_all(result.normals, bin.normals, encode_buffer);
+  encode_all(result.colors, bin.colors, encode_buffer);
+  encode_all(result.texcoords, bin.texcoords, encode_buffer);
+
+  scheduler.wait(group);
+  return result;
 }
 
 void WriteShader(RelocWriter& linker, oishii::Writer& writer,
@@ -391,6 +450,20 @@ Result<void> writeModel(librii::g3d::BinaryModel& bin, oishii::Writer& writer,
   // TODO: This is a hack
   bin.info.texMtxArray = any_texmtx;
 
+  std::vector<std::bitset<8>> texmtx_needed(bin.meshes.size());
+  for (auto& [polyId, needed] : mesh_texmtx) {
+    texmtx_needed[polyId] = needed;
+  }
+
+  rsl::Timer timer;
+  const auto log_section = [&](std::string_view section) {
+    rsl::trace("{}: {}ms", section, timer.elapsed());
+    timer.reset();
+  };
+
+  auto encoded = encodeModel(bin, texmtx_needed);
+  log_section("Encoding meshes and buffers");
+
   const auto mdl_start = writer.tell();
   int d_cursor = 0;
 
@@ -516,6 +589,7 @@ Result<void> writeModel(librii::g3d::BinaryModel& bin, oishii::Writer& writer,
         return {};
       },
       true, 1));
+  log_section("Render tree");
 
   TRY(write_dict_mat("Bones", bin.bones,
                      [&](const librii::g3d::BinaryBoneData& bone,
@@ -525,6 +599,7 @@ Result<void> writeModel(librii::g3d::BinaryModel& bin, oishii::Writer& writer,
                        bone.write(names, writer, mdl_start);
                        return {};
                      }));
+  log_section("Bones");
 
   TRY(write_dict_mat(
       "Materials", bin.materials,
@@ -536,6 +611,7 @@ Result<void> writeModel(librii::g3d::BinaryModel& bin, oishii::Writer& writer,
         return {};
       },
       false, 4));
+  log_section("Materials");
 
   // Shaders
   {
@@ -565,51 +641,71 @@ Result<void> writeModel(librii::g3d::BinaryModel& bin, oishii::Writer& writer,
       WriteDictionary(_dict, writer, names);
     }
   }
+  log_section("Shaders");
 
   u32 i = 0;
   TRY(write_dict(
       "Meshes", bin.meshes,
-      [&](const librii::g3d::PolygonData& mesh,
+      [&](const librii::g3d::PolygonData&,
           std::size_t mesh_start) -> Result<void> {
-        std::bitset<8> texmtx_needed = mesh_texmtx[i];
-        return WriteMesh(writer, mesh, bin, mesh_start, names, i++,
-                         texmtx_needed);
+        const auto& mesh = encoded.meshes[i++];
+        if (!mesh) {
+          return std::unexpected(mesh.error());
+        }
+        WriteMesh(writer, *mesh, mesh_start, names);
+        return {};
       },
       false, 32));
-
+  log_section("Meshes");
+
+  // Writes a buffer with the payload encoded up front
+  const auto write_buffer = [&](const auto& buf, const auto& encoded_buf,
+                                std::size_t buf_start, auto&& vc,
+                                auto&& vt) -> Result<void> {
+    if (!encoded_buf) {
+      return std::unexpected(encoded_buf.error());
+    }
+    writeGenericBuffer(buf, *encoded_buf, writer, buf_start, names, vc, vt);
+    return {};
+  };
+  u32 pos_i = 0;
   TRY(write_dict(
       "Buffer_Position", bin.positions,
       [&](const librii::g3d::PositionBuffer& buf, std::size_t buf_start) {
-        return writeGenericBuffer(buf, writer, buf_start, names,
-                                  buf.mQuantize.mComp.position,
-                                  buf.mQuantize.mType.generic);
+        return write_buffer(buf, encoded.positions[pos_i++], buf_start,
+                            buf.mQuantize.mComp.position,
+                            buf.mQuantize.mType.generic);
       },
       false, 32));
+  u32 nrm_i = 0;
   TRY(write_dict(
       "Buffer_Normal", bin.normals,
       [&](const librii::g3d::NormalBuffer& buf, std::size_t buf_start) {
-        return writeGenericBuffer(buf, writer, buf_start, names,
-                                  buf.mQuantize.mComp.normal,
-                                  buf.mQuantize.mType.generic);
+        return write_buffer(buf, encoded.normals[nrm_i++], buf_start,
+                            buf.mQuantize.mComp.normal,
+                            buf.mQuantize.mType.generic);
       },
       false, 32));
+  u32 clr_i = 0;
   TRY(write_dict(
       "Buffer_Color", bin.colors,
       [&](const librii::g3d::ColorBuffer& buf, std::size_t buf_start) {
-        return writeGenericBuffer(buf, writer, buf_start, names,
-                                  buf.mQuantize.mComp.color,
-                                  buf.mQuantize.mType.color);
+        return write_buffer(buf, encoded.colors[clr_i++], buf_start,
+                            buf.mQuantize.mComp.color,
+                            buf.mQuantize.mType.color);
       },
       false, 32));
+  u32 uv_i = 0;
   TRY(write_dict(
       "Buffer_UV", bin.texcoords,
       [&](const librii::g3d::TextureCoordinateBuffer& buf,
           std::size_t buf_start) {
-        return writeGenericBuffer(buf, writer, buf_start, names,
-                                  buf.mQuantize.mComp.texcoord,
-                                  buf.mQuantize.mType.generic);
+        return write_buffer(buf, encoded.texcoords[uv_i++], buf_start,
+                            buf.mQuantize.mComp.texcoord,
+                            buf.mQuantize.mType.generic);
       },
       false, 32));
+  log_section("Buffers");
 
   linker.writeChildren();
   linker.label("MDL0_END");
@@ -505,7 +505,36 @@ struct BinaryPolygon {
     return {};
   }
 
-  Result<void> write(oishii::Writer& writer, NameTable& names, u32 mesh_start) {
+  // The display lists do not depend on where the mesh is placed; they only
+  // ever start 32-byte aligned.
+  Result<void> encodeDLs(EncodedMesh& out) {
+    // Write DLSetup
+    {
+      oishii::Writer writer(0);
+      dl_setup.Write(writer);
+      out.setup_cmd_size = writer.tell();
+      while (writer.tell() < 0xe0)
+        writer.write<u8>(0);
+      out.setup_dl = writer.takeBuf();
+    }
+
+    // Write VertexDataDL
+    {
+      oishii::Writer writer(0);
+      for (auto& mp : matrixPrims) {
+        TRY(writeVertexDataDL(mp, dl_setup.cache.descv, writer));
+      }
+      // DL pad
+      while (writer.tell() % 32) {
+        writer.write<u8>(0);
+      }
+      out.data_dl = writer.takeBuf();
+    }
+    return {};
+  }
+
+  void write(oishii::Writer& writer, NameTable& names, u32 mesh_start,
+             const EncodedMesh& dls) {
     // Write first part of header
     writeA(writer);
     // Write placeholders for DL pts
@@ -517,14 +546,9 @@ struct BinaryPolygon {
     // Write DLSetup
     {
       writer.alignTo(32);
-      auto setup_ba = writer.tell();
       setup.setBufAddr(writer.tell());
-      { //
-        dl_setup.Write(writer);
-      }
-      setup.setCmdSize(writer.tell() - setup_ba);
-      while (writer.tell() != setup_ba + 0xe0)
-        writer.write<u8>(0);
+      writer.writeBytes(dls.setup_dl);
+      setup.setCmdSize(dls.setup_cmd_size);
       setup.setBufSize(0xe0);
       setup.write();
     }
@@ -533,21 +557,11 @@ struct BinaryPolygon {
     {
       writer.alignTo(32);
       data.setBufAddr(writer.tell());
-      const auto data_start = writer.tell();
-      {
-        for (auto& mp : matrixPrims) {
-          TRY(writeVertexDataDL(mp, dl_setup.cache.descv, writer));
-        }
-        // DL pad
-        while (writer.tell() % 32) {
-          writer.write<u8>(0);
-        }
-      }
-      data.setCmdSize(writer.tell() - data_start);
+      writer.writeBytes(dls.data_dl);
+      data.setCmdSize(dls.data_dl.size());
       writer.alignTo(32);
       data.write();
     }
-    return {};
   }
 
   Result<void> read(rsl::SafeReader& reader, u32 start) {
@@ -759,13 +773,25 @@ Result<BinaryPolygon> toBinPoly(const librii::g3d::PolygonData& mesh,
   return bin;
 }
 
-Result<void> WriteMesh(oishii::Writer& writer,
-                       const librii::g3d::PolygonData& mesh,
-                       const librii::g3d::BinaryModel& mdl,
-                       const size_t& mesh_start, NameTable& names, u32 id,
-                       std::bitset<8> texmtx_needed) {
-  auto bin = TRY(toBinPoly(mesh, mdl, id, texmtx_needed));
-  return bin.write(writer, names, mesh_start);
+EncodedMesh::EncodedMesh() = default;
+EncodedMesh::~EncodedMesh() = default;
+EncodedMesh::EncodedMesh(EncodedMesh&&) noexcept = default;
+EncodedMesh& EncodedMesh::operator=(EncodedMesh&&) noexcept = default;
+
+Result<EncodedMesh> EncodeMesh(const librii::g3d::PolygonData& mesh,
+                               const librii::g3d::BinaryModel& mdl, u32 id,
+                               std::bitset<8> texmtx_needed) {
+  EncodedMesh result;
+  result.poly = std::make_unique<BinaryPolygon>(
+      TRY(toBinPoly(mesh, mdl, id, texmtx_needed)));
+  TRY(result.poly->encodeDLs(result));
+  return result;
+}
+
+void WriteMesh(oishii::Writer& writer, const EncodedMesh& mesh,
+               const size_t& mesh_start, NameTable& names) {
+  assert(mesh.poly != nullptr);
+  mesh.poly->write(writer, names, mesh_start, mesh);
 }
 
 } // namespace librii::g3d
@@ -22,11 +22,34 @@ ReadMesh(librii::g3d::PolygonData& poly, rsl::SafeReader& reader, bool& isValid,
 
          u32 id, bool* hasfur);
 
-Result<void> WriteMesh(oishii::Writer& writer,
-                       const librii::g3d::PolygonData& mesh,
-                       // TODO: Should not need BinaryModel
-                       const librii::g3d::BinaryModel& mdl,
-                       const size_t& mesh_start, NameTable& names, u32 id,
-                       std::bitset<8> texmtx_needed);
+struct BinaryPolygon;
+
+//! @brief A mesh with its display lists already encoded.
+//!
+//! Display lists do not depend on where the mesh ends up in the file, so
+//! meshes may be encoded concurrently and laid out in order afterwards.
+//!
+struct EncodedMesh {
+  EncodedMesh();
+  ~EncodedMesh();
+  EncodedMesh(EncodedMesh&&) noexcept;
+  EncodedMesh& operator=(EncodedMesh&&) noexcept;
+
+  std::unique_ptr<BinaryPolygon> poly;
+  //! Setup DL, padded to 0xE0 bytes
+  std::vector<u8> setup_dl;
+  u32 setup_cmd_size = 0;
+  //! Vertex data DL, padded to 32 bytes
+  std::vector<u8> data_dl;
+};
+
+//! Thread-safe: only reads |mesh| and |mdl|.
+Result<EncodedMesh> EncodeMesh(const librii::g3d::PolygonData& mesh,
+                               // TODO: Should not need BinaryModel
+                               const librii::g3d::BinaryModel& mdl, u32 id,
+                               std::bitset<8> texmtx_needed);
+
+void WriteMesh(oishii::Writer& writer, const EncodedMesh& mesh,
+               const size_t& mesh_start, NameTable& names);
 
 } // namespace librii::g3d
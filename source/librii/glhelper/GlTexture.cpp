@@ -1,4 +1,5 @@
 #include "GlTexture.hpp"
+#include <core/3d/DecodedTextureCache.hpp>
 #include <core/3d/gl.hpp>
 
 IMPORT_STD;
@@ -14,7 +15,12 @@ GlTexture::~GlTexture() {
 
 std::optional<GlTexture> GlTexture::makeTexture(const riistudio::lib3d::Texture& tex) {
 #ifdef RII_GL
-  static std::vector<u8> data(1024 * 1024 * 4 * 2);
+  auto data = riistudio::lib3d::DecodedTextureCache::shared().get(tex);
+  if (!data) {
+    rsl::error("Cannot decode texture {}: {}", tex.getName(), data.error());
+    // Upload black rather than fail, as callers expect a texture
+    data = std::make_shared<const std::vector<u8>>(tex.getDecodedSize(true));
+  }
 
   u32 gl_id;
   glGenTextures(1, &gl_id);
@@ -27,13 +33,12 @@ std::optional<GlTexture> GlTexture::makeTexture(const riistudio::lib3d::Texture&
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex.getMipmapCount());
-  tex.decode(data, true);
 
   u32 slide = 0;
   for (u32 i = 0; i <= tex.getMipmapCount(); ++i) {
     glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, tex.getWidth() >> i,
                  tex.getHeight() >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 data.data() + slide);
+                 (*data)->data() + slide);
     slide += (tex.getWidth() >> i) * (tex.getHeight() >> i) * 4;
   }
 
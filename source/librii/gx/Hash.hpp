@@ -0,0 +1,132 @@
+#pragma once
+
+#include <bit>
+#include <librii/gx.h>
+
+namespace librii::gx {
+
+//! @brief Combines the fields of a struct into a hash.
+//!
+//! Only fields the struct's operator== compares may be added, so that equal
+//! values hash equally. Floats are added such that -0 and 0 hash alike.
+//!
+class HashBuilder {
+public:
+  template <typename T>
+    requires std::is_integral_v<T> || std::is_enum_v<T>
+  HashBuilder& add(T x) {
+    return mix(static_cast<u64>(x));
+  }
+  HashBuilder& add(f32 x) { return mix(std::bit_cast<u32>(x + 0.0f)); }
+  template <glm::length_t L> HashBuilder& add(const glm::vec<L, f32>& v) {
+    for (glm::length_t i = 0; i < L; ++i) {
+      add(v[i]);
+    }
+    return *this;
+  }
+  HashBuilder& add(const std::string& s) {
+    return mix(std::hash<std::string>{}(s));
+  }
+
+  template <typename... Ts> HashBuilder& combine(const Ts&... xs) {
+    (add(xs), ...);
+    return *this;
+  }
+
+  size_t get() const { return mHash ^ (mHash >> 32); }
+
+private:
+  HashBuilder& mix(u64 x) {
+    mHash = (mHash ^ x) * 0x100'0000'01b3;
+    return *this;
+  }
+
+  u64 mHash = 0xcbf2'9ce4'8422'2325;
+};
+
+//! @brief Hash functor for GX state, for pooling material data.
+//!
+struct Hash {
+  template <typename T>
+    requires std::is_integral_v<T> || std::is_enum_v<T>
+  size_t operator()(T x) const {
+    return HashBuilder{}.add(x).get();
+  }
+  size_t operator()(const Color& c) const {
+    return HashBuilder{}.combine(c.r, c.g, c.b, c.a).get();
+  }
+  size_t operator()(const ColorS10& c) const {
+    return HashBuilder{}.combine(c.r, c.g, c.b, c.a).get();
+  }
+  size_t operator()(const ChannelControl& c) const {
+    return HashBuilder{}
+        .combine(c.enabled, c.Ambient, c.Material, c.lightMask, c.diffuseFn,
+                 c.attenuationFn)
+        .get();
+  }
+  size_t operator()(const TexCoordGen& g) const {
+    return HashBuilder{}
+        .combine(g.func, g.sourceParam, g.matrix, g.normalize, g.postMatrix)
+        .get();
+  }
+  size_t operator()(const TevStage& s) const {
+    const auto& c = s.colorStage;
+    const auto& a = s.alphaStage;
+    const auto& i = s.indirectStage;
+    return HashBuilder{}
+        .combine(s.rasOrder, s.texMap, s.texCoord, s.rasSwap, s.texMapSwap)
+        .combine(c.constantSelection, c.a, c.b, c.c, c.d, c.formula, c.bias,
+                 c.scale, c.clamp, c.out)
+        .combine(a.a, a.b, a.c, a.d, a.formula, a.constantSelection, a.bias,
+                 a.scale, a.clamp, a.out)
+        .combine(i.indStageSel, i.format, i.bias, i.matrix, i.wrapU, i.wrapV,
+                 i.addPrev, i.utcLod, i.alpha)
+        .get();
+  }
+  size_t operator()(const SwapTableEntry& e) const {
+    return HashBuilder{}.combine(e.r, e.g, e.b, e.a).get();
+  }
+  size_t operator()(const AlphaComparison& c) const {
+    return HashBuilder{}
+        .combine(c.compLeft, c.refLeft, c.op, c.compRight, c.refRight)
+        .get();
+  }
+  size_t operator()(const BlendMode& b) const {
+    return HashBuilder{}.combine(b.type, b.source, b.dest, b.logic).get();
+  }
+  size_t operator()(const ZMode& z) const {
+    return HashBuilder{}.combine(z.compare, z.function, z.update).get();
+  }
+  size_t operator()(const GCMaterialData::TexMatrix& m) const {
+    HashBuilder h;
+    h.combine(m.projection, m.scale, m.rotate, m.translate);
+    for (f32 x : m.effectMatrix) {
+      h.add(x);
+    }
+    return h
+        .combine(m.transformModel, m.method, m.option, m.camIdx, m.lightIdx)
+        .get();
+  }
+  size_t operator()(const GCMaterialData::SamplerData& s) const {
+    return HashBuilder{}
+        .combine(s.mTexture, s.mPalette, s.mWrapU, s.mWrapV, s.bEdgeLod,
+                 s.bBiasClamp, s.mMaxAniso, s.mMinFilter, s.mMagFilter,
+                 s.mLodBias, s.btiId)
+        .get();
+  }
+  //! Hashes the fields that most often tell materials apart.
+  size_t operator()(const GCMaterialData& m) const {
+    HashBuilder h;
+    h.combine(m.name, m.cullMode, m.mStages.size(), m.texGens.size(),
+              m.samplers.size());
+    for (const auto& stage : m.mStages) {
+      h.add((*this)(stage));
+    }
+    for (const auto& sampler : m.samplers) {
+      h.add((*this)(sampler));
+    }
+    return h.get();
+  }
+};
+
+} // namespace librii::gx
@@ -41,9 +41,10 @@ template <u32 W, u32 H> struct NullTexture : public riistudio::lib3d::Texture {
   u32 getEncodedSize(bool mip) const override {
     return data.pixels_rgba32raw.size();
   }
-  Result<void> decode(std::vector<u8>& out, bool mip) const override {
-    out.insert(out.begin(), data.pixels_rgba32raw.begin(),
-               data.pixels_rgba32raw.end());
+  Result<void> decodeInto(std::span<u8> out, bool mip) const override {
+    if (out.size() < data.pixels_rgba32raw.size())
+      return std::unexpected("Decode target is too small");
+    std::ranges::copy(data.pixels_rgba32raw, out.begin());
     return {};
   }
 
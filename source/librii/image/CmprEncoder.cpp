@@ -3,8 +3,11 @@
  * @brief CMPR encoding. Based on WIMGT's implementation.
  */
 
+#include "CmprEncoder.hpp"
+
 #include <core/common.h>
 
+#include <librii/sched/TaskScheduler.hpp>
 #include <oishii/util/util.hxx>
 
 IMPORT_STD;
@@ -377,6 +380,173 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
   memcpy(info->p[0], sum[best0].col, 4);
   memcpy(info->p[1], sum[best1].col, 4);
 }
+// Inset bounding box of the opaque colors. The box diagonal is flipped per
+// channel when that channel falls as green rises, so gradients like red to
+// green are not fit along the wrong axis.
+static inline void FAST_CMPR(const u8* data, cmpr_info_t* info) {
+  assert(info);
+  memset(info, 0, sizeof(*info));
+
+  u32 lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0}, sum[3] = {0, 0, 0};
+  u32 opaque_count = 0;
+  const u8* data_end = data + CMPR_DATA_SIZE;
+  for (const u8* dat = data; dat < data_end; dat += 4) {
+    if (dat[3] & 0x80) {
+      opaque_count++;
+      for (u32 c = 0; c < 3; c++) {
+        lo[c] = std::min<u32>(lo[c], dat[c]);
+        hi[c] = std::max<u32>(hi[c], dat[c]);
+        sum[c] += dat[c];
+      }
+    }
+  }
+
+  info->opaque_count = opaque_count;
+  if (!opaque_count)
+    return;
+
+  // Sign of the covariance of red and blue against green
+  int cov[3] = {0, 0, 0};
+  for (const u8* dat = data; dat < data_end; dat += 4) {
+    if (dat[3] & 0x80) {
+      const int g = (int)(dat[1] * opaque_count) - (int)sum[1];
+      cov[0] += g * ((int)(dat[0] * opaque_count) - (int)sum[0]) >> 8;
+      cov[2] += g * ((int)(dat[2] * opaque_count) - (int)sum[2]) >> 8;
+    }
+  }
+
+  for (u32 c = 0; c < 3; c++) {
+    const u32 inset = (hi[c] - lo[c]) >> 4;
+    u8 p0 = hi[c] - inset;
+    u8 p1 = lo[c] + inset;
+    if (cov[c] < 0)
+      std::swap(p0, p1);
+    info->p[0][c] = p0;
+    info->p[1][c] = p1;
+  }
+  info->p[0][3] = 0xff;
+  info->p[1][3] = 0xff;
+}
+
+// Palette index of pixel |i| in an encoded sub-block
+static inline u32 CMPR_index(const u8* block, u32 i) {
+  return block[4 + i / 4] >> (6 - 2 * (i % 4)) & 3;
+}
+
+// Squared RGB error of the opaque pixels against the closed palette
+static inline u32 CMPR_block_error(const u8* data, const cmpr_info_t* info,
+                                   const u8* block) {
+  u32 err = 0;
+  for (u32 i = 0; i < CMPR_MAX_COL; i++, data += 4) {
+    if (!(data[3] & 0x80))
+      continue;
+    const u8* pal = info->p[CMPR_index(block, i)];
+    for (u32 c = 0; c < 3; c++) {
+      const int d = (int)data[c] - (int)pal[c];
+      err += d * d;
+    }
+  }
+  return err;
+}
+
+// Least-squares endpoints for the index assignment of |block|. Each pixel is
+// modelled as w * p0 + (1 - w) * p1, where w is fixed by its index.
+static inline bool CMPR_fit_endpoints(const u8* data, const u8* block,
+                                      cmpr_info_t* info) {
+  static constexpr float weights4[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+  static constexpr float weights3[4] = {1.0f, 0.0f, 0.5f, 0.0f};
+  const float* weights =
+      info->opaque_count < CMPR_MAX_COL ? weights3 : weights4;
+
+  float aa = 0, ab = 0, bb = 0;
+  float ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+  for (u32 i = 0; i < CMPR_MAX_COL; i++, data += 4) {
+    if (!(data[3] & 0x80))
+      continue;
+    const float a = weights[CMPR_index(block, i)];
+    const float b = 1.0f - a;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (u32 c = 0; c < 3; c++) {
+      ax[c] += a * data[c];
+      bx[c] += b * data[c];
+    }
+  }
+
+  const float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-4f)
+    return false; // Every pixel shares one index
+
+  for (u32 c = 0; c < 3; c++) {
+    const float p0 = (bb * ax[c] - ab * bx[c]) / det;
+    const float p1 = (aa * bx[c] - ab * ax[c]) / det;
+    info->p[0][c] = (u8)std::clamp(std::lround(p0), 0l, 255l);
+    info->p[1][c] = (u8)std::clamp(std::lround(p1), 0l, 255l);
+  }
+  info->p[0][3] = 0xff;
+  info->p[1][3] = 0xff;
+  return true;
+}
+
+// Refine endpoints by alternating index assignment and endpoint fit while
+// the error keeps dropping. Returns the final error.
+static inline u32 CMPR_refine(const u8* data, cmpr_info_t* info, u8* dest) {
+  enum { MAX_ITERATIONS = 8 };
+
+  CMPR_close_info(data, info, dest);
+  u32 best_err = CMPR_block_error(data, info, dest);
+  for (u32 iter = 0; iter < MAX_ITERATIONS && best_err; iter++) {
+    cmpr_info_t trial = *info;
+    if (!CMPR_fit_endpoints(data, dest, &trial))
+      break;
+    u8 block[8];
+    CMPR_close_info(data, &trial, block);
+    const u32 err = CMPR_block_error(data, &trial, block);
+    if (err >= best_err)
+      break;
+    best_err = err;
+    *info = trial;
+    memcpy(dest, block, sizeof(block));
+  }
+  return best_err;
+}
+
+// Refine both the WIMGT and the bounding box endpoints, keeping the better.
+static inline void CLUSTER_CMPR(const u8* data, u8* dest) {
+  cmpr_info_t info;
+  WIMGT_CMPR(data, &info);
+  if (!info.opaque_count) {
+    CMPR_close_info(data, &info, dest);
+    return;
+  }
+  const u32 err = CMPR_refine(data, &info, dest);
+  if (!err)
+    return;
+
+  u8 block[8];
+  FAST_CMPR(data, &info);
+  if (CMPR_refine(data, &info, block) < err)
+    memcpy(dest, block, sizeof(block));
+}
+
+static inline void CMPR_encode_block(const u8* data, u8* dest,
+                                     CmprQuality quality) {
+  cmpr_info_t info;
+  switch (quality) {
+  case CmprQuality::Fast:
+    FAST_CMPR(data, &info);
+    break;
+  case CmprQuality::Wimgt:
+    WIMGT_CMPR(data, &info);
+    break;
+  case CmprQuality::Cluster:
+    CLUSTER_CMPR(data, dest);
+    return;
+  }
+  CMPR_close_info(data, &info, dest);
+}
+
 struct Image_t;
 u32 CalcImageSize(u32 width,  // width of image in pixel
                   u32 height, // height of image in pixel
@@ -428,28 +598,20 @@ CalcImageBlock(u32 width, u32 height,
     *img_size = size;
 }
 
-void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height) {
-  assert(dest_img);
-  assert(source_img);
-
-  const u32 bits_per_pixel = 4;
+// Encode block rows [row_begin, row_end). Each row of 8x8 blocks reads
+// |line_size| * 8 source bytes and writes |h_blocks| * 32 bytes.
+static void EncodeDXT1Rows(u8* dest_img, const u8* source_img, u32 h_blocks,
+                           u32 line_size, u32 row_begin, u32 row_end,
+                           CmprQuality quality) {
   const u32 block_width = 8;
   const u32 block_height = 8;
-
-  u32 h_blocks, v_blocks, img_size;
-  CalcImageBlock(width, height, bits_per_pixel, block_width, block_height,
-                 &h_blocks, &v_blocks, &img_size);
-
-  u8* dest = dest_img;
-  const u8* src1 = source_img;
-
   const u32 block_size = block_width * 4;
-
-  const u32 xwidth = ((width + 0x1f) & ~0x1f);
-  const u32 line_size = xwidth * 4;
   const u32 delta[] = {0, 16, 4 * line_size, 4 * line_size + 16};
 
-  while (v_blocks-- > 0) {
+  u8* dest = dest_img + row_begin * h_blocks * 32;
+  const u8* src1 = source_img + row_begin * line_size * block_height;
+
+  for (u32 row = row_begin; row < row_end; row++) {
     const u8* src2 = src1;
     u32 hblk = h_blocks;
     while (hblk-- > 0) {
@@ -467,18 +629,50 @@ void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height) {
 
         //--- analyze data
 
-        cmpr_info_t info;
-        WIMGT_CMPR(vector, &info);
-        CMPR_close_info(vector, &info, dest);
+        CMPR_encode_block(vector, dest, quality);
         dest += 8;
       }
       src2 += block_size;
     }
     src1 += line_size * block_height;
   }
+}
+
+void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height,
+                CmprQuality quality, bool parallel) {
+  assert(dest_img);
+  assert(source_img);
+
+  const u32 bits_per_pixel = 4;
+  const u32 block_width = 8;
+  const u32 block_height = 8;
 
-  assert(dest == dest_img + img_size);
-  // assert(src1 <= dest_img->data + dest_img->data_size);
+  u32 h_blocks, v_blocks, img_size;
+  CalcImageBlock(width, height, bits_per_pixel, block_width, block_height,
+                 &h_blocks, &v_blocks, &img_size);
+  assert(h_blocks * v_blocks * 32 == img_size);
+
+  const u32 line_size = h_blocks * block_width * 4;
+
+  auto& scheduler = sched::TaskScheduler::shared();
+  if (!parallel || v_blocks < 2 || scheduler.numThreads() < 2) {
+    EncodeDXT1Rows(dest_img, source_img, h_blocks, line_size, 0, v_blocks,
+                   quality);
+    return;
+  }
+
+  // A few shards per thread evens out rows of uneven cost
+  const u32 num_shards = std::min(v_blocks, scheduler.numThreads() * 4);
+  const u32 rows_per_shard = (v_blocks + num_shards - 1) / num_shards;
+  sched::TaskGroup group;
+  for (u32 begin = 0; begin < v_blocks; begin += rows_per_shard) {
+    const u32 end = std::min(begin + rows_per_shard, v_blocks);
+    scheduler.spawn(group, [=] {
+      EncodeDXT1Rows(dest_img, source_img, h_blocks, line_size, begin, end,
+                     quality);
+    });
+  }
+  scheduler.wait(group);
 }
 
 } // namespace librii::image
@@ -4,15 +4,29 @@
 
 namespace librii::image {
 
+//! @brief Endpoint selection used for each 4x4 CMPR sub-block.
+//!
+enum class CmprQuality {
+  Fast,    //!< Inset bounding box of the block's colors. No search.
+  Wimgt,   //!< Best pair of the block's own colors (Wiimm's search).
+  Cluster, //!< Wimgt, then refined by iterative least-squares cluster fit.
+};
+
 //! @brief Encode a RGBA32 buffer to GC DXT1.
 //!
-//! @param[in] dest   Pointer to the output buffer. Must be appropriately sized.
-//! (Call procedure)
-//! @param[in] source Pointer to the source buffer. Must be appropriately sized.
-//! (width * height * 4)
-//! @param[in] width  Width of the image.
-//! @param[in] height Height of the image.
+//! Rows of blocks are independent and may be sharded across the shared task
+//! scheduler. The output does not depend on |parallel|.
+//!
+//! @param[in] dest     Pointer to the output buffer. Must be appropriately
+//! sized. (Call procedure)
+//! @param[in] source   Pointer to the source buffer. Whole 8x8 blocks are
+//! read, with rows |width| rounded up to 8 texels apart.
+//! @param[in] width    Width of the image.
+//! @param[in] height   Height of the image.
+//! @param[in] quality  Endpoint selection tier.
+//! @param[in] parallel Whether to encode rows of blocks concurrently.
 //!
-void EncodeDXT1(u8* dest, const u8* source, u32 width, u32 height);
+void EncodeDXT1(u8* dest, const u8* source, u32 width, u32 height,
+                CmprQuality quality = CmprQuality::Wimgt, bool parallel = true);
 
 } // namespace librii::image
@@ -0,0 +1,250 @@
+#include "FormatAnalyzer.hpp"
+
+#include "ImagePlatform.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+// SSE2 is part of the x64 baseline
+#define FORMAT_ANALYZER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+IMPORT_STD;
+
+namespace librii::image {
+
+namespace {
+
+// Texels are read as little-endian u32s: red in the low byte, alpha in the
+// high byte. Each flag stays zero until some texel contradicts it.
+struct ScanFlags {
+  u32 color = 0;      // Red, green and blue differ
+  u32 not_opaque = 0; // Alpha below 255
+  u32 graded = 0;     // Alpha neither 0 nor 255
+};
+
+void ScanScalar(const u8* texels, size_t count, ScanFlags& flags) {
+  for (size_t i = 0; i < count; ++i) {
+    u32 c;
+    memcpy(&c, texels + i * 4, 4);
+    const u32 a = c >> 24;
+    flags.color |= (c ^ (c >> 8)) & 0xffff;
+    flags.not_opaque |= a ^ 0xff;
+    flags.graded |= a != 0 && a != 0xff;
+  }
+}
+
+#ifdef FORMAT_ANALYZER_SSE2
+// Returns the number of texels scanned, a multiple of four
+size_t ScanSSE2(const u8* texels, size_t count, ScanFlags& flags) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi32(-1);
+  const __m128i rgb_mask = _mm_set1_epi32(0xffff);
+  const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xff000000));
+  __m128i color = zero, not_opaque = zero, graded = zero;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i * 4));
+    // r ^ g and g ^ b
+    const __m128i diff = _mm_xor_si128(v, _mm_srli_epi32(v, 8));
+    color = _mm_or_si128(color, _mm_and_si128(diff, rgb_mask));
+    const __m128i a = _mm_and_si128(v, alpha_mask);
+    const __m128i opaque = _mm_cmpeq_epi32(a, alpha_mask);
+    const __m128i clear = _mm_cmpeq_epi32(a, zero);
+    not_opaque = _mm_or_si128(not_opaque, _mm_xor_si128(opaque, ones));
+    graded = _mm_or_si128(
+        graded, _mm_xor_si128(_mm_or_si128(opaque, clear), ones));
+  }
+  const auto any = [&](__m128i x) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xffff;
+  };
+  flags.color |= any(color);
+  flags.not_opaque |= any(not_opaque);
+  flags.graded |= any(graded);
+  return i;
+}
+#endif
+
+// Distinct colors, stopping once there are more than |limit|
+u32 CountColors(std::span<const u8> rgba, u32 limit) {
+  // Open addressing, kept under half full
+  const u32 bits = std::bit_width(std::bit_ceil(limit + 1) * 2 - 1);
+  std::vector<u32> slots(size_t(1) << bits);
+  std::vector<bool> used(slots.size());
+  u32 count = 0;
+  u32 last = 0;
+  for (size_t i = 0; i + 4 <= rgba.size(); i += 4) {
+    u32 c;
+    memcpy(&c, rgba.data() + i, 4);
+    // Runs of one color are common
+    if (i != 0 && c == last) {
+      continue;
+    }
+    last = c;
+    size_t slot = (c * 0x9e37'79b1u) >> (32 - bits);
+    while (used[slot] && slots[slot] != c) {
+      slot = (slot + 1) & (slots.size() - 1);
+    }
+    if (!used[slot]) {
+      used[slot] = true;
+      slots[slot] = c;
+      if (++count > limit) {
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+// The color of fully transparent texels is invisible, so only their alpha is
+// compared
+double Psnr(std::span<const u8> a, std::span<const u8> b, bool with_alpha) {
+  u64 sum = 0;
+  u64 samples = 0;
+  const auto add = [&](size_t i) {
+    const int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+    sum += d * d;
+    ++samples;
+  };
+  for (size_t i = 0; i + 4 <= a.size(); i += 4) {
+    if (with_alpha) {
+      add(i + 3);
+      if (a[i + 3] == 0) {
+        continue;
+      }
+    }
+    add(i);
+    add(i + 1);
+    add(i + 2);
+  }
+  if (sum == 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  const double mse = static_cast<double>(sum) / static_cast<double>(samples);
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+struct Candidate {
+  gx::TextureFormat format;
+  // Always meets any goal, so need not be tried
+  bool lossless = false;
+};
+
+// In order of preference among formats of equal size
+std::vector<Candidate> GetCandidates(const ImageStats& stats,
+                                     bool allow_palette) {
+  using gx::TextureFormat;
+  using gfx::PixelOcclusion;
+  std::vector<Candidate> result;
+  if (stats.grayscale) {
+    if (stats.occlusion == PixelOcclusion::Opaque) {
+      // Intensity formats replicate I into alpha, which opaque images ignore
+      result.push_back({TextureFormat::I4});
+      result.push_back({TextureFormat::I8, true});
+    } else {
+      result.push_back({TextureFormat::IA4});
+    }
+    result.push_back({TextureFormat::IA8, true});
+  }
+  if (stats.occlusion != PixelOcclusion::Translucent) {
+    // 1-bit alpha is supported
+    result.push_back({TextureFormat::CMPR});
+  }
+  // Quantizing more colors than fit is the slowest trial, and seldom beats
+  // the direct formats
+  if (allow_palette && stats.num_colors <= ImageStats::MaxCountedColors) {
+    result.push_back({TextureFormat::C8});
+  }
+  if (stats.occlusion == PixelOcclusion::Opaque) {
+    result.push_back({TextureFormat::RGB565});
+  } else {
+    result.push_back({TextureFormat::RGB5A3});
+  }
+  result.push_back({TextureFormat::RGBA8, true});
+  return result;
+}
+
+gx::PaletteFormat GetTlutFormat(const ImageStats& stats) {
+  if (stats.grayscale) {
+    return gx::PaletteFormat::IA8;
+  }
+  return stats.occlusion == gfx::PixelOcclusion::Opaque
+             ? gx::PaletteFormat::RGB565
+             : gx::PaletteFormat::RGB5A3;
+}
+
+// Encode and decode |rgba| as |format|
+Result<void> RoundTrip(std::span<u8> decoded, std::span<const u8> rgba,
+                       int width, int height, gx::TextureFormat format,
+                       gx::PaletteFormat tlut_format) {
+  std::vector<u8> encoded(getEncodedSize(width, height, format));
+  if (!gx::IsPaletteFormat(format)) {
+    TRY(transform(encoded, width, height,
+                  gx::TextureFormat::Extension_RawRGBA32, format, rgba, width,
+                  height));
+    return transform(decoded, width, height, format,
+                     gx::TextureFormat::Extension_RawRGBA32, encoded, width,
+                     height);
+  }
+  std::vector<u8> tlut(2 * 256);
+  TRY(encodeIndexed(encoded, tlut, rgba, width, height, 0, format,
+                    tlut_format));
+  return transform(decoded, width, height, format,
+                   gx::TextureFormat::Extension_RawRGBA32, encoded, width,
+                   height, 0, ResizingAlgorithm::Lanczos, tlut.data(),
+                   tlut_format);
+}
+
+} // namespace
+
+ImageStats AnalyzeImage(std::span<const u8> rgba) {
+  const size_t count = rgba.size() / 4;
+  ScanFlags flags;
+  size_t done = 0;
+#ifdef FORMAT_ANALYZER_SSE2
+  done = ScanSSE2(rgba.data(), count, flags);
+#endif
+  ScanScalar(rgba.data() + done * 4, count - done, flags);
+
+  ImageStats stats;
+  stats.grayscale = flags.color == 0;
+  stats.occlusion = flags.graded       ? gfx::PixelOcclusion::Translucent
+                    : flags.not_opaque ? gfx::PixelOcclusion::Stencil
+                                       : gfx::PixelOcclusion::Opaque;
+  stats.num_colors = CountColors(rgba, ImageStats::MaxCountedColors);
+  return stats;
+}
+
+gx::TextureFormat ChooseTextureFormat(std::span<const u8> rgba, int width,
+                                      int height, FormatGoal goal) {
+  assert(width > 0 && height > 0);
+  const auto texels = rgba.subspan(0, width * height * 4);
+  const auto stats = AnalyzeImage(texels);
+  const bool with_alpha = stats.occlusion != gfx::PixelOcclusion::Opaque;
+  const auto tlut_format = GetTlutFormat(stats);
+
+  auto candidates = GetCandidates(stats, goal.allow_palette);
+  const auto size_of = [&](const Candidate& c) {
+    // Counting the whole TLUT
+    return getEncodedSize(width, height, c.format) +
+           (gx::IsPaletteFormat(c.format) ? 2 * 256 : 0);
+  };
+  std::ranges::stable_sort(candidates, [&](const auto& a, const auto& b) {
+    return size_of(a) < size_of(b);
+  });
+
+  std::vector<u8> decoded(texels.size());
+  for (const auto& candidate : candidates) {
+    if (candidate.lossless) {
+      return candidate.format;
+    }
+    auto ok = RoundTrip(decoded, texels, width, height, candidate.format,
+                        tlut_format);
+    if (ok && Psnr(texels, decoded, with_alpha) >= goal.min_psnr) {
+      return candidate.format;
+    }
+  }
+  return gx::TextureFormat::RGBA8;
+}
+
+} // namespace librii::image
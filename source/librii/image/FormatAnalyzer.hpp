@@ -0,0 +1,53 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gfx/PixelOcclusion.hpp>
+#include <librii/gx.h>
+
+namespace librii::image {
+
+//! @brief What a RGBA32 image needs from a texture format.
+//!
+struct ImageStats {
+  //! Every texel has equal red, green and blue.
+  bool grayscale = true;
+  //! Opaque if all alpha is 255, Stencil if it is only 0 or 255.
+  gfx::PixelOcclusion occlusion = gfx::PixelOcclusion::Opaque;
+  //! Distinct colors, counted up to MaxCountedColors + 1.
+  u32 num_colors = 0;
+
+  static constexpr u32 MaxCountedColors = 256;
+};
+
+//! @brief Scan a RGBA32 buffer for grayscale, alpha usage and color count.
+//!
+//! @param[in] rgba Texels as RGBA32.
+//!
+ImageStats AnalyzeImage(std::span<const u8> rgba);
+
+//! @brief Constraints for ChooseTextureFormat.
+//!
+struct FormatGoal {
+  //! Least acceptable PSNR of the decoded texture against the source, in dB.
+  //! Alpha is ignored for opaque images, and color for transparent texels.
+  float min_psnr = 36.0f;
+  //! Consider C8 for images of at most ImageStats::MaxCountedColors colors.
+  //! Only if the texture's owner can store a TLUT.
+  bool allow_palette = false;
+};
+
+//! @brief Pick the smallest texture format that represents an image well.
+//!
+//! Formats that suit the image's ImageStats are tried in order of encoded
+//! size. Each is encoded and decoded, and the first to meet |goal| wins.
+//! RGBA8, which is lossless, is the fallback.
+//!
+//! @param[in] rgba   Base level as RGBA32.
+//! @param[in] width  Width of the image.
+//! @param[in] height Height of the image.
+//! @param[in] goal   Quality to meet.
+//!
+gx::TextureFormat ChooseTextureFormat(std::span<const u8> rgba, int width,
+                                      int height, FormatGoal goal = {});
+
+} // namespace librii::image
@@ -1,13 +1,14 @@
 #include "ImagePlatform.hpp"
 
 #include "CmprEncoder.hpp"
+#include "PaletteEncoder.hpp"
+#include "TexelEncoder.hpp"
 #include <librii/gx.h>
+#include <librii/sched/TaskScheduler.hpp>
 #include <vendor/avir/avir.h>
 #include <vendor/avir/lancir.h>
 #include <vendor/dolemu/TextureDecoder/TextureDecoder.h>
 
-#include <rsl/Ranges.hpp>
-
 IMPORT_STD;
 
 namespace librii::image {
@@ -36,231 +37,22 @@ void decode(u8* dst, const u8* src, int width, int height,
                     static_cast<TLUTFormat>(tlutformat));
 }
 
-struct rgba {
-  u8 r;
-  u8 g;
-  u8 b;
-  u8 a;
-};
-
-constexpr u8 luminosity(const rgba& rgba) {
-  return static_cast<float>(rgba.r) * 0.299 +
-         static_cast<float>(rgba.g) * 0.587 +
-         static_cast<float>(rgba.b) * 0.144;
-}
-
-void encodeI4(u8* dst, const u32* src, u32 width, u32 height) {
-  for (u32 y = 0; y < height; y += 8) {
-    for (u32 x = 0; x < width; x += 8) {
-      // Encode the 8x8 block
-      // There are 8 rows (4 bits wide) and 4 columns
-
-      for (int row = 0; row < 8; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          struct rgba_x2 {
-            rgba _0;
-            rgba _1;
-          };
-          rgba_x2 rgba = *(rgba_x2*)&src[(y + row) * width + x + column * 2];
-          u32 i0 = luminosity(rgba._0);
-          u32 i1 = luminosity(rgba._1);
-
-          u8 i0i1 = (i0 & 0b11'11'00'00) | ((i1 >> 4) & 0b11'11);
-          dst[column] = i0i1;
-        }
-        dst += 4;
-      }
-    }
-  }
-}
-void encodeI8(u8* dst, const u32* src, u32 width, u32 height) {
-  for (u32 y = 0; y < height; y += 4) {
-    for (u32 x = 0; x < width; x += 8) {
-      // Encode the 4x8 block
-      // There are 4 rows (8 bits wide) and 4 columns
-      // Same block size as I4
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 8; ++column) {
-          rgba _rgba = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column] = luminosity(_rgba);
-        }
-        dst += 8;
-      }
-    }
-  }
-}
-void encodeIA4(u8* dst, const u32* src, u32 width, u32 height) {
-  for (u32 y = 0; y < height; y += 4) {
-    for (u32 x = 0; x < width; x += 8) {
-      // Encode the 4x8 block
-      // There are 4 rows (8 bits wide) and 4 columns
-      // Same block size as I4
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 8; ++column) {
-          rgba _rgba = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column] = (luminosity(_rgba) & 0b11'11'00'00) | (_rgba.a >> 4);
-        }
-        dst += 8;
-      }
-    }
-  }
-}
-void encodeIA8(u8* dst, const u32* src, u32 width, u32 height) {
-  for (u32 y = 0; y < height; y += 4) {
-    for (u32 x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column * 2] = luminosity(c) << 8;
-          dst[column * 2 + 1] = c.a;
-        }
-        dst += 8;
-      }
-    }
-  }
-}
-
-void encodeRGB565(u8* dst, const u32* src, u32 width, u32 height) {
-  for (u32 y = 0; y < height; y += 4) {
-    for (u32 x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          u16 packed =
-              ((c.r & 0xf8) << 8) | ((c.g & 0xfc) << 3) | ((c.b & 0xf8) >> 3);
-          dst[column * 2] = packed >> 8;
-          dst[column * 2 + 1] = packed & 0xFF;
-        }
-        dst += 8;
-      }
-    }
-  }
-}
-
-void encodeRGB5A3(u8* dst, const u32* src, u32 width, u32 height) {
-  for (u32 y = 0; y < height; y += 4) {
-    for (u32 x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          u16 packed = 0;
-          if (c.a < 0xe0)
-            packed = ((c.a & 0xe0) << 7) | ((c.r & 0xf0) << 4) | (c.g & 0xf0) |
-                     ((c.b & 0xf0) >> 4);
-          else
-            packed = 0x8000 | ((c.r & 0xf8) << 7) | ((c.g & 0xf8) << 2) |
-                     ((c.b & 0xf8) >> 3);
-          dst[column * 2] = packed >> 8;
-          dst[column * 2 + 1] = packed & 0xFF;
-        }
-        dst += 8;
-      }
-    }
-  }
-}
-
-void encodeRGBA8(u8* dst, const u32* src4, u32 width, u32 height) {
-#if 0
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 2; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          rgba c2 = *(rgba*)&src[(y + row) * width + x + column + 16];
-          dst[column * 4] = c.a;
-          dst[column * 4 + 1] = c2.g;
-          dst[column * 4 + 2] = c2.b;
-          dst[column * 4 + 3] = c.r;
-        }
-        dst += 64;
-      }
-    }
-  }
-#endif
-  // From MP
-  const u8* src = reinterpret_cast<const u8*>(src4);
-  for (uint16_t block = 0; block < height; block += 4) {
-    for (uint16_t i = 0; i < width; i += 4) {
-
-      for (uint32_t c = 0; c < 4; c++) {
-        uint32_t blockWid = (((block + c) * width) + i) << 2;
-
-        *dst++ = src[blockWid + 3]; // ar = 0
-        *dst++ = src[blockWid + 0];
-        *dst++ = src[blockWid + 7]; // ar = 1
-        *dst++ = src[blockWid + 4];
-        *dst++ = src[blockWid + 11]; // ar = 2
-        *dst++ = src[blockWid + 8];
-        *dst++ = src[blockWid + 15]; // ar = 3
-        *dst++ = src[blockWid + 12];
-      }
-      for (uint32_t c = 0; c < 4; c++) {
-        uint32_t blockWid = (((block + c) * width) + i) << 2;
-
-        *dst++ = src[blockWid + 1]; // gb = 0
-        *dst++ = src[blockWid + 2];
-        *dst++ = src[blockWid + 5]; // gb = 1
-        *dst++ = src[blockWid + 6];
-        *dst++ = src[blockWid + 9]; // gb = 2
-        *dst++ = src[blockWid + 10];
-        *dst++ = src[blockWid + 13]; // gb = 3
-        *dst++ = src[blockWid + 14];
-      }
-    }
-  }
-}
-
 // raw 8-bit RGBA -> X
 Result<void> encode(u8* dst, const u8* src, int width, int height,
-                    gx::TextureFormat texformat) {
+                    gx::TextureFormat texformat, CmprQuality cmpr_quality) {
   if (texformat == gx::TextureFormat::CMPR) {
-    EncodeDXT1(dst, src, width, height);
-    return {};
-  }
-
-  if (texformat == gx::TextureFormat::I4) {
-    encodeI4(dst, (const u32*)src, width, height);
-    return {};
-  }
-
-  if (texformat == gx::TextureFormat::I8) {
-    encodeI8(dst, (const u32*)src, width, height);
+    EncodeDXT1(dst, src, width, height, cmpr_quality);
     return {};
   }
 
-  if (texformat == gx::TextureFormat::IA4) {
-    encodeIA4(dst, (const u32*)src, width, height);
+  if (EncodeTexels(dst, src, width, height, texformat)) {
     return {};
   }
 
-  if (texformat == gx::TextureFormat::IA8) {
-    encodeIA8(dst, (const u32*)src, width, height);
-    return {};
-  }
-
-  if (texformat == gx::TextureFormat::RGB565) {
-    encodeRGB565(dst, (const u32*)src, width, height);
-    return {};
-  }
-
-  if (texformat == gx::TextureFormat::RGB5A3) {
-    encodeRGB5A3(dst, (const u32*)src, width, height);
-    return {};
-  }
-
-  if (texformat == gx::TextureFormat::RGBA8) {
-    encodeRGBA8(dst, (const u32*)src, width, height);
-    return {};
+  if (gx::IsPaletteFormat(texformat)) {
+    return std::unexpected("CI formats need a palette, see encodeIndexed");
   }
-
-  // No palette support
-  return std::unexpected("No palette support");
+  return std::unexpected("Unsupported texture format");
 }
 // Change format, no resizing
 Result<void> reencode(u8* dst, const u8* src, int width, int height,
@@ -271,110 +63,161 @@ Result<void> reencode(u8* dst, const u8* src, int width, int height,
   return encode(dst, tmp.data(), width, height, newFormat);
 }
 
+namespace {
+
+constexpr auto RawRGBA32 = gx::TextureFormat::Extension_RawRGBA32;
+
+bool Overlaps(std::span<const u8> a, std::span<const u8> b) {
+  return !a.empty() && !b.empty() && a.data() < b.data() + b.size() &&
+         b.data() < a.data() + a.size();
+}
+
+} // namespace
+
 void resize(std::span<u8> dst, int dx, int dy, std::span<const u8> src, int sx,
             int sy, ResizingAlgorithm type) {
-  std::vector<u8> src_(src.begin(), src.end());
-  std::vector<u8> dst_(dst.begin(), dst.end());
+  assert(dst.size() >= static_cast<size_t>(dx * dy * 4));
+  assert(src.size() >= static_cast<size_t>(sx * sy * 4));
+  // The resizers cannot work in place
+  std::vector<u8> tmp;
+  if (Overlaps(dst, src)) {
+    tmp.assign(src.begin(), src.begin() + sx * sy * 4);
+    src = tmp;
+  }
   if (type == ResizingAlgorithm::AVIR) {
     avir::CImageResizer<> Avir8BitImageResizer(8);
     // TODO: Allow more customization (args, k)
-    Avir8BitImageResizer.resizeImage(src_.data(), sx, sy, 0, dst_.data(), dx,
-                                     dy, 4, 0);
+    Avir8BitImageResizer.resizeImage(src.data(), sx, sy, 0, dst.data(), dx, dy,
+                                     4, 0);
   } else {
     avir::CLancIR AvirLanczos;
-    AvirLanczos.resizeImage(src_.data(), sx, sy, 0, dst_.data(), dx, dy, 4, 0);
-  }
-
-  for (size_t i = 0; i < dst_.size(); ++i) {
-    dst[i] = dst_[i];
+    AvirLanczos.resizeImage(src.data(), sx, sy, 0, dst.data(), dx, dy, 4, 0);
   }
 }
 
-struct RGBA32ImageSource {
-  static Result<RGBA32ImageSource> make(std::span<const u8> buf, int w, int h,
-                                        gx::TextureFormat fmt) {
-    RGBA32ImageSource tmp;
-    tmp.mBuf = buf | rsl::ToList();
-    tmp.mW = w;
-    tmp.mH = h;
-    tmp.mFmt = fmt;
-    if (tmp.mFmt == gx::TextureFormat::Extension_RawRGBA32) {
-      tmp.mDecoded = buf | rsl::ToList();
-    } else {
-      tmp.mTmp.resize(roundUp(w, 32) * roundUp(h, 32) *
-                      4 /* Round up for SIMD */);
-      EXPECT(tmp.mBuf.size() >= getEncodedSize(w, h, tmp.mFmt));
-      decode(tmp.mTmp.data(), tmp.mBuf.data(), w, h, tmp.mFmt);
-      tmp.mDecoded = tmp.mTmp;
+namespace {
+
+// Scratch buffers shared by every level of one transform() call. Each is
+// allocated on first use; later levels are smaller and reuse it.
+struct TransformArena {
+  std::vector<u8> source;  // Snapshot of a source that overlaps the target
+  std::vector<u8> decoded; // Source as RGBA32
+  std::vector<u8> resized; // RGBA32 at the target size
+  std::vector<u8> padded;  // RGBA32 padded to whole blocks
+
+  static std::span<u8> take(std::vector<u8>& buf, size_t size) {
+    if (buf.size() < size) {
+      buf.resize(size);
     }
-    return tmp;
+    return {buf.data(), size};
   }
-
-  std::span<const u8> get() const { return mDecoded; }
-  u32 size() const { return mW * mH * 4; }
-  int width() const { return mW; }
-  int height() const { return mH; }
-
-private:
-  std::vector<u8> mTmp = {};
-  std::vector<u8> mDecoded = {};
-  std::vector<u8> mBuf = {};
-  int mW = {};
-  int mH = {};
-  gx::TextureFormat mFmt = {gx::TextureFormat::Extension_RawRGBA32};
 };
-struct RGBA32ImageTarget {
-  RGBA32ImageTarget(int w, int h) : mW(w), mH(h) {
-    mTmp.resize(roundUp(w, 32) * roundUp(h, 32) * 4);
+
+// Encoders read whole blocks, so the edges of unaligned images are repeated
+// out to the block size of |format|. Returns |rgba| itself if aligned.
+std::span<const u8> PadToBlocks(std::span<const u8> rgba, int& width,
+                                int& height, gx::TextureFormat format,
+                                TransformArena& arena) {
+  const auto info = gx::getFormatInfo(static_cast<u32>(format));
+  const int xwidth = roundUp(width, 1 << info.xshift);
+  const int xheight = roundUp(height, 1 << info.yshift);
+  if (width == xwidth && height == xheight) {
+    return rgba;
   }
-  [[nodiscard]] Result<void> copyTo(std::span<u8> dst, gx::TextureFormat fmt) {
-    if (fmt == gx::TextureFormat::Extension_RawRGBA32) {
-      EXPECT(dst.size() >= mTmp.size());
-      memcpy(dst.data(), mTmp.data(), mTmp.size());
-    } else {
-      EXPECT(dst.size() >= getEncodedSize(mW, mH, fmt));
-      EXPECT(mTmp.size() >= mW * mH * 4);
-      return encode(dst.data(), mTmp.data(), mW, mH, fmt);
+  auto padded = TransformArena::take(arena.padded, xwidth * xheight * 4);
+  for (int y = 0; y < xheight; ++y) {
+    const u8* row = rgba.data() + std::min(y, height - 1) * width * 4;
+    u8* out = padded.data() + y * xwidth * 4;
+    memcpy(out, row, width * 4);
+    for (int x = width; x < xwidth; ++x) {
+      memcpy(out + x * 4, row + (width - 1) * 4, 4);
     }
-    return {};
   }
-  void fromOtherSized(std::span<const u8> src, u32 ow, u32 oh,
-                      ResizingAlgorithm al) {
-    mTmp.resize(mW * mH * 4);
-    // assert(src.size() >= mTmp.size());
-    if (ow == mW && oh == mH) {
-      memcpy(mTmp.data(), src.data(), mTmp.size());
-    } else {
-      resize(mTmp, mW, mH, src, ow, oh, al);
+  width = xwidth;
+  height = xheight;
+  return padded;
+}
+
+Result<void> EncodeLevel(std::span<u8> dst, std::span<const u8> rgba,
+                         int width, int height, gx::TextureFormat format,
+                         TransformArena& arena,
+                         CmprQuality cmpr_quality = CmprQuality::Wimgt) {
+  EXPECT(dst.size() >=
+         static_cast<size_t>(getEncodedSize(width, height, format)));
+  rgba = PadToBlocks(rgba, width, height, format, arena);
+  return encode(dst.data(), rgba.data(), width, height, format,
+                cmpr_quality);
+}
+
+// One level of detail. Decoding, resizing and encoding are each skipped when
+// they would not change anything.
+Result<void> TransformLevel(std::span<u8> dst, int dwidth, int dheight,
+                            gx::TextureFormat oldformat,
+                            gx::TextureFormat newformat,
+                            std::span<const u8> src, int swidth, int sheight,
+                            ResizingAlgorithm algorithm, const u8* tlut,
+                            gx::PaletteFormat tlutformat,
+                            TransformArena& arena) {
+  const bool resizing = swidth != dwidth || sheight != dheight;
+  EXPECT(src.size() >=
+         static_cast<size_t>(getEncodedSize(swidth, sheight, oldformat)));
+  std::span<const u8> rgba = src;
+  if (oldformat != RawRGBA32) {
+    const auto info = gx::getFormatInfo(static_cast<u32>(oldformat));
+    const bool aligned = swidth % (1 << info.xshift) == 0 &&
+                         sheight % (1 << info.yshift) == 0;
+    if (!resizing && newformat == RawRGBA32 && aligned) {
+      // Whole blocks fill the target exactly, so decode in place
+      EXPECT(dst.size() >= static_cast<size_t>(swidth * sheight * 4));
+      decode(dst.data(), src.data(), swidth, sheight, oldformat, tlut,
+             tlutformat);
+      return {};
     }
+    // Decoders write whole blocks
+    auto decoded = TransformArena::take(
+        arena.decoded, roundUp(swidth, 32) * roundUp(sheight, 32) * 4);
+    decode(decoded.data(), src.data(), swidth, sheight, oldformat, tlut,
+           tlutformat);
+    rgba = decoded;
   }
-  void fromOtherSized(const RGBA32ImageSource& source, ResizingAlgorithm al) {
-    fromOtherSized(source.get(), source.width(), source.height(), al);
+
+  if (resizing) {
+    const size_t size = dwidth * dheight * 4;
+    auto resized = newformat == RawRGBA32
+                       ? dst.subspan(0, size)
+                       : TransformArena::take(arena.resized, size);
+    EXPECT(resized.size() == size);
+    resize(resized, dwidth, dheight, rgba, swidth, sheight, algorithm);
+    rgba = resized;
   }
-  std::span<u8> get() { return {mTmp.data(), mTmp.size()}; }
-  std::span<const u8> get() const { return {mTmp.data(), mTmp.size()}; }
-  u32 size() const { return mW * mH * 4; }
-
-private:
-  std::vector<u8> mTmp;
-  int mW;
-  int mH;
-};
-[[nodiscard]] Result<void> transform(std::span<u8> dst_, int dwidth,
+
+  if (newformat == RawRGBA32) {
+    const size_t size = dwidth * dheight * 4;
+    EXPECT(dst.size() >= size);
+    if (rgba.data() != dst.data()) {
+      memmove(dst.data(), rgba.data(), size);
+    }
+    return {};
+  }
+  return EncodeLevel(dst, rgba, dwidth, dheight, newformat, arena);
+}
+
+} // namespace
+
+[[nodiscard]] Result<void> transform(std::span<u8> dst, int dwidth,
                                      int dheight, gx::TextureFormat oldformat,
                                      std::optional<gx::TextureFormat> newformat,
-                                     std::span<const u8> src_, int swidth,
+                                     std::span<const u8> src, int swidth,
                                      int sheight, u32 mipMapCount,
-                                     ResizingAlgorithm algorithm) {
-  std::vector<u8> dst(dst_.begin(), dst_.end());
-  std::vector<u8> src(src_.begin(), src_.end());
+                                     ResizingAlgorithm algorithm,
+                                     const u8* tlut,
+                                     gx::PaletteFormat tlutformat) {
 #ifdef IMAGE_DEBUG
   printf(
       "Transform: Dest={%p, w:%i, h:%i}, Source={%p, w:%i, h:%i}, NumMip=%u\n",
       dst.data(), dwidth, dheight, src.data(), swidth, sheight, mipMapCount);
 #endif // IMAGE_DEBUG
   EXPECT(!dst.empty());
-  EXPECT(!src.empty());
   EXPECT(dwidth > 0 && dheight > 0);
   if (swidth <= 0)
     swidth = dwidth;
@@ -385,50 +228,291 @@ private:
   if (!newformat.has_value())
     newformat = oldformat;
 
-  // Determine whether to decode this sublevel as an image or many sublvels.
   if (mipMapCount >= 1) {
     if (!is_power_of_2(swidth) || !is_power_of_2(sheight) ||
         !is_power_of_2(dwidth) || !is_power_of_2(dheight)) {
       return std::unexpected(
           "It is a GPU hardware requirement that mipmaps be powers of two");
     }
-    TRY(transform(dst, dwidth, dheight, oldformat, newformat, src, swidth,
-                  sheight, 0, algorithm));
-    for (u32 i = 1; i <= mipMapCount; ++i) {
-      const auto src_lod_ofs =
-          getEncodedSize(swidth, sheight, oldformat, i - 1);
-      const auto dst_lod_ofs =
-          getEncodedSize(dwidth, dheight, newformat.value(), i - 1);
-      const auto src_lod_x = swidth >> i;
-      const auto src_lod_y = sheight >> i;
-      auto dst_lod_x = dwidth >> i;
-      auto dst_lod_y = dheight >> i;
-
-      TRY(transform(std::span(dst).subspan(dst_lod_ofs), dst_lod_x, dst_lod_y,
-                    oldformat, newformat.value(),
-                    std::span(src).subspan(src_lod_ofs), src_lod_x, src_lod_y,
-                    0, algorithm));
+  }
+
+  if (swidth == dwidth && sheight == dheight && oldformat == *newformat) {
+    const size_t size =
+        getEncodedSize(dwidth, dheight, oldformat, mipMapCount);
+    EXPECT(src.size() >= size && dst.size() >= size);
+    memmove(dst.data(), src.data(), size);
+    return {};
+  }
+  EXPECT(!gx::IsPaletteFormat(oldformat) || tlut != nullptr,
+         "CI source without a palette");
+  EXPECT(!gx::IsPaletteFormat(*newformat),
+         "CI formats need a palette, see encodeIndexed");
+
+  TransformArena arena;
+  // Later levels of the source must survive writes to earlier target levels
+  if (Overlaps(src, dst)) {
+    const size_t size = std::min<size_t>(
+        src.size(), getEncodedSize(swidth, sheight, oldformat, mipMapCount));
+    arena.source.assign(src.begin(), src.begin() + size);
+    src = arena.source;
+  }
+
+  for (u32 i = 0; i <= mipMapCount; ++i) {
+    const size_t src_lod_ofs =
+        i == 0 ? 0 : getEncodedSize(swidth, sheight, oldformat, i - 1);
+    const size_t dst_lod_ofs =
+        i == 0 ? 0 : getEncodedSize(dwidth, dheight, newformat.value(), i - 1);
+    EXPECT(src_lod_ofs <= src.size() && dst_lod_ofs <= dst.size());
+    TRY(TransformLevel(dst.subspan(dst_lod_ofs), dwidth >> i, dheight >> i,
+                       oldformat, newformat.value(),
+                       src.subspan(src_lod_ofs), swidth >> i, sheight >> i,
+                       algorithm, tlut, tlutformat, arena));
+  }
+  return {};
+}
+
+namespace {
+
+struct GammaTables {
+  std::array<float, 256> to_linear;
+  std::array<u8, 4096> to_srgb; // Indexed by linear value * 4095
+};
+
+const GammaTables& GetGammaTables() {
+  static const GammaTables tables = [] {
+    GammaTables t;
+    for (int i = 0; i < 256; ++i) {
+      const float c = i / 255.0f;
+      t.to_linear[i] = c <= 0.04045f ? c / 12.92f
+                                     : std::pow((c + 0.055f) / 1.055f, 2.4f);
     }
-  } else {
-    EXPECT(swidth > 0 && sheight > 0);
-    auto source = TRY(RGBA32ImageSource::make(src, swidth, sheight, oldformat));
-    EXPECT(source.get().size());
+    for (int i = 0; i < 4096; ++i) {
+      const float l = i / 4095.0f;
+      const float c = l <= 0.0031308f
+                          ? l * 12.92f
+                          : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+      t.to_srgb[i] = static_cast<u8>(std::lround(c * 255.0f));
+    }
+    return t;
+  }();
+  return tables;
+}
+
+// Taps of a 2:1 reduction. Output texel x is centered between source texels
+// 2x and 2x + 1; tap k reads source texel 2x + first + k.
+struct ReductionKernel {
+  int first;
+  std::vector<float> weights;
+};
+
+const ReductionKernel& GetReductionKernel(MipFilter filter) {
+  static const ReductionKernel box{0, {0.5f, 0.5f}};
+  static const ReductionKernel kaiser = [] {
+    // Modified Bessel function of the first kind, order 0
+    const auto I0 = [](double x) {
+      double sum = 1.0, term = 1.0;
+      for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+      }
+      return sum;
+    };
+    constexpr double Radius = 3.0, Beta = 4.0, Pi = 3.14159265358979323846;
+    ReductionKernel k{-2, {}};
+    double total = 0.0;
+    std::array<double, 6> w;
+    for (int i = 0; i < 6; ++i) {
+      // Distance from the output center in source texels
+      const double d = (k.first + i) - 0.5;
+      const double sinc = std::sin(Pi * d / 2.0) / (Pi * d / 2.0);
+      const double r = d / Radius;
+      w[i] = sinc * I0(Beta * std::sqrt(1.0 - r * r)) / I0(Beta);
+      total += w[i];
+    }
+    for (double x : w) {
+      k.weights.push_back(static_cast<float>(x / total));
+    }
+    return k;
+  }();
+  return filter == MipFilter::Kaiser ? kaiser : box;
+}
+
+// Reduce |lines| lines of RGBA floats 2:1, clamping at the edges.
+// |line_stride| and |step| are the texel distances between lines and along
+// them.
+void Reduce(std::span<float> dst, std::span<const float> src, int lines,
+            int src_len, int dst_len, int line_stride, int step,
+            const ReductionKernel& kernel) {
+  for (int line = 0; line < lines; ++line) {
+    for (int x = 0; x < dst_len; ++x) {
+      float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (size_t k = 0; k < kernel.weights.size(); ++k) {
+        const int sx =
+            std::clamp(2 * x + kernel.first + static_cast<int>(k), 0,
+                       src_len - 1);
+        const float* texel = &src[(line * line_stride + sx * step) * 4];
+        for (int c = 0; c < 4; ++c) {
+          acc[c] += kernel.weights[k] * texel[c];
+        }
+      }
+      float* out = &dst[(line * line_stride + x * step) * 4];
+      std::copy_n(acc, 4, out);
+    }
+  }
+}
+
+// Derive a mip level from the one above it. |scratch| holds float texels.
+void Downsample(std::span<u8> dst, int dw, int dh, std::span<const u8> src,
+                int sw, int sh, MipGenOptions options,
+                std::vector<float>& scratch) {
+  const auto& gamma = GetGammaTables();
+  const auto& kernel = GetReductionKernel(options.filter);
+  // Two planes of the source's size, keeping its row stride throughout
+  const int size = sw * sh * 4;
+  scratch.resize(size * 2);
+  std::span<float> cur(scratch.data(), size);
+  std::span<float> next(scratch.data() + size, size);
+  for (int i = 0; i < size; ++i) {
+    cur[i] = options.gamma_correct && i % 4 != 3 ? gamma.to_linear[src[i]]
+                                                 : src[i] / 255.0f;
+  }
+  if (dw < sw) {
+    Reduce(next, cur, sh, sw, dw, sw, 1, kernel);
+    std::swap(cur, next);
+  }
+  if (dh < sh) {
+    Reduce(next, cur, dw, sh, dh, 1, sw, kernel);
+    std::swap(cur, next);
+  }
+  for (int y = 0; y < dh; ++y) {
+    for (int x = 0; x < dw; ++x) {
+      const float* texel = &cur[(y * sw + x) * 4];
+      u8* out = &dst[(y * dw + x) * 4];
+      for (int c = 0; c < 4; ++c) {
+        const float v = std::clamp(texel[c], 0.0f, 1.0f);
+        out[c] = options.gamma_correct && c != 3
+                     ? gamma.to_srgb[std::lround(v * 4095.0f)]
+                     : static_cast<u8>(std::lround(v * 255.0f));
+      }
+    }
+  }
+}
 
-    // TODO: We don't always need to allocate this
-    RGBA32ImageTarget target(dwidth, dheight);
-    EXPECT(target.get().size());
+} // namespace
 
-    target.fromOtherSized(source, algorithm);
+Result<void> encodeMipChain(std::span<u8> dst, int dwidth, int dheight,
+                            gx::TextureFormat format, u32 mipMapCount,
+                            std::span<const u8> src, int swidth, int sheight,
+                            ResizingAlgorithm algorithm, MipGenOptions options,
+                            CmprQuality cmpr_quality) {
+  EXPECT(dwidth > 0 && dheight > 0);
+  EXPECT(swidth > 0 && sheight > 0);
+  EXPECT(src.size() >= static_cast<size_t>(swidth * sheight * 4));
+  EXPECT(!gx::IsPaletteFormat(format),
+         "CI formats need a palette, see encodeIndexed");
+  if (mipMapCount >= 1 && (!is_power_of_2(dwidth) || !is_power_of_2(dheight))) {
+    return std::unexpected(
+        "It is a GPU hardware requirement that mipmaps be powers of two");
+  }
+  EXPECT(dst.size() >= static_cast<size_t>(getEncodedSize(
+                           dwidth, dheight, format, mipMapCount)));
+
+  // Raw targets are the chain itself
+  std::vector<u8> chain_storage;
+  std::span<u8> chain = dst;
+  if (format != RawRGBA32) {
+    chain_storage.resize(
+        getEncodedSize(dwidth, dheight, RawRGBA32, mipMapCount));
+    chain = chain_storage;
+  }
 
-    // TODO: A copy here can be prevented
-    TRY(target.copyTo(dst, newformat.value()));
+  auto& scheduler = sched::TaskScheduler::shared();
+  sched::TaskGroup group;
+  std::vector<Result<void>> results(mipMapCount + 1);
+  std::vector<float> scratch;
+  std::span<const u8> prev;
+  int prev_w = 0, prev_h = 0;
+  for (u32 i = 0; i <= mipMapCount; ++i) {
+    const int w = std::max(dwidth >> i, 1);
+    const int h = std::max(dheight >> i, 1);
+    if (i > 0 && w == 1 && h == 1) {
+      break; // Not stored, see gx::computeImageSize
+    }
+    const auto chain_ofs =
+        i == 0 ? 0 : getEncodedSize(dwidth, dheight, RawRGBA32, i - 1);
+    const auto level = chain.subspan(chain_ofs, w * h * 4);
+    if (i > 0 && options.filter != MipFilter::Resample) {
+      Downsample(level, w, h, prev, prev_w, prev_h, options, scratch);
+    } else if (w == swidth && h == sheight) {
+      memcpy(level.data(), src.data(), level.size());
+    } else {
+      resize(level, w, h, src, swidth, sheight, algorithm);
+    }
+    prev = level;
+    prev_w = w;
+    prev_h = h;
+
+    if (format != RawRGBA32) {
+      const auto dst_ofs =
+          i == 0 ? 0 : getEncodedSize(dwidth, dheight, format, i - 1);
+      auto& result = results[i];
+      scheduler.spawn(group, [=, &result] {
+        TransformArena arena;
+        result = EncodeLevel(dst.subspan(dst_ofs), level, w, h, format, arena,
+                             cmpr_quality);
+      });
+    }
   }
+  scheduler.wait(group);
 
-  EXPECT(dst_.size() == dst.size());
-  for (size_t i = 0; i < dst_.size(); ++i) {
-    dst_[i] = dst[i];
+  for (auto& result : results) {
+    if (!result) {
+      return result;
+    }
   }
   return {};
 }
 
+Result<u32> encodeIndexed(std::span<u8> dst, std::span<u8> tlut,
+                          std::span<const u8> src, int width, int height,
+                          u32 mipMapCount, gx::TextureFormat format,
+                          gx::PaletteFormat tlutformat) {
+  EXPECT(width > 0 && height > 0);
+  EXPECT(gx::IsPaletteFormat(format));
+  if (mipMapCount >= 1 && (!is_power_of_2(width) || !is_power_of_2(height))) {
+    return std::unexpected(
+        "It is a GPU hardware requirement that mipmaps be powers of two");
+  }
+  EXPECT(dst.size() >=
+         static_cast<size_t>(
+             getEncodedSize(width, height, format, mipMapCount)));
+  const size_t raw_size =
+      getEncodedSize(width, height, RawRGBA32, mipMapCount);
+  EXPECT(src.size() >= raw_size);
+
+  // Every level shares the one TLUT
+  const auto palette = QuantizeColors(src.subspan(0, raw_size),
+                                      GetPaletteCapacity(format), tlutformat);
+  EXPECT(!palette.empty());
+  EXPECT(tlut.size() >= palette.size() * 2, "TLUT is too small");
+  EncodeTLUT(tlut.data(), palette, tlutformat);
+
+  TransformArena arena;
+  for (u32 i = 0; i <= mipMapCount; ++i) {
+    int w = std::max(width >> i, 1);
+    int h = std::max(height >> i, 1);
+    if (i > 0 && w == 1 && h == 1) {
+      break; // Not stored, see gx::computeImageSize
+    }
+    const auto src_ofs =
+        i == 0 ? 0 : getEncodedSize(width, height, RawRGBA32, i - 1);
+    const auto dst_ofs =
+        i == 0 ? 0 : getEncodedSize(width, height, format, i - 1);
+    const auto rgba = PadToBlocks(src.subspan(src_ofs), w, h, format, arena);
+    EXPECT(EncodeIndexed(dst.data() + dst_ofs, rgba.data(), w, h, format,
+                         palette, tlutformat));
+  }
+  return static_cast<u32>(palette.size());
+}
+
 } // namespace librii::image
@@ -6,6 +6,7 @@
 #include <tuple>
 
 #include <librii/gx.h>
+#include <librii/image/CmprEncoder.hpp>
 
 namespace librii::image {
 
@@ -60,12 +61,15 @@ void decode(u8* dst, const u8* src, int width, int height,
 //! @param[in] width The width of the image in pixels.
 //! @param[in] height The height of the image in pixels.
 //! @param[in] texformat The format of the image.
+//! @param[in] cmpr_quality Endpoint search used if |texformat| is CMPR.
 //!
 //! @pre For efficiency reasons, this method does not handle the case where dst
 //! == src.
 //!
-[[nodiscard]] Result<void> encode(u8* dst, const u8* src, int width, int height,
-                                  gx::TextureFormat texformat);
+[[nodiscard]] Result<void>
+encode(u8* dst, const u8* src, int width, int height,
+       gx::TextureFormat texformat,
+       CmprQuality cmpr_quality = CmprQuality::Wimgt);
 
 //! @brief Specifies an algorithm for downscaling/upscaling an image.
 //!
@@ -108,6 +112,9 @@ void resize(std::span<u8> dst, int dx, int dy, std::span<const u8> src, int sx,
 //! @param[in] mipMapCount	Number of additional levels of detail past the
 //! first image. Zero corresponds to the base image--no mipmapping.
 //! @param[in] algorithm	Algorithm to utilize for upscaling/downscaling.
+//! @param[in] tlut		Palette of the source data. Required if
+//! oldformat is color-indexed. Color-indexed targets need encodeIndexed.
+//! @param[in] tlutformat	Format of the palette.
 //!
 [[nodiscard]] Result<void>
 transform(std::span<u8> dst, int dwidth, int dheight,
@@ -115,6 +122,73 @@ transform(std::span<u8> dst, int dwidth, int dheight,
           std::optional<gx::TextureFormat> newformat = std::nullopt,
           std::span<const u8> src = {}, int sx = -1, int sy = -1,
           u32 mipMapCount = 0,
-          ResizingAlgorithm algorithm = ResizingAlgorithm::Lanczos);
+          ResizingAlgorithm algorithm = ResizingAlgorithm::Lanczos,
+          const u8* tlut = nullptr,
+          gx::PaletteFormat tlutformat = gx::PaletteFormat::IA8);
+
+//! @brief How each mip level is derived by encodeMipChain.
+//!
+enum class MipFilter {
+  Resample, //!< Resize every level from the source image.
+  Box,      //!< 2:1 average of the previous level.
+  Kaiser,   //!< 2:1 Kaiser-windowed sinc of the previous level. Sharper.
+};
+
+struct MipGenOptions {
+  MipFilter filter = MipFilter::Resample;
+  //! Filter RGB as sRGB in linear light, so levels do not darken. Not
+  //! applicable to MipFilter::Resample.
+  bool gamma_correct = false;
+};
+
+//! @brief Encode a raw RGBA32 image to a texture, generating its mip chain.
+//!
+//! Levels are generated into one shared RGBA32 buffer, and each is encoded on
+//! the shared task scheduler as soon as it is produced.
+//!
+//! @param[in] dst         Target. Must be sized for |mipMapCount| levels.
+//! @param[in] dwidth      Width of the base level in pixels.
+//! @param[in] dheight     Height of the base level in pixels.
+//! @param[in] format      Format of the target data.
+//! @param[in] mipMapCount Number of additional levels of detail past the base.
+//! @param[in] src         Raw RGBA32 source image.
+//! @param[in] sx          Width of the source image in pixels.
+//! @param[in] sy          Height of the source image in pixels.
+//! @param[in] algorithm   Algorithm for resizing the source.
+//! @param[in] options     How the remaining levels are derived.
+//! @param[in] cmpr_quality Endpoint search used if |format| is CMPR.
+//!
+[[nodiscard]] Result<void>
+encodeMipChain(std::span<u8> dst, int dwidth, int dheight,
+               gx::TextureFormat format, u32 mipMapCount,
+               std::span<const u8> src, int sx, int sy,
+               ResizingAlgorithm algorithm = ResizingAlgorithm::Lanczos,
+               MipGenOptions options = {},
+               CmprQuality cmpr_quality = CmprQuality::Wimgt);
+
+//! @brief Encode a raw RGBA32 mip chain to a color-indexed texture.
+//!
+//! One palette is chosen for the whole chain, so every level shares the TLUT.
+//!
+//! The editor does not call this yet: the J3D and G3D texture models keep no
+//! TLUT (getPaletteData() is always null), so TexFormatCombo leaves out the CI
+//! formats until they do.
+//!
+//! @param[in] dst         Target. Must be sized for |mipMapCount| levels.
+//! @param[in] tlut        Target for the palette, 2 bytes per entry. Sizing it
+//! for GetPaletteCapacity(format) entries always suffices.
+//! @param[in] src         Raw RGBA32 chain, as laid out by getEncodedSize.
+//! @param[in] width       Width of the base level in pixels.
+//! @param[in] height      Height of the base level in pixels.
+//! @param[in] mipMapCount Number of additional levels of detail past the base.
+//! @param[in] format      One of C4, C8 or C14X2.
+//! @param[in] tlutformat  Format of the palette.
+//!
+//! @return The number of palette entries written.
+//!
+[[nodiscard]] Result<u32>
+encodeIndexed(std::span<u8> dst, std::span<u8> tlut, std::span<const u8> src,
+              int width, int height, u32 mipMapCount, gx::TextureFormat format,
+              gx::PaletteFormat tlutformat = gx::PaletteFormat::RGB5A3);
 
 } // namespace librii::image
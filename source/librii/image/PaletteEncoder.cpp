@@ -0,0 +1,408 @@
+#include "PaletteEncoder.hpp"
+
+#include <queue>
+
+IMPORT_STD;
+
+namespace librii::image {
+
+namespace {
+
+// Colors are little-endian u32s: red in the low byte, alpha in the high byte.
+
+constexpr u32 Channel(u32 c, int i) { return (c >> (8 * i)) & 0xff; }
+
+constexpr u32 MakeColor(u32 r, u32 g, u32 b, u32 a) {
+  return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// Rec. 601 luma, as the direct color I8/IA8 encoders compute it
+constexpr u32 Luminosity(u32 c) {
+  return (Channel(c, 0) * 9798 + Channel(c, 1) * 19235 + Channel(c, 2) * 3735 +
+          (1 << 14)) >>
+         15;
+}
+
+// Round an 8-bit value to |bits| bits
+constexpr u32 Quantize(u32 x, u32 bits) {
+  const u32 max = (1 << bits) - 1;
+  return (x * max + 127) / 255;
+}
+
+// Expand |bits| bits to 8 by replicating them, as the GPU does
+constexpr u32 Expand(u32 x, u32 bits) {
+  u32 result = 0;
+  for (int shift = 8 - bits; shift > -static_cast<int>(bits); shift -= bits) {
+    result |= shift >= 0 ? x << shift : x >> -shift;
+  }
+  return result & 0xff;
+}
+
+// The TLUT entry for |c|, in host order
+u16 ToEntry(u32 c, gx::PaletteFormat format) {
+  switch (format) {
+  case gx::PaletteFormat::IA8:
+    return (Channel(c, 3) << 8) | Luminosity(c);
+  case gx::PaletteFormat::RGB565:
+    return (Quantize(Channel(c, 0), 5) << 11) |
+           (Quantize(Channel(c, 1), 6) << 5) | Quantize(Channel(c, 2), 5);
+  case gx::PaletteFormat::RGB5A3: {
+    const u32 a = Quantize(Channel(c, 3), 3);
+    if (a == 7) {
+      return 0x8000 | (Quantize(Channel(c, 0), 5) << 10) |
+             (Quantize(Channel(c, 1), 5) << 5) | Quantize(Channel(c, 2), 5);
+    }
+    return (a << 12) | (Quantize(Channel(c, 0), 4) << 8) |
+           (Quantize(Channel(c, 1), 4) << 4) | Quantize(Channel(c, 2), 4);
+  }
+  }
+  return 0;
+}
+
+// The color the GPU decodes from a TLUT entry
+u32 FromEntry(u16 e, gx::PaletteFormat format) {
+  switch (format) {
+  case gx::PaletteFormat::IA8: {
+    const u32 i = e & 0xff;
+    return MakeColor(i, i, i, e >> 8);
+  }
+  case gx::PaletteFormat::RGB565:
+    return MakeColor(Expand(e >> 11, 5), Expand((e >> 5) & 0x3f, 6),
+                     Expand(e & 0x1f, 5), 0xff);
+  case gx::PaletteFormat::RGB5A3:
+    if (e & 0x8000) {
+      return MakeColor(Expand((e >> 10) & 0x1f, 5), Expand((e >> 5) & 0x1f, 5),
+                       Expand(e & 0x1f, 5), 0xff);
+    }
+    return MakeColor(Expand((e >> 8) & 0xf, 4), Expand((e >> 4) & 0xf, 4),
+                     Expand(e & 0xf, 4), Expand((e >> 12) & 0x7, 3));
+  }
+  return 0;
+}
+
+u32 Snap(u32 c, gx::PaletteFormat format) {
+  return FromEntry(ToEntry(c, format), format);
+}
+
+u32 Distance(u32 a, u32 b) {
+  u32 sum = 0;
+  for (int i = 0; i < 4; ++i) {
+    const int d =
+        static_cast<int>(Channel(a, i)) - static_cast<int>(Channel(b, i));
+    sum += d * d;
+  }
+  return sum;
+}
+
+// Exact nearest-color search. Entries are sorted by green and scanned
+// outward from the query's green until that axis alone rules out the rest.
+class PaletteSearch {
+public:
+  explicit PaletteSearch(std::span<const u32> palette) {
+    mOrder.resize(palette.size());
+    std::iota(mOrder.begin(), mOrder.end(), 0);
+    std::ranges::sort(mOrder, [&](u32 a, u32 b) {
+      return Channel(palette[a], 1) < Channel(palette[b], 1);
+    });
+    for (u32 i : mOrder) {
+      mColors.push_back(palette[i]);
+      mGreen.push_back(Channel(palette[i], 1));
+    }
+  }
+
+  u32 nearest(u32 c) const {
+    const int g = Channel(c, 1);
+    const size_t start = std::ranges::lower_bound(mGreen, g) - mGreen.begin();
+    u32 best = std::numeric_limits<u32>::max();
+    size_t best_i = 0;
+    // |hi| walks up from |start|, |lo| down from |start| - 1
+    size_t hi = start, lo = start;
+    bool up = hi < mColors.size(), down = lo > 0;
+    while (up || down) {
+      if (up) {
+        const int dg = mGreen[hi] - g;
+        if (static_cast<u32>(dg * dg) >= best) {
+          up = false;
+        } else {
+          const u32 d = Distance(mColors[hi], c);
+          if (d < best) {
+            best = d;
+            best_i = hi;
+          }
+          up = ++hi < mColors.size();
+        }
+      }
+      if (down) {
+        const int dg = g - mGreen[lo - 1];
+        if (static_cast<u32>(dg * dg) >= best) {
+          down = false;
+        } else {
+          const u32 d = Distance(mColors[lo - 1], c);
+          if (d < best) {
+            best = d;
+            best_i = lo - 1;
+          }
+          down = --lo > 0;
+        }
+      }
+    }
+    return mOrder[best_i];
+  }
+
+private:
+  std::vector<u32> mOrder; // Palette index of each sorted entry
+  std::vector<u32> mColors;
+  std::vector<int> mGreen;
+};
+
+struct WeightedColor {
+  u32 color;
+  u32 count;
+};
+
+std::vector<WeightedColor> Histogram(std::span<const u8> source,
+                                     gx::PaletteFormat format) {
+  std::vector<u32> colors(source.size() / 4);
+  for (size_t i = 0; i < colors.size(); ++i) {
+    u32 c;
+    memcpy(&c, source.data() + i * 4, 4);
+    colors[i] = Snap(c, format);
+  }
+  std::ranges::sort(colors);
+  std::vector<WeightedColor> result;
+  for (u32 c : colors) {
+    if (!result.empty() && result.back().color == c) {
+      ++result.back().count;
+    } else {
+      result.push_back({c, 1});
+    }
+  }
+  return result;
+}
+
+struct Centroid {
+  std::array<double, 4> sum{};
+  double weight = 0.0;
+
+  void add(u32 c, u32 count) {
+    for (int i = 0; i < 4; ++i) {
+      sum[i] += static_cast<double>(Channel(c, i)) * count;
+    }
+    weight += count;
+  }
+  u32 color() const {
+    u32 ch[4];
+    for (int i = 0; i < 4; ++i) {
+      ch[i] = std::clamp<long>(std::lround(sum[i] / weight), 0, 255);
+    }
+    return MakeColor(ch[0], ch[1], ch[2], ch[3]);
+  }
+};
+
+// Split the widest box at its weighted median until there are |max_colors|
+std::vector<u32> MedianCut(std::vector<WeightedColor>& hist, u32 max_colors) {
+  struct Box {
+    size_t begin, end;
+    int axis;
+    u32 range;
+    bool operator<(const Box& rhs) const { return range < rhs.range; }
+  };
+  const auto make_box = [&](size_t begin, size_t end) {
+    Box box{begin, end, 0, 0};
+    for (int i = 0; i < 4; ++i) {
+      u32 lo = 255, hi = 0;
+      for (size_t j = begin; j < end; ++j) {
+        lo = std::min(lo, Channel(hist[j].color, i));
+        hi = std::max(hi, Channel(hist[j].color, i));
+      }
+      if (hi - lo > box.range) {
+        box.axis = i;
+        box.range = hi - lo;
+      }
+    }
+    return box;
+  };
+
+  std::priority_queue<Box> queue;
+  std::vector<Box> done;
+  queue.push(make_box(0, hist.size()));
+  while (!queue.empty() && queue.size() + done.size() < max_colors) {
+    const Box box = queue.top();
+    queue.pop();
+    if (box.end - box.begin < 2 || box.range == 0) {
+      done.push_back(box);
+      continue;
+    }
+    const auto first = hist.begin() + box.begin;
+    const auto last = hist.begin() + box.end;
+    std::sort(first, last, [&](const auto& a, const auto& b) {
+      return Channel(a.color, box.axis) < Channel(b.color, box.axis);
+    });
+    u64 total = 0;
+    for (auto it = first; it != last; ++it) {
+      total += it->count;
+    }
+    u64 acc = 0;
+    size_t split = box.begin;
+    while (split < box.end - 1 && (acc += hist[split].count) * 2 < total) {
+      ++split;
+    }
+    split = std::clamp(split + 1, box.begin + 1, box.end - 1);
+    queue.push(make_box(box.begin, split));
+    queue.push(make_box(split, box.end));
+  }
+  for (; !queue.empty(); queue.pop()) {
+    done.push_back(queue.top());
+  }
+
+  std::vector<u32> result;
+  for (const auto& box : done) {
+    Centroid centroid;
+    for (size_t j = box.begin; j < box.end; ++j) {
+      centroid.add(hist[j].color, hist[j].count);
+    }
+    result.push_back(centroid.color());
+  }
+  return result;
+}
+
+// Weighted Lloyd iterations, stopping early once assignments settle
+void KMeans(std::span<const WeightedColor> hist, std::vector<u32>& palette) {
+  constexpr int MaxIterations = 8;
+  std::vector<u32> assignment(hist.size(), ~0u);
+  for (int iter = 0; iter < MaxIterations; ++iter) {
+    PaletteSearch search(palette);
+    std::vector<Centroid> centroids(palette.size());
+    bool changed = false;
+    for (size_t i = 0; i < hist.size(); ++i) {
+      const u32 k = search.nearest(hist[i].color);
+      changed |= k != assignment[i];
+      assignment[i] = k;
+      centroids[k].add(hist[i].color, hist[i].count);
+    }
+    if (!changed) {
+      break;
+    }
+    for (size_t k = 0; k < palette.size(); ++k) {
+      // Empty clusters keep their color
+      if (centroids[k].weight > 0.0) {
+        palette[k] = centroids[k].color();
+      }
+    }
+  }
+}
+
+struct IndexedLayout {
+  u32 block_width;
+  u32 block_height;
+  u32 bits;
+};
+
+std::optional<IndexedLayout> GetIndexedLayout(gx::TextureFormat format) {
+  switch (format) {
+  case gx::TextureFormat::C4:
+    return IndexedLayout{8, 8, 4};
+  case gx::TextureFormat::C8:
+    return IndexedLayout{8, 4, 8};
+  case gx::TextureFormat::C14X2:
+    return IndexedLayout{4, 4, 16};
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace
+
+u32 GetPaletteCapacity(gx::TextureFormat format) {
+  switch (format) {
+  case gx::TextureFormat::C4:
+    return 16;
+  case gx::TextureFormat::C8:
+    return 256;
+  case gx::TextureFormat::C14X2:
+    return 1 << 14;
+  default:
+    return 0;
+  }
+}
+
+std::vector<u32> QuantizeColors(std::span<const u8> source, u32 max_colors,
+                                gx::PaletteFormat tlut_format) {
+  auto hist = Histogram(source, tlut_format);
+  if (hist.size() <= max_colors) {
+    std::vector<u32> exact;
+    for (const auto& it : hist) {
+      exact.push_back(it.color);
+    }
+    return exact;
+  }
+  if (max_colors == 0) {
+    return {};
+  }
+  auto palette = MedianCut(hist, max_colors);
+  KMeans(hist, palette);
+  for (auto& c : palette) {
+    c = Snap(c, tlut_format);
+  }
+  std::ranges::sort(palette);
+  palette.erase(std::unique(palette.begin(), palette.end()), palette.end());
+  return palette;
+}
+
+bool EncodeIndexed(u8* dest, const u8* source, u32 width, u32 height,
+                   gx::TextureFormat format, std::span<const u32> palette,
+                   gx::PaletteFormat tlut_format) {
+  const auto layout = GetIndexedLayout(format);
+  if (!layout || palette.empty() ||
+      palette.size() > GetPaletteCapacity(format)) {
+    return false;
+  }
+  const PaletteSearch search(palette);
+  // Neighboring texels are often identical
+  u32 last_color = 0, last_index = search.nearest(Snap(0, tlut_format));
+  for (u32 by = 0; by < height; by += layout->block_height) {
+    for (u32 bx = 0; bx < width; bx += layout->block_width) {
+      for (u32 y = 0; y < layout->block_height; ++y) {
+        const u8* row = source + ((by + y) * width + bx) * 4;
+        for (u32 x = 0; x < layout->block_width; ++x) {
+          u32 c;
+          memcpy(&c, row + x * 4, 4);
+          if (c != last_color) {
+            last_color = c;
+            // Matched as the palette was chosen: after snapping
+            last_index = search.nearest(Snap(c, tlut_format));
+          }
+          switch (layout->bits) {
+          case 4:
+            if (x % 2 == 0) {
+              *dest = last_index << 4;
+            } else {
+              *dest++ |= last_index;
+            }
+            break;
+          case 8:
+            *dest++ = last_index;
+            break;
+          case 16:
+            *dest++ = last_index >> 8;
+            *dest++ = last_index & 0xff;
+            break;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void EncodeTLUT(u8* dest, std::span<const u32> palette,
+                gx::PaletteFormat format) {
+  for (u32 c : palette) {
+    // Big-endian; IA8 entries hold alpha in the high byte, as IA8 texels do
+    const u16 entry = ToEntry(c, format);
+    *dest++ = entry >> 8;
+    *dest++ = entry & 0xff;
+  }
+}
+
+} // namespace librii::image
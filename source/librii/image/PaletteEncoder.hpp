@@ -0,0 +1,61 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gx.h>
+
+namespace librii::image {
+
+//! @brief Number of palette entries a color-indexed format can address.
+//!
+//! @return 16 for C4, 256 for C8, 16384 for C14X2 and 0 otherwise.
+//!
+u32 GetPaletteCapacity(gx::TextureFormat format);
+
+//! @brief Choose a palette for a RGBA32 buffer.
+//!
+//! Colors are first snapped to what |tlut_format| can represent, so images
+//! that already fit in |max_colors| get an exact palette. Otherwise a
+//! median-cut palette is refined by weighted k-means.
+//!
+//! @param[in] source      RGBA32 texels. May span several mip levels.
+//! @param[in] max_colors  Upper bound on the palette size.
+//! @param[in] tlut_format Format the palette will be stored in.
+//!
+//! @return Palette colors as little-endian RGBA32, each representable in
+//! |tlut_format|.
+//!
+std::vector<u32> QuantizeColors(std::span<const u8> source, u32 max_colors,
+                                gx::PaletteFormat tlut_format);
+
+//! @brief Encode a RGBA32 buffer as indices into a palette.
+//!
+//! Every texel takes the index of the palette color nearest to it once
+//! snapped to |tlut_format|, matching how QuantizeColors chose the palette.
+//!
+//! @param[in] dest    Pointer to the output buffer, sized for the image.
+//! @param[in] source  Pointer to the source buffer. Whole blocks are read, so
+//! it must be padded to them.
+//! @param[in] width   Width of the image.
+//! @param[in] height  Height of the image.
+//! @param[in] format  One of C4, C8 or C14X2.
+//! @param[in] palette Palette from QuantizeColors. At most
+//! GetPaletteCapacity(format) entries.
+//! @param[in] tlut_format Format the palette will be stored in.
+//!
+//! @return False if |format| is not color-indexed or the palette is empty or
+//! too large.
+//!
+bool EncodeIndexed(u8* dest, const u8* source, u32 width, u32 height,
+                   gx::TextureFormat format, std::span<const u32> palette,
+                   gx::PaletteFormat tlut_format);
+
+//! @brief Encode palette colors to a TLUT.
+//!
+//! @param[in] dest    Output buffer of at least 2 * |palette|.size() bytes.
+//! @param[in] palette Little-endian RGBA32 colors.
+//! @param[in] format  Format of the TLUT entries.
+//!
+void EncodeTLUT(u8* dest, std::span<const u32> palette,
+                gx::PaletteFormat format);
+
+} // namespace librii::image
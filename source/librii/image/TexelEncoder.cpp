@@ -0,0 +1,529 @@
+#include "TexelEncoder.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXEL_ENCODER_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC allows any intrinsic without enabling the instruction set
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+IMPORT_STD;
+
+namespace librii::image {
+
+namespace {
+
+// Texels are read as little-endian u32s: red in the low byte, alpha in the
+// high byte.
+
+// Rec. 601 luma weights in 1.15 fixed point. They sum to 1.0 so that white
+// stays 255, and fit the signed 16-bit multiplies of the SIMD paths.
+constexpr s16 LumR = 9798;
+constexpr s16 LumG = 19235;
+constexpr s16 LumB = 3735;
+constexpr u32 LumRound = 1 << 14;
+
+constexpr u32 Luminosity(u32 c) {
+  const u32 r = c & 0xff, g = (c >> 8) & 0xff, b = (c >> 16) & 0xff;
+  return (r * LumR + g * LumG + b * LumB + LumRound) >> 15;
+}
+
+constexpr u32 ToIA4(u32 c) { return (Luminosity(c) & 0xf0) | (c >> 28); }
+
+// Little-endian u16, so alpha is stored first
+constexpr u32 ToIA8(u32 c) { return (c >> 24) | (Luminosity(c) << 8); }
+
+constexpr u32 ToRGB565(u32 c) {
+  return ((c & 0xf8) << 8) | ((c >> 5) & 0x7e0) | ((c >> 19) & 0x1f);
+}
+
+constexpr u32 ToRGB5A3(u32 c) {
+  if ((c >> 24) < 0xe0) {
+    return ((c >> 17) & 0x7000) | ((c & 0xf0) << 4) | ((c >> 8) & 0xf0) |
+           ((c >> 20) & 0xf);
+  }
+  return 0x8000 | ((c & 0xf8) << 7) | ((c >> 6) & 0x3e0) | ((c >> 19) & 0x1f);
+}
+
+void StoreBE16(u8* dst, u32 x) {
+  dst[0] = x >> 8;
+  dst[1] = x & 0xff;
+}
+
+// Encodes one row of blocks: |src| points to the top-left texel of the row,
+// and rows are |width| texels apart.
+using BlockRowEncoder = void (*)(u8* dst, const u32* src, u32 width);
+
+//
+// Scalar reference
+//
+
+void EncodeI4Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8) {
+    for (u32 row = 0; row < 8; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 8; i += 2) {
+        *dst++ =
+            (Luminosity(texels[i]) & 0xf0) | (Luminosity(texels[i + 1]) >> 4);
+      }
+    }
+  }
+}
+void EncodeI8Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8) {
+    for (u32 row = 0; row < 4; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 8; ++i) {
+        *dst++ = Luminosity(texels[i]);
+      }
+    }
+  }
+}
+void EncodeIA4Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8) {
+    for (u32 row = 0; row < 4; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 8; ++i) {
+        *dst++ = ToIA4(texels[i]);
+      }
+    }
+  }
+}
+void EncodeIA8Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 4) {
+    for (u32 row = 0; row < 4; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 4; ++i, dst += 2) {
+        const u32 ia = ToIA8(texels[i]);
+        dst[0] = ia & 0xff;
+        dst[1] = ia >> 8;
+      }
+    }
+  }
+}
+void EncodeRGB565Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 4) {
+    for (u32 row = 0; row < 4; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 4; ++i, dst += 2) {
+        StoreBE16(dst, ToRGB565(texels[i]));
+      }
+    }
+  }
+}
+void EncodeRGB5A3Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 4) {
+    for (u32 row = 0; row < 4; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 4; ++i, dst += 2) {
+        StoreBE16(dst, ToRGB5A3(texels[i]));
+      }
+    }
+  }
+}
+// A block is 32 bytes of AR pairs followed by 32 bytes of GB pairs
+void EncodeRGBA8Scalar(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 4, dst += 64) {
+    for (u32 row = 0; row < 4; ++row) {
+      const u32* texels = src + row * width + x;
+      for (u32 i = 0; i < 4; ++i) {
+        const u32 c = texels[i];
+        u8* ar = dst + row * 8 + i * 2;
+        u8* gb = ar + 32;
+        ar[0] = c >> 24;
+        ar[1] = c & 0xff;
+        gb[0] = (c >> 8) & 0xff;
+        gb[1] = (c >> 16) & 0xff;
+      }
+    }
+  }
+}
+
+#if TEXEL_ENCODER_X64
+
+//
+// SSE4.1: four texels per vector
+//
+
+TARGET_SSE41 inline __m128i Load4(const u32* src) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+TARGET_SSE41 inline void Store16(u8* dst, __m128i v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+}
+
+// Luminosity of each texel as a 32-bit lane
+TARGET_SSE41 inline __m128i Luminosity4(__m128i c) {
+  const __m128i weights =
+      _mm_setr_epi16(LumR, LumG, LumB, 0, LumR, LumG, LumB, 0);
+  const __m128i lo = _mm_madd_epi16(_mm_cvtepu8_epi16(c), weights);
+  const __m128i hi =
+      _mm_madd_epi16(_mm_unpackhi_epi8(c, _mm_setzero_si128()), weights);
+  const __m128i sum = _mm_hadd_epi32(lo, hi);
+  return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(LumRound)), 15);
+}
+
+TARGET_SSE41 inline __m128i IA4x4(__m128i c) {
+  const __m128i i = _mm_and_si128(Luminosity4(c), _mm_set1_epi32(0xf0));
+  return _mm_or_si128(i, _mm_srli_epi32(c, 28));
+}
+TARGET_SSE41 inline __m128i IA8x4(__m128i c) {
+  return _mm_or_si128(_mm_srli_epi32(c, 24),
+                      _mm_slli_epi32(Luminosity4(c), 8));
+}
+// (x >> shift) & mask per lane; negative shifts go left
+TARGET_SSE41 inline __m128i ShiftAnd(__m128i x, int shift, u32 mask) {
+  const __m128i shifted =
+      shift >= 0 ? _mm_srli_epi32(x, shift) : _mm_slli_epi32(x, -shift);
+  return _mm_and_si128(shifted, _mm_set1_epi32(mask));
+}
+// Byte swap the low 16 bits of each lane
+TARGET_SSE41 inline __m128i SwapBE16(__m128i x) {
+  return _mm_or_si128(ShiftAnd(x, 8, 0xff), ShiftAnd(x, -8, 0xff00));
+}
+TARGET_SSE41 inline __m128i RGB565x4(__m128i c) {
+  const __m128i rgb =
+      _mm_or_si128(_mm_or_si128(ShiftAnd(c, -8, 0xf800), ShiftAnd(c, 5, 0x7e0)),
+                   ShiftAnd(c, 19, 0x1f));
+  return SwapBE16(rgb);
+}
+TARGET_SSE41 inline __m128i RGB5A3x4(__m128i c) {
+  const __m128i translucent = _mm_or_si128(
+      _mm_or_si128(ShiftAnd(c, 17, 0x7000), ShiftAnd(c, -4, 0xf00)),
+      _mm_or_si128(ShiftAnd(c, 8, 0xf0), ShiftAnd(c, 20, 0xf)));
+  const __m128i opaque = _mm_or_si128(
+      _mm_or_si128(_mm_set1_epi32(0x8000), ShiftAnd(c, -7, 0x7c00)),
+      _mm_or_si128(ShiftAnd(c, 6, 0x3e0), ShiftAnd(c, 19, 0x1f)));
+  const __m128i is_opaque =
+      _mm_cmpgt_epi32(_mm_srli_epi32(c, 24), _mm_set1_epi32(0xdf));
+  return SwapBE16(_mm_blendv_epi8(translucent, opaque, is_opaque));
+}
+
+// Two rows of eight texels, each lane already encoded, as 16 bytes
+template <__m128i (*F)(__m128i)>
+TARGET_SSE41 inline __m128i EncodeRows8x2(const u32* row0, const u32* row1) {
+  const __m128i a = _mm_packus_epi32(F(Load4(row0)), F(Load4(row0 + 4)));
+  const __m128i b = _mm_packus_epi32(F(Load4(row1)), F(Load4(row1 + 4)));
+  return _mm_packus_epi16(a, b);
+}
+
+// Eight intensities paired into four bytes, as 32-bit lanes
+TARGET_SSE41 inline __m128i I4Row(const u32* row) {
+  const __m128i l = _mm_packus_epi32(Luminosity4(Load4(row)),
+                                     Luminosity4(Load4(row + 4)));
+  return _mm_or_si128(ShiftAnd(l, 0, 0xf0), ShiftAnd(l, 20, 0x0f));
+}
+
+TARGET_SSE41 void EncodeI4SSE41(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8, dst += 32) {
+    const u32* t = src + x;
+    const __m128i r01 = _mm_packus_epi32(I4Row(t), I4Row(t + width));
+    const __m128i r23 =
+        _mm_packus_epi32(I4Row(t + 2 * width), I4Row(t + 3 * width));
+    const __m128i r45 =
+        _mm_packus_epi32(I4Row(t + 4 * width), I4Row(t + 5 * width));
+    const __m128i r67 =
+        _mm_packus_epi32(I4Row(t + 6 * width), I4Row(t + 7 * width));
+    Store16(dst, _mm_packus_epi16(r01, r23));
+    Store16(dst + 16, _mm_packus_epi16(r45, r67));
+  }
+}
+TARGET_SSE41 void EncodeI8SSE41(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8, dst += 32) {
+    const u32* t = src + x;
+    Store16(dst, EncodeRows8x2<Luminosity4>(t, t + width));
+    Store16(dst + 16, EncodeRows8x2<Luminosity4>(t + 2 * width, t + 3 * width));
+  }
+}
+TARGET_SSE41 void EncodeIA4SSE41(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8, dst += 32) {
+    const u32* t = src + x;
+    Store16(dst, EncodeRows8x2<IA4x4>(t, t + width));
+    Store16(dst + 16, EncodeRows8x2<IA4x4>(t + 2 * width, t + 3 * width));
+  }
+}
+
+// 4x4 block of 16-bit texels
+template <__m128i (*F)(__m128i)>
+TARGET_SSE41 void Encode16BitSSE41(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 4, dst += 32) {
+    const u32* t = src + x;
+    Store16(dst, _mm_packus_epi32(F(Load4(t)), F(Load4(t + width))));
+    Store16(dst + 16, _mm_packus_epi32(F(Load4(t + 2 * width)),
+                                       F(Load4(t + 3 * width))));
+  }
+}
+
+TARGET_SSE41 void EncodeRGBA8SSE41(u8* dst, const u32* src, u32 width) {
+  // Each row becomes 8 bytes of AR pairs, then 8 bytes of GB pairs
+  const __m128i split = _mm_setr_epi8(3, 0, 7, 4, 11, 8, 15, 12, //
+                                      1, 2, 5, 6, 9, 10, 13, 14);
+  for (u32 x = 0; x < width; x += 4, dst += 64) {
+    const u32* t = src + x;
+    const __m128i r0 = _mm_shuffle_epi8(Load4(t), split);
+    const __m128i r1 = _mm_shuffle_epi8(Load4(t + width), split);
+    const __m128i r2 = _mm_shuffle_epi8(Load4(t + 2 * width), split);
+    const __m128i r3 = _mm_shuffle_epi8(Load4(t + 3 * width), split);
+    Store16(dst, _mm_unpacklo_epi64(r0, r1));
+    Store16(dst + 16, _mm_unpacklo_epi64(r2, r3));
+    Store16(dst + 32, _mm_unpackhi_epi64(r0, r1));
+    Store16(dst + 48, _mm_unpackhi_epi64(r2, r3));
+  }
+}
+
+//
+// AVX2: eight texels per vector. Blocks four texels wide load two rows at a
+// time.
+//
+
+TARGET_AVX2 inline __m256i Load8(const u32* src) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+TARGET_AVX2 inline __m256i Load4x2(const u32* row0, const u32* row1) {
+  const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+  const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+TARGET_AVX2 inline void Store32(u8* dst, __m256i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+}
+// Saturate the 32-bit lanes of |a| then |b| to 16 bits, in order
+TARGET_AVX2 inline __m256i Pack32To16(__m256i a, __m256i b) {
+  return _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0b11'01'10'00);
+}
+// Saturate the 16-bit lanes of |a| then |b| to 8 bits, in order
+TARGET_AVX2 inline __m256i Pack16To8(__m256i a, __m256i b) {
+  return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0b11'01'10'00);
+}
+
+TARGET_AVX2 inline __m256i Luminosity8(__m256i c) {
+  const __m256i weights = _mm256_setr_epi16(LumR, LumG, LumB, 0, //
+                                            LumR, LumG, LumB, 0, //
+                                            LumR, LumG, LumB, 0, //
+                                            LumR, LumG, LumB, 0);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(c, zero), weights);
+  const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(c, zero), weights);
+  const __m256i sum = _mm256_hadd_epi32(lo, hi);
+  return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(LumRound)),
+                           15);
+}
+
+TARGET_AVX2 inline __m256i IA4x8(__m256i c) {
+  const __m256i i = _mm256_and_si256(Luminosity8(c), _mm256_set1_epi32(0xf0));
+  return _mm256_or_si256(i, _mm256_srli_epi32(c, 28));
+}
+TARGET_AVX2 inline __m256i IA8x8(__m256i c) {
+  return _mm256_or_si256(_mm256_srli_epi32(c, 24),
+                         _mm256_slli_epi32(Luminosity8(c), 8));
+}
+TARGET_AVX2 inline __m256i ShiftAnd(__m256i x, int shift, u32 mask) {
+  const __m256i shifted = shift >= 0 ? _mm256_srli_epi32(x, shift)
+                                     : _mm256_slli_epi32(x, -shift);
+  return _mm256_and_si256(shifted, _mm256_set1_epi32(mask));
+}
+TARGET_AVX2 inline __m256i SwapBE16(__m256i x) {
+  return _mm256_or_si256(ShiftAnd(x, 8, 0xff), ShiftAnd(x, -8, 0xff00));
+}
+TARGET_AVX2 inline __m256i RGB565x8(__m256i c) {
+  const __m256i rgb = _mm256_or_si256(
+      _mm256_or_si256(ShiftAnd(c, -8, 0xf800), ShiftAnd(c, 5, 0x7e0)),
+      ShiftAnd(c, 19, 0x1f));
+  return SwapBE16(rgb);
+}
+TARGET_AVX2 inline __m256i RGB5A3x8(__m256i c) {
+  const __m256i translucent = _mm256_or_si256(
+      _mm256_or_si256(ShiftAnd(c, 17, 0x7000), ShiftAnd(c, -4, 0xf00)),
+      _mm256_or_si256(ShiftAnd(c, 8, 0xf0), ShiftAnd(c, 20, 0xf)));
+  const __m256i opaque = _mm256_or_si256(
+      _mm256_or_si256(_mm256_set1_epi32(0x8000), ShiftAnd(c, -7, 0x7c00)),
+      _mm256_or_si256(ShiftAnd(c, 6, 0x3e0), ShiftAnd(c, 19, 0x1f)));
+  const __m256i is_opaque =
+      _mm256_cmpgt_epi32(_mm256_srli_epi32(c, 24), _mm256_set1_epi32(0xdf));
+  return SwapBE16(_mm256_blendv_epi8(translucent, opaque, is_opaque));
+}
+
+// Two rows of eight intensities, paired into four bytes each, as 32-bit lanes
+TARGET_AVX2 inline __m256i I4Rows(const u32* row0, const u32* row1) {
+  const __m256i l =
+      Pack32To16(Luminosity8(Load8(row0)), Luminosity8(Load8(row1)));
+  return _mm256_or_si256(ShiftAnd(l, 0, 0xf0), ShiftAnd(l, 20, 0x0f));
+}
+
+TARGET_AVX2 void EncodeI4AVX2(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8, dst += 32) {
+    const u32* t = src + x;
+    const __m256i r0123 = Pack32To16(I4Rows(t, t + width),
+                                     I4Rows(t + 2 * width, t + 3 * width));
+    const __m256i r4567 = Pack32To16(I4Rows(t + 4 * width, t + 5 * width),
+                                     I4Rows(t + 6 * width, t + 7 * width));
+    Store32(dst, Pack16To8(r0123, r4567));
+  }
+}
+
+// 8x4 block of 8-bit texels
+template <__m256i (*F)(__m256i)>
+TARGET_AVX2 void Encode8BitAVX2(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 8, dst += 32) {
+    const u32* t = src + x;
+    const __m256i r01 = Pack32To16(F(Load8(t)), F(Load8(t + width)));
+    const __m256i r23 =
+        Pack32To16(F(Load8(t + 2 * width)), F(Load8(t + 3 * width)));
+    Store32(dst, Pack16To8(r01, r23));
+  }
+}
+
+// 4x4 block of 16-bit texels
+template <__m256i (*F)(__m256i)>
+TARGET_AVX2 void Encode16BitAVX2(u8* dst, const u32* src, u32 width) {
+  for (u32 x = 0; x < width; x += 4, dst += 32) {
+    const u32* t = src + x;
+    const __m256i r01 = F(Load4x2(t, t + width));
+    const __m256i r23 = F(Load4x2(t + 2 * width, t + 3 * width));
+    Store32(dst, Pack32To16(r01, r23));
+  }
+}
+
+TARGET_AVX2 void EncodeRGBA8AVX2(u8* dst, const u32* src, u32 width) {
+  const __m256i split = _mm256_setr_epi8(3, 0, 7, 4, 11, 8, 15, 12,  //
+                                         1, 2, 5, 6, 9, 10, 13, 14,  //
+                                         3, 0, 7, 4, 11, 8, 15, 12,  //
+                                         1, 2, 5, 6, 9, 10, 13, 14); //
+  for (u32 x = 0; x < width; x += 4, dst += 64) {
+    const u32* t = src + x;
+    const __m256i r01 = _mm256_shuffle_epi8(Load4x2(t, t + width), split);
+    const __m256i r23 =
+        _mm256_shuffle_epi8(Load4x2(t + 2 * width, t + 3 * width), split);
+    const __m256i ar = _mm256_unpacklo_epi64(r01, r23);
+    const __m256i gb = _mm256_unpackhi_epi64(r01, r23);
+    Store32(dst, _mm256_permute4x64_epi64(ar, 0b11'01'10'00));
+    Store32(dst + 32, _mm256_permute4x64_epi64(gb, 0b11'01'10'00));
+  }
+}
+
+#endif // TEXEL_ENCODER_X64
+
+struct FormatEncoders {
+  u32 block_width;
+  u32 block_height;
+  u32 block_size;
+  BlockRowEncoder scalar;
+  BlockRowEncoder sse41 = nullptr;
+  BlockRowEncoder avx2 = nullptr;
+};
+
+#if TEXEL_ENCODER_X64
+#define SIMD_ENCODERS(sse41, avx2) , sse41, avx2
+#else
+#define SIMD_ENCODERS(sse41, avx2)
+#endif
+
+std::optional<FormatEncoders> GetFormatEncoders(gx::TextureFormat format) {
+  using enum gx::TextureFormat;
+  switch (format) {
+  case I4:
+    return FormatEncoders{
+        8, 8, 32, EncodeI4Scalar SIMD_ENCODERS(EncodeI4SSE41, EncodeI4AVX2)};
+  case I8:
+    return FormatEncoders{8, 4, 32,
+                          EncodeI8Scalar SIMD_ENCODERS(
+                              EncodeI8SSE41, Encode8BitAVX2<Luminosity8>)};
+  case IA4:
+    return FormatEncoders{8, 4, 32,
+                          EncodeIA4Scalar SIMD_ENCODERS(
+                              EncodeIA4SSE41, Encode8BitAVX2<IA4x8>)};
+  case IA8:
+    return FormatEncoders{4, 4, 32,
+                          EncodeIA8Scalar SIMD_ENCODERS(
+                              Encode16BitSSE41<IA8x4>, Encode16BitAVX2<IA8x8>)};
+  case RGB565:
+    return FormatEncoders{4, 4, 32,
+                          EncodeRGB565Scalar SIMD_ENCODERS(
+                              Encode16BitSSE41<RGB565x4>,
+                              Encode16BitAVX2<RGB565x8>)};
+  case RGB5A3:
+    return FormatEncoders{4, 4, 32,
+                          EncodeRGB5A3Scalar SIMD_ENCODERS(
+                              Encode16BitSSE41<RGB5A3x4>,
+                              Encode16BitAVX2<RGB5A3x8>)};
+  case RGBA8:
+    return FormatEncoders{
+        4, 4, 64,
+        EncodeRGBA8Scalar SIMD_ENCODERS(EncodeRGBA8SSE41, EncodeRGBA8AVX2)};
+  default:
+    return std::nullopt;
+  }
+}
+
+#undef SIMD_ENCODERS
+
+EncoderIsa DetectEncoderIsa() {
+#if TEXEL_ENCODER_X64
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  __cpuid(info, 1);
+  const bool sse41 = info[2] & (1 << 19);
+  // AVX state must also be enabled by the OS
+  const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+                   (_xgetbv(0) & 6) == 6;
+  bool avx2 = false;
+  if (avx && max_leaf >= 7) {
+    __cpuidex(info, 7, 0);
+    avx2 = info[1] & (1 << 5);
+  }
+#else
+  __builtin_cpu_init();
+  const bool sse41 = __builtin_cpu_supports("sse4.1");
+  const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+  if (avx2) {
+    return EncoderIsa::AVX2;
+  }
+  if (sse41) {
+    return EncoderIsa::SSE41;
+  }
+#endif
+  return EncoderIsa::Scalar;
+}
+
+} // namespace
+
+EncoderIsa GetBestEncoderIsa() {
+  static const EncoderIsa sIsa = DetectEncoderIsa();
+  return sIsa;
+}
+
+bool EncodeTexels(u8* dest, const u8* source, u32 width, u32 height,
+                  gx::TextureFormat format, EncoderIsa isa) {
+  const auto encoders = GetFormatEncoders(format);
+  if (!encoders) {
+    return false;
+  }
+  isa = std::min(isa, GetBestEncoderIsa());
+  BlockRowEncoder encode = encoders->scalar;
+  if (isa == EncoderIsa::AVX2 && encoders->avx2 != nullptr) {
+    encode = encoders->avx2;
+  } else if (isa >= EncoderIsa::SSE41 && encoders->sse41 != nullptr) {
+    encode = encoders->sse41;
+  }
+
+  const u32* src = reinterpret_cast<const u32*>(source);
+  const u32 blocks_per_row =
+      (width + encoders->block_width - 1) / encoders->block_width;
+  for (u32 y = 0; y < height; y += encoders->block_height) {
+    encode(dest, src + y * width, width);
+    dest += blocks_per_row * encoders->block_size;
+  }
+  return true;
+}
+
+} // namespace librii::image
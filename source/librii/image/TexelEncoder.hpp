@@ -0,0 +1,39 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gx.h>
+
+namespace librii::image {
+
+//! @brief Instruction set used by EncodeTexels.
+//!
+enum class EncoderIsa {
+  Scalar, //!< Portable reference implementation.
+  SSE41,  //!< x64 with SSE4.1.
+  AVX2,   //!< x64 with AVX2.
+};
+
+//! @brief Get the best instruction set supported by this CPU and build.
+//!
+EncoderIsa GetBestEncoderIsa();
+
+//! @brief Encode a RGBA32 buffer to a direct color GX format.
+//!
+//! Every instruction set produces identical output. Intensity is the Rec. 601
+//! luma of a texel, rounded to nearest.
+//!
+//! @param[in] dest   Pointer to the output buffer. Must be appropriately sized.
+//! @param[in] source Pointer to the source buffer. Whole blocks are read, so
+//! it must extend past the last row if |height| is not block aligned.
+//! @param[in] width  Width of the image.
+//! @param[in] height Height of the image.
+//! @param[in] format One of I4, I8, IA4, IA8, RGB565, RGB5A3 or RGBA8.
+//! @param[in] isa    Instruction set to use. Clamped to GetBestEncoderIsa().
+//!
+//! @return False if |format| is not supported.
+//!
+bool EncodeTexels(u8* dest, const u8* source, u32 width, u32 height,
+                  gx::TextureFormat format,
+                  EncoderIsa isa = GetBestEncoderIsa());
+
+} // namespace librii::image
@@ -6,6 +6,8 @@
 #include <librii/j3d/data/TextureData.hpp>
 #include <librii/j3d/data/VertexData.hpp>
 
+#include <librii/gx/Hash.hpp>
+
 #include <LibBadUIFramework/Plugins.hpp> // LightIOTransaction
 
 namespace librii::j3d {
@@ -54,9 +56,105 @@ struct Indirect {
 
   bool operator==(const Indirect& rhs) const noexcept = default;
 };
+//! @brief Hash functor for the J3D material tables.
+//!
+struct MatHash : public librii::gx::Hash {
+  using librii::gx::Hash::operator();
+
+  size_t operator()(const TevOrder& o) const {
+    return librii::gx::HashBuilder{}
+        .combine(o.rasOrder, o.texMap, o.texCoord)
+        .get();
+  }
+  size_t operator()(const SwapSel& s) const {
+    return librii::gx::HashBuilder{}.combine(s.colorChanSel, s.texSel).get();
+  }
+  size_t operator()(const Fog& f) const {
+    librii::gx::HashBuilder h;
+    h.combine(f.type, f.enabled, f.center, f.startZ, f.endZ, f.nearZ, f.farZ);
+    h.add((*this)(f.color));
+    for (u16 x : f.rangeAdjTable) {
+      h.add(x);
+    }
+    return h.get();
+  }
+  size_t operator()(const NBTScale& s) const {
+    return librii::gx::HashBuilder{}.combine(s.enable, s.scale).get();
+  }
+};
+
+//! @brief A table of unique material data, with a hash index of its entries.
+//!
+//! Lookups return the first equal entry, as a linear search would. Non-const
+//! access may edit entries, so drops the index; it is rebuilt by the next
+//! lookup. Entries appended since are indexed then, too.
+//!
+template <typename T> class MatPool {
+public:
+  //! Index of the first entry equal to |x|, or -1.
+  int find(const T& x) const {
+    sync();
+    const auto it = mIndex.find(x);
+    return it == mIndex.end() ? -1 : static_cast<int>(it->second);
+  }
+  //! Append |x| unless an equal entry exists.
+  void insert(const T& x) {
+    if (find(x) < 0) {
+      mEntries.push_back(x);
+    }
+  }
+
+  size_t size() const { return mEntries.size(); }
+  bool empty() const { return mEntries.empty(); }
+  auto begin() const { return mEntries.begin(); }
+  auto end() const { return mEntries.end(); }
+  const T& operator[](size_t i) const { return mEntries[i]; }
+
+  auto begin() {
+    mDirty = true;
+    return mEntries.begin();
+  }
+  auto end() {
+    mDirty = true;
+    return mEntries.end();
+  }
+  T& operator[](size_t i) {
+    mDirty = true;
+    return mEntries[i];
+  }
+  void resize(size_t n) {
+    mDirty = true;
+    mEntries.resize(n);
+  }
+  void push_back(const T& x) { mEntries.push_back(x); }
+
+  bool operator==(const MatPool& rhs) const {
+    return mEntries == rhs.mEntries;
+  }
+
+private:
+  void sync() const {
+    if (mDirty) {
+      mIndex.clear();
+      mIndexed = 0;
+      mDirty = false;
+    }
+    for (; mIndexed < mEntries.size(); ++mIndexed) {
+      mIndex.try_emplace(mEntries[mIndexed], static_cast<u32>(mIndexed));
+    }
+  }
+
+  std::vector<T> mEntries;
+  // Built lazily by const lookups
+  mutable std::unordered_map<T, u32, MatHash> mIndex;
+  mutable size_t mIndexed = 0;
+  mutable bool mDirty = false;
+};
+
 struct MatCache {
-  template <typename T> using Section = std::vector<T>;
-  Section<Indirect> indirectInfos;
+  template <typename T> using Section = MatPool<T>;
+  // One per material, never searched
+  std::vector<Indirect> indirectInfos;
   Section<librii::gx::CullMode> cullModes;
   Section<librii::gx::Color> matColors;
   Section<u8> nColorChan;
@@ -89,14 +187,11 @@ struct MatCache {
   bool operator==(const MatCache&) const = default;
 
   void clear() { *this = MatCache{}; }
-  template <typename T>
-  void update_section(std::vector<T>& sec, const T& data) {
-    if (std::find(sec.begin(), sec.end(), data) == sec.end()) {
-      sec.push_back(data);
-    }
+  template <typename T> void update_section(Section<T>& sec, const T& data) {
+    sec.insert(data);
   }
   template <typename T, typename U>
-  void update_section_multi(std::vector<T>& sec, const U& source) {
+  void update_section_multi(Section<T>& sec, const U& source) {
     for (int i = 0; i < source.size(); ++i) {
       update_section(sec, source[i]);
     }
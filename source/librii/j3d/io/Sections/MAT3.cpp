@@ -524,7 +524,7 @@ Result<void> readMAT3(BMDOutputContext& ctx) {
   return {};
 }
 template <typename T, u32 bodyAlign = 1, u32 entryAlign = 1,
-          bool compress = true>
+          bool compress = true, typename Hash = MatHash>
 class MCompressableVector : public oishii::Node {
   struct Child : public oishii::Node {
     Child(const MCompressableVector& parent, u32 index)
@@ -561,23 +561,27 @@ public:
   }
 
   u32 append(const T& entry) {
-    const auto found = std::find(mEntries.begin(), mEntries.end(), entry);
-    if (found == mEntries.end() || !compress) {
+    const u32 index = mEntries.size();
+    if (!compress) {
       mEntries.push_back(entry);
-      return mEntries.size() - 1;
+      return index;
     }
-    return found - mEntries.begin();
+    // Keeps the first of equal entries
+    const auto [it, added] = mIndex.try_emplace(entry, index);
+    if (added) {
+      mEntries.push_back(entry);
+    }
+    return it->second;
   }
   int find(const T& entry) const {
-    int outIdx = -1;
+    if (compress) {
+      const auto it = mIndex.find(entry);
+      return it == mIndex.end() ? -1 : static_cast<int>(it->second);
+    }
     for (int i = 0; i < mEntries.size(); ++i)
-      if (entry == mEntries[i]) {
-        outIdx = i;
-        break;
-      }
-    // Intentionally complete
-    // TODO: rfind
-    return outIdx;
+      if (entry == mEntries[i])
+        return i;
+    return -1;
   }
   u32 getNumEntries() const { return mEntries.size(); }
   const T& getEntry(u32 idx) const {
@@ -591,6 +595,9 @@ public:
 
 public:
   std::vector<T> mEntries;
+
+private:
+  std::unordered_map<T, u32, Hash> mIndex;
 };
 struct MAT3Node;
 struct SerializableMaterial {
@@ -602,16 +609,16 @@ struct SerializableMaterial {
 
   bool operator==(const SerializableMaterial& rhs) const noexcept;
 };
+struct SerializableMaterialHash {
+  size_t operator()(const SerializableMaterial& smat) const noexcept;
+};
 auto find = [](const auto& buf, const auto x) {
-  auto found = std::find(buf.begin(), buf.end(), x);
-  // if (found == buf.end()) {
-  // 	buf.push_back(x);
-  // }
-  assert(found != buf.end());
-  if (found == buf.end()) {
+  const int found = buf.find(x);
+  assert(found >= 0);
+  if (found < 0) {
     printf("Invalid data entry not cached.\n");
   }
-  return found == buf.end() ? -1 : found - buf.begin();
+  return found;
 };
 template <typename TIdx, typename T, typename TPool>
 void write_array_vec(oishii::Writer& writer, const T& vec, TPool& pool) {
@@ -620,12 +627,12 @@ void write_array_vec(oishii::Writer& writer, const T& vec, TPool& pool) {
   for (int i = vec.size(); i < vec.fixed_size(); ++i)
     writer.write<TIdx>(-1);
 }
-template <typename T>
-int write_cache(oishii::Writer& writer, const std::vector<T>& cache) {
+template <typename TPool>
+int write_cache(oishii::Writer& writer, const TPool& cache) {
   // while (writer.tell() % io_wrapper<T>::SizeOf) writer.write(0xff);
   const auto start = writer.tell();
   for (auto& x : cache) {
-    io_wrapper<T>::onWrite(writer, x);
+    io_wrapper<std::decay_t<decltype(x)>>::onWrite(writer, x);
   }
   return start;
 }
@@ -634,11 +641,12 @@ template <> struct io_wrapper<SerializableMaterial> {
   static void onWrite(oishii::Writer& writer, const SerializableMaterial& smat);
 };
 struct MAT3Node : public oishii::Node {
-  template <typename T, MatSec s>
-  struct Section : MCompressableVector<T, 4, 0, true> {};
+  template <typename T, MatSec s, typename Hash = MatHash>
+  struct Section : MCompressableVector<T, 4, 0, true, Hash> {};
 
   struct EntrySection final
-      : public Section<SerializableMaterial, MatSec::Max> {
+      : public Section<SerializableMaterial, MatSec::Max,
+                       SerializableMaterialHash> {
 
     EntrySection(const J3dModel& mdl, const MAT3Node& mat3) : mMdl(mdl) {
       for (int i = 0; i < mMdl.materials.size(); ++i)
@@ -810,6 +818,10 @@ bool SerializableMaterial::operator==(
   return a == b;
   //  return mMAT3.mMdl.materials[mIdx] == rhs.mMAT3.mMdl.materials[rhs.mIdx];
 }
+size_t SerializableMaterialHash::operator()(
+    const SerializableMaterial& smat) const noexcept {
+  return MatHash{}(smat.mMAT3.mMdl.materials[smat.mIdx]);
+}
 void io_wrapper<SerializableMaterial>::onWrite(
     oishii::Writer& writer, const SerializableMaterial& smat) {
   const librii::j3d::MaterialData& m = smat.mMAT3.mMdl.materials[smat.mIdx];
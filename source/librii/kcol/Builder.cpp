@@ -0,0 +1,426 @@
+#include "Builder.hpp"
+
+#include <librii/sched/TaskScheduler.hpp>
+
+IMPORT_STD;
+
+namespace librii::kcol {
+
+namespace {
+
+// Indices are u16, and list entries are 1-based with 0 reserved
+constexpr size_t MaxPoolSize = 0xFFFF;
+constexpr size_t MaxPrisms = 0xFFFF - 1;
+
+// log2 of the number of top-level cubes. Cubes are split until there are at
+// least the minimum, so the octree build has enough tasks to spread across
+// cores, and merged in flat areas to keep under the maximum.
+constexpr s32 MinRootCubesShift = 6;
+constexpr s32 MaxRootCubesShift = 12;
+
+struct Vec3Hash {
+  size_t operator()(const glm::vec3& v) const {
+    u64 h = 0xcbf2'9ce4'8422'2325;
+    for (int i = 0; i < 3; ++i) {
+      h = (h ^ std::bit_cast<u32>(v[i])) * 0x100'0000'01b3;
+    }
+    return h;
+  }
+};
+
+// Deduplicates vectors, by exact value
+class VectorPool {
+public:
+  std::optional<u16> insert(glm::vec3 v) {
+    // -0 and 0 compare equal, so must hash equal
+    v += glm::vec3(0.0f);
+    auto [it, added] = mIndex.try_emplace(v, mValues.size());
+    if (added) {
+      if (mValues.size() >= MaxPoolSize) {
+        mIndex.erase(it);
+        return std::nullopt;
+      }
+      mValues.push_back(v);
+    }
+    return it->second;
+  }
+
+  std::vector<glm::vec3> take() { return std::move(mValues); }
+
+private:
+  std::vector<glm::vec3> mValues;
+  std::unordered_map<glm::vec3, u16, Vec3Hash> mIndex;
+};
+
+// Projection of a prism onto an axis
+struct Extent {
+  glm::vec3 axis;
+  float lo;
+  float hi;
+};
+
+// The volume a prism collides in, prepared for box tests. Coordinates are
+// relative to the area's minimum.
+struct Solid {
+  glm::vec3 lo;
+  glm::vec3 hi;
+  // Separating axes besides the box's own: the face and side normals, and
+  // each box axis crossed with each prism edge
+  std::vector<Extent> extents;
+};
+
+Solid MakeSolid(const std::array<glm::vec3, 3>& v, const glm::vec3& fnrm,
+                float thickness) {
+  std::array<glm::vec3, 6> corners;
+  for (int i = 0; i < 3; ++i) {
+    corners[i] = v[i];
+    corners[i + 3] = v[i] - fnrm * thickness;
+  }
+  Solid solid{.lo = corners[0], .hi = corners[0]};
+  for (const auto& c : corners) {
+    solid.lo = glm::min(solid.lo, c);
+    solid.hi = glm::max(solid.hi, c);
+  }
+  const auto add = [&](glm::vec3 axis) {
+    const float len = glm::length(axis);
+    if (!(len > 1e-6f)) {
+      return;
+    }
+    axis /= len;
+    Extent e{axis, std::numeric_limits<float>::max(),
+             std::numeric_limits<float>::lowest()};
+    for (const auto& c : corners) {
+      const float d = glm::dot(c, axis);
+      e.lo = std::min(e.lo, d);
+      e.hi = std::max(e.hi, d);
+    }
+    solid.extents.push_back(e);
+  };
+  const std::array<glm::vec3, 4> edges{v[1] - v[0], v[2] - v[1], v[0] - v[2],
+                                       fnrm};
+  add(fnrm);
+  for (int i = 0; i < 3; ++i) {
+    add(glm::cross(edges[i], fnrm));
+  }
+  for (const auto& edge : edges) {
+    add(glm::cross(glm::vec3(1, 0, 0), edge));
+    add(glm::cross(glm::vec3(0, 1, 0), edge));
+    add(glm::cross(glm::vec3(0, 0, 1), edge));
+  }
+  return solid;
+}
+
+// Separating axis test of a solid against a box
+bool Intersects(const Solid& solid, const glm::vec3& lo, const glm::vec3& hi) {
+  if (glm::any(glm::greaterThan(solid.lo, hi)) ||
+      glm::any(glm::lessThan(solid.hi, lo))) {
+    return false;
+  }
+  const glm::vec3 center = (lo + hi) * 0.5f;
+  const glm::vec3 half = (hi - lo) * 0.5f;
+  for (const auto& e : solid.extents) {
+    const float c = glm::dot(center, e.axis);
+    const float r = glm::dot(half, glm::abs(e.axis));
+    if (e.lo > c + r || e.hi < c - r) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct NodeRef {
+  bool leaf = true;
+  // Into OctreeTree::branches or OctreeTree::lists
+  u32 index = 0;
+};
+
+// The octree under one top-level cube
+struct OctreeTree {
+  std::vector<std::array<NodeRef, 8>> branches;
+  std::vector<std::vector<u16>> lists;
+  NodeRef root;
+};
+
+struct OctreeContext {
+  std::span<const Solid> solids;
+  float radius;
+  u32 max_per_leaf;
+  s32 min_shift;
+};
+
+NodeRef BuildNode(OctreeTree& tree, const OctreeContext& ctx,
+                  const glm::vec3& origin, s32 shift,
+                  std::span<const u32> candidates) {
+  const float width = static_cast<float>(1u << shift);
+  const glm::vec3 lo = origin - ctx.radius;
+  const glm::vec3 hi = origin + width + ctx.radius;
+  std::vector<u32> hits;
+  for (u32 i : candidates) {
+    if (Intersects(ctx.solids[i], lo, hi)) {
+      hits.push_back(i);
+    }
+  }
+
+  if (hits.size() <= ctx.max_per_leaf || shift <= ctx.min_shift) {
+    auto& list = tree.lists.emplace_back(hits.size());
+    std::ranges::transform(hits, list.begin(),
+                           [](u32 i) { return static_cast<u16>(i + 1); });
+    return {.leaf = true, .index = static_cast<u32>(tree.lists.size() - 1)};
+  }
+
+  // Parents precede their children, so branch offsets are positive
+  const u32 index = tree.branches.size();
+  tree.branches.emplace_back();
+  std::array<NodeRef, 8> children;
+  const float half = width * 0.5f;
+  for (u32 i = 0; i < 8; ++i) {
+    const glm::vec3 child_origin =
+        origin + glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * half;
+    children[i] = BuildNode(tree, ctx, child_origin, shift - 1, hits);
+  }
+
+  // Triangles spanning the whole cube can leave eight identical leaves
+  const bool uniform = std::ranges::all_of(children, [&](const NodeRef& c) {
+    return c.leaf && tree.lists[c.index] == tree.lists[children[0].index];
+  });
+  if (uniform) {
+    tree.branches.pop_back();
+    tree.lists.resize(children[0].index + 1);
+    return children[0];
+  }
+  tree.branches[index] = children;
+  return {.leaf = false, .index = index};
+}
+
+struct ListHash {
+  size_t operator()(const std::vector<u16>& list) const {
+    u64 h = 0xcbf2'9ce4'8422'2325;
+    for (u16 x : list) {
+      h = (h ^ x) * 0x100'0000'01b3;
+    }
+    return h;
+  }
+};
+
+Result<std::vector<u8>> WriteBlockData(std::span<const OctreeTree> trees) {
+  // Top-level cubes, then every tree's branches, then the lists
+  std::vector<u32> branch_base(trees.size());
+  u32 nodes_end = trees.size() * 4;
+  for (size_t i = 0; i < trees.size(); ++i) {
+    branch_base[i] = nodes_end;
+    nodes_end += trees[i].branches.size() * 32;
+  }
+
+  std::vector<u8> out(nodes_end);
+  // The game skips the u16 at a list's offset, so each list's offset is the
+  // terminator before it. The leading pair of zeroes is the empty list.
+  const u32 empty_list = nodes_end;
+  out.resize(out.size() + 4);
+  std::unordered_map<std::vector<u16>, u32, ListHash> list_offsets;
+  const auto list_offset = [&](const std::vector<u16>& list) {
+    if (list.empty()) {
+      return empty_list;
+    }
+    auto [it, added] =
+        list_offsets.try_emplace(list, static_cast<u32>(out.size() - 2));
+    if (added) {
+      const size_t pos = out.size();
+      out.resize(pos + (list.size() + 1) * 2);
+      for (size_t i = 0; i < list.size(); ++i) {
+        rsl::store<u16>(list[i], out, pos + i * 2);
+      }
+    }
+    return it->second;
+  };
+
+  // |node_base| is the offset of the array holding the entry
+  std::optional<std::string> error;
+  const auto encode = [&](const OctreeTree& tree, u32 tree_base, NodeRef ref,
+                          u32 node_base) -> u32 {
+    const u32 target = ref.leaf ? list_offset(tree.lists[ref.index])
+                                : tree_base + ref.index * 32;
+    const u32 rel = target - node_base;
+    if (rel & 0x8000'0000) {
+      error = "Octree is too large";
+    }
+    return ref.leaf ? (rel | 0x8000'0000) : rel;
+  };
+  // Encoding appends lists, so must finish before |out| is indexed
+  for (size_t i = 0; i < trees.size(); ++i) {
+    const auto& tree = trees[i];
+    const u32 root = encode(tree, branch_base[i], tree.root, 0);
+    rsl::store<u32>(root, out, i * 4);
+    for (size_t b = 0; b < tree.branches.size(); ++b) {
+      const u32 base = branch_base[i] + b * 32;
+      for (u32 c = 0; c < 8; ++c) {
+        const u32 node =
+            encode(tree, branch_base[i], tree.branches[b][c], base);
+        rsl::store<u32>(node, out, base + c * 4);
+      }
+    }
+  }
+  if (error) {
+    return std::unexpected(*error);
+  }
+  // Keep later sections aligned
+  out.resize(roundUp(out.size(), 4));
+  return out;
+}
+
+} // namespace
+
+Result<KCollisionData>
+BuildKCollisionData(std::span<const KclTriangle> triangles,
+                    const KclBuildOptions& options) {
+  EXPECT(options.min_cube_width_shift >= 0 &&
+             options.min_cube_width_shift < 30,
+         "Invalid minimum cube width");
+  KCollisionData data;
+  data.prism_thickness = options.prism_thickness;
+  data.sphere_radius = options.sphere_radius;
+
+  VectorPool positions;
+  VectorPool normals;
+  std::vector<std::array<glm::vec3, 3>> kept;
+  std::vector<glm::vec3> face_normals;
+  for (const auto& tri : triangles) {
+    const auto& [v1, v2, v3] = tri.verts;
+    const glm::vec3 cross = glm::cross(v2 - v1, v3 - v1);
+    const float area = glm::length(cross);
+    if (!(area > 1e-6f) || !std::isfinite(area)) {
+      continue;
+    }
+    EXPECT(data.prism_data.size() < MaxPrisms, "Too many triangles for KCL");
+    // Inverse of FromPrism. Edge normals face out of the triangle.
+    const glm::vec3 fnrm = cross / area;
+    const glm::vec3 enrm1 = glm::normalize(glm::cross(fnrm, v3 - v1));
+    const glm::vec3 enrm2 = glm::normalize(glm::cross(v2 - v1, fnrm));
+    const glm::vec3 enrm3 = glm::normalize(glm::cross(v3 - v2, fnrm));
+    const auto pos_i = positions.insert(v1);
+    const auto fnrm_i = normals.insert(fnrm);
+    const auto enrm1_i = normals.insert(enrm1);
+    const auto enrm2_i = normals.insert(enrm2);
+    const auto enrm3_i = normals.insert(enrm3);
+    EXPECT(pos_i && fnrm_i && enrm1_i && enrm2_i && enrm3_i,
+           "Too many unique vectors for KCL");
+    data.prism_data.push_back({
+        .height = glm::dot(v3 - v1, enrm3),
+        .pos_i = *pos_i,
+        .fnrm_i = *fnrm_i,
+        .enrm1_i = *enrm1_i,
+        .enrm2_i = *enrm2_i,
+        .enrm3_i = *enrm3_i,
+        .attribute = tri.attribute,
+    });
+    kept.push_back(tri.verts);
+    face_normals.push_back(fnrm);
+  }
+  data.pos_data = positions.take();
+  data.nrm_data = normals.take();
+
+  // Pad the area so spheres at its edge still find their cubes
+  glm::vec3 lo(0.0f), hi(0.0f);
+  if (!kept.empty()) {
+    lo = hi = kept[0][0];
+  }
+  for (size_t i = 0; i < kept.size(); ++i) {
+    for (const auto& v : kept[i]) {
+      const glm::vec3 back = v - face_normals[i] * options.prism_thickness;
+      lo = glm::min(lo, glm::min(v, back));
+      hi = glm::max(hi, glm::max(v, back));
+    }
+  }
+  data.area_min_pos = glm::floor(lo - options.sphere_radius);
+  const glm::vec3 extent = hi + options.sphere_radius - data.area_min_pos;
+
+  std::array<s32, 3> width_shift;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT(extent[i] < static_cast<float>(1u << 30), "KCL area is too large");
+    const u32 width = std::max(static_cast<u32>(std::ceil(extent[i])),
+                               1u << options.min_cube_width_shift);
+    width_shift[i] = std::countr_zero(std::bit_ceil(width));
+  }
+  s32 shift = std::ranges::min(width_shift);
+  const auto root_shift = [&](s32 s) {
+    return (width_shift[0] - s) + (width_shift[1] - s) + (width_shift[2] - s);
+  };
+  while (root_shift(shift) > MaxRootCubesShift) {
+    ++shift;
+    // Short axes grow to one cube
+    for (auto& w : width_shift) {
+      w = std::max(w, shift);
+    }
+  }
+  while (root_shift(shift) < MinRootCubesShift &&
+         shift > options.min_cube_width_shift) {
+    --shift;
+  }
+  data.area_x_width_mask = ~((1u << width_shift[0]) - 1);
+  data.area_y_width_mask = ~((1u << width_shift[1]) - 1);
+  data.area_z_width_mask = ~((1u << width_shift[2]) - 1);
+  data.block_width_shift = shift;
+  data.area_x_blocks_shift = width_shift[0] - shift;
+  data.area_xy_blocks_shift = data.area_x_blocks_shift + width_shift[1] - shift;
+
+  std::vector<Solid> solids(kept.size());
+  for (size_t i = 0; i < kept.size(); ++i) {
+    auto local = kept[i];
+    for (auto& v : local) {
+      v -= data.area_min_pos;
+    }
+    solids[i] = MakeSolid(local, face_normals[i], options.prism_thickness);
+  }
+
+  // Bin each solid into the top-level cubes its bounds touch
+  const glm::ivec3 grid(1 << (width_shift[0] - shift),
+                        1 << (width_shift[1] - shift),
+                        1 << (width_shift[2] - shift));
+  const float cube = static_cast<float>(1u << shift);
+  const auto root_index = [&](int x, int y, int z) {
+    return (z << data.area_xy_blocks_shift) |
+           (y << data.area_x_blocks_shift) | x;
+  };
+  std::vector<std::vector<u32>> bins(size_t(1) << root_shift(shift));
+  for (u32 i = 0; i < solids.size(); ++i) {
+    const auto cell = [&](const glm::vec3& p) {
+      return glm::clamp(glm::ivec3(glm::floor(p / cube)), glm::ivec3(0),
+                        grid - 1);
+    };
+    const auto first = cell(solids[i].lo - options.sphere_radius);
+    const auto last = cell(solids[i].hi + options.sphere_radius);
+    for (int z = first.z; z <= last.z; ++z) {
+      for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+          bins[root_index(x, y, z)].push_back(i);
+        }
+      }
+    }
+  }
+
+  const OctreeContext ctx{
+      .solids = solids,
+      .radius = options.sphere_radius,
+      .max_per_leaf = options.max_triangles_per_leaf,
+      .min_shift = options.min_cube_width_shift,
+  };
+  std::vector<OctreeTree> trees(bins.size());
+  auto& scheduler = sched::TaskScheduler::shared();
+  sched::TaskGroup group;
+  for (int z = 0; z < grid.z; ++z) {
+    for (int y = 0; y < grid.y; ++y) {
+      for (int x = 0; x < grid.x; ++x) {
+        const u32 r = root_index(x, y, z);
+        scheduler.spawn(group, [&, r, x, y, z] {
+          const glm::vec3 origin = glm::vec3(x, y, z) * cube;
+          trees[r].root = BuildNode(trees[r], ctx, origin, shift, bins[r]);
+        });
+      }
+    }
+  }
+  scheduler.wait(group);
+
+  data.block_data = TRY(WriteBlockData(trees));
+  return data;
+}
+
+} // namespace librii::kcol
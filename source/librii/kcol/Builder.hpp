@@ -0,0 +1,44 @@
+#pragma once
+
+#include <librii/kcol/Model.hpp>
+
+namespace librii::kcol {
+
+struct KclTriangle {
+  //! Counter-clockwise when viewed from the solid side's outside.
+  std::array<glm::vec3, 3> verts;
+  u16 attribute = 0;
+};
+
+struct KclBuildOptions {
+  float prism_thickness = 300.0f;
+  //! Largest sphere the game tests against the collision. Each octree leaf
+  //! lists every prism within this distance of the leaf's cube.
+  float sphere_radius = 250.0f;
+  //! Leaves with more prisms are split, down to min_cube_width_shift.
+  u32 max_triangles_per_leaf = 32;
+  //! log2 of the width of the smallest octree cube.
+  s32 min_cube_width_shift = 8;
+};
+
+//! @brief Build collision from a triangle soup.
+//!
+//! Each triangle becomes a prism; positions and normals are deduplicated.
+//! The area is split into a grid of top-level cubes, and the octree under
+//! each cube is built on the shared task scheduler. Degenerate triangles are
+//! skipped.
+//!
+//! block_data is laid out as the game expects: a u32 per top-level cube, then
+//! the branches, then the prism lists. A node is either a branch, the offset
+//! of eight child nodes, or a leaf, 0x80000000 | the offset of its list.
+//! Offsets are relative to the first node of the array holding them. A list
+//! is the 1-based prism indices that follow the offset's u16, ending in 0.
+//!
+//! @param[in] triangles Source geometry.
+//! @param[in] options   Octree tuning and the game's collision constants.
+//!
+Result<KCollisionData>
+BuildKCollisionData(std::span<const KclTriangle> triangles,
+                    const KclBuildOptions& options = {});
+
+} // namespace librii::kcol
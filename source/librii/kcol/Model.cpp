@@ -134,6 +134,48 @@ std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
   return "";
 }
 
+std::vector<u8> WriteKCollisionData(const KCollisionData& data) {
+  const u32 pos_data_offset = sizeof(KCollisionV1Header);
+  const u32 nrm_data_offset =
+      pos_data_offset + data.pos_data.size() * sizeof(Vector3f);
+  const u32 prism_data_start =
+      nrm_data_offset + data.nrm_data.size() * sizeof(Vector3f);
+  const u32 block_data_offset =
+      prism_data_start + data.prism_data.size() * sizeof(KCollisionPrismData);
+  const u32 file_size = block_data_offset + data.block_data.size();
+
+  std::vector<u8> bytes(file_size);
+  auto* header = rsl::buffer_cast<KCollisionV1Header>(std::span(bytes));
+  assert(header != nullptr);
+  const auto vec = [](const glm::vec3& v) { return Vector3f{v.x, v.y, v.z}; };
+  *header = KCollisionV1Header{
+      .pos_data_offset = pos_data_offset,
+      .nrm_data_offset = nrm_data_offset,
+      // 1-indexed, see GetSectionSizes
+      .prism_data_offset = static_cast<u32>(prism_data_start -
+                                            sizeof(KCollisionPrismData)),
+      .block_data_offset = block_data_offset,
+      .prism_thickness = data.prism_thickness,
+      .area_min_pos = vec(data.area_min_pos),
+      .area_x_width_mask = data.area_x_width_mask,
+      .area_y_width_mask = data.area_y_width_mask,
+      .area_z_width_mask = data.area_z_width_mask,
+      .block_width_shift = data.block_width_shift,
+      .area_x_blocks_shift = data.area_x_blocks_shift,
+      .area_xy_blocks_shift = data.area_xy_blocks_shift,
+      .sphere_radius = data.sphere_radius,
+  };
+
+  auto* pos = reinterpret_cast<Vector3f*>(bytes.data() + pos_data_offset);
+  std::ranges::transform(data.pos_data, pos, vec);
+  auto* nrm = reinterpret_cast<Vector3f*>(bytes.data() + nrm_data_offset);
+  std::ranges::transform(data.nrm_data, nrm, vec);
+  std::ranges::copy(data.prism_data, reinterpret_cast<KCollisionPrismData*>(
+                                         bytes.data() + prism_data_start));
+  std::ranges::copy(data.block_data, bytes.begin() + block_data_offset);
+  return bytes;
+}
+
 constexpr std::array<char, 8> WiimmSZSIdentifier = {'W', 'i', 'i', 'm',
                                                     'm', 'S', 'Z', 'S'};
 
@@ -126,6 +126,10 @@ struct KCollisionData {
 std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
                                u32 file_size);
 
+//! @brief Serialize to a big-endian KCL file. block_data is written as is.
+//!
+std::vector<u8> WriteKCollisionData(const KCollisionData& data);
+
 inline std::array<glm::vec3, 3> FromPrism(const KCollisionData& data,
                                           const KCollisionPrismData& prism) {
   return FromPrism(prism.height, data.pos_data[prism.pos_i],
@@ -0,0 +1,426 @@
+#include "Query.hpp"
+
+IMPORT_STD;
+
+namespace librii::kcol {
+
+namespace {
+
+constexpr u32 LeafBit = 0x8000'0000;
+
+// Ray interval within a box, or an empty interval
+std::pair<float, float> Slab(const glm::vec3& lo, const glm::vec3& hi,
+                             const glm::vec3& origin,
+                             const glm::vec3& inv_dir) {
+  const glm::vec3 a = (lo - origin) * inv_dir;
+  const glm::vec3 b = (hi - origin) * inv_dir;
+  const glm::vec3 enter = glm::min(a, b);
+  const glm::vec3 exit = glm::max(a, b);
+  return {std::max({enter.x, enter.y, enter.z}),
+          std::min({exit.x, exit.y, exit.z})};
+}
+
+// Closest point on a triangle (Ericson, Real-Time Collision Detection 5.1.5)
+glm::vec3 ClosestOnTriangle(const glm::vec3& p, const glm::vec3& a,
+                            const glm::vec3& b, const glm::vec3& c) {
+  const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+  const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+  if (d1 <= 0.0f && d2 <= 0.0f)
+    return a;
+  const glm::vec3 bp = p - b;
+  const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+  if (d3 >= 0.0f && d4 <= d3)
+    return b;
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    return a + ab * (d1 / (d1 - d3));
+  const glm::vec3 cp = p - c;
+  const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+  if (d6 >= 0.0f && d5 <= d6)
+    return c;
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    return a + ac * (d2 / (d2 - d6));
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  const float denom = 1.0f / (va + vb + vc);
+  return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+} // namespace
+
+struct KCollisionQuery::DecodeState {
+  std::span<const u8> blob;
+  std::unordered_map<u32, u32> nodes;
+  std::unordered_map<u32, u32> lists;
+};
+
+Result<KCollisionQuery> KCollisionQuery::Make(const KCollisionData& data) {
+  KCollisionQuery query;
+  query.mPrisms.reserve(data.prism_data.size());
+  EXPECT(data.prism_data.size() < 0xFFFF, "Too many prisms");
+  for (const auto& p : data.prism_data) {
+    EXPECT(p.pos_i < data.pos_data.size(), "Prism position out of range");
+    for (u16 i : {*p.fnrm_i, *p.enrm1_i, *p.enrm2_i, *p.enrm3_i}) {
+      EXPECT(i < data.nrm_data.size(), "Prism normal out of range");
+    }
+    query.mPrisms.push_back({
+        .pos = data.pos_data[p.pos_i],
+        .fnrm = data.nrm_data[p.fnrm_i],
+        .enrm = {data.nrm_data[p.enrm1_i], data.nrm_data[p.enrm2_i],
+                 data.nrm_data[p.enrm3_i]},
+        .height = p.height,
+        .verts = FromPrism(data, p),
+        .attribute = p.attribute,
+    });
+  }
+
+  query.mAreaMin = data.area_min_pos;
+  query.mAreaMask = {data.area_x_width_mask, data.area_y_width_mask,
+                     data.area_z_width_mask};
+  query.mBlockShift = data.block_width_shift;
+  query.mXShift = data.area_x_blocks_shift;
+  query.mXYShift = data.area_xy_blocks_shift;
+  query.mThickness = data.prism_thickness;
+  query.mSphereRadius = data.sphere_radius;
+
+  EXPECT(query.mBlockShift >= 0 && query.mBlockShift < 32,
+         "Invalid block width");
+  for (int i = 0; i < 3; ++i) {
+    // The mask clears the bits within the area
+    const u32 width = ~query.mAreaMask[i] + 1;
+    EXPECT((width & (width - 1)) == 0, "Invalid area mask");
+    const u32 cubes = width == 0 ? 0 : width >> query.mBlockShift;
+    EXPECT(cubes > 0 && cubes <= 0x1000, "Invalid top-level cube grid");
+    query.mGrid[i] = cubes;
+  }
+  EXPECT(query.mGrid.x == 1 << query.mXShift &&
+             query.mGrid.x * query.mGrid.y == 1 << query.mXYShift,
+         "Area and block shifts disagree");
+
+  DecodeState state{.blob = data.block_data};
+  const u32 roots = query.mGrid.x * query.mGrid.y * query.mGrid.z;
+  EXPECT(roots * 4 <= data.block_data.size(), "Octree is truncated");
+  query.mNodes.resize(roots);
+  for (u32 i = 0; i < roots; ++i) {
+    query.mNodes[i] =
+        TRY(query.decodeNode(state, 0, i * 4, query.mBlockShift));
+  }
+  return query;
+}
+
+Result<u32> KCollisionQuery::decodeNode(DecodeState& state, u32 array_base,
+                                        u32 entry_offset, s32 shift) {
+  EXPECT(entry_offset + 4 <= state.blob.size(), "Octree node out of range");
+  const u32 raw = rsl::load<u32>(state.blob, entry_offset);
+  if (raw & LeafBit) {
+    return LeafBit | TRY(decodeList(state, array_base + (raw & ~LeafBit)));
+  }
+  EXPECT(shift > 0, "Octree is deeper than its cubes");
+  const u32 children = array_base + raw;
+  if (auto it = state.nodes.find(children); it != state.nodes.end()) {
+    return it->second;
+  }
+  const u32 first = mNodes.size();
+  mNodes.resize(first + 8);
+  state.nodes.emplace(children, first);
+  for (u32 i = 0; i < 8; ++i) {
+    mNodes[first + i] =
+        TRY(decodeNode(state, children, children + i * 4, shift - 1));
+  }
+  return first;
+}
+
+Result<u32> KCollisionQuery::decodeList(DecodeState& state, u32 offset) {
+  if (auto it = state.lists.find(offset); it != state.lists.end()) {
+    return it->second;
+  }
+  const u32 start = mLists.size();
+  mLists.push_back(0);
+  // The u16 at the offset is skipped, as the game does
+  for (u32 pos = offset + 2;; pos += 2) {
+    EXPECT(pos + 2 <= state.blob.size(), "Prism list is unterminated");
+    const u16 prism = rsl::load<u16>(state.blob, pos);
+    if (prism == 0) {
+      break;
+    }
+    EXPECT(prism <= mPrisms.size(), "Prism list entry out of range");
+    mLists.push_back(prism - 1);
+  }
+  mLists[start] = static_cast<u16>(mLists.size() - start - 1);
+  state.lists.emplace(offset, start);
+  return start;
+}
+
+std::span<const u16> KCollisionQuery::leafList(u32 node) const {
+  const u32 start = node & ~LeafBit;
+  return {mLists.data() + start + 1, mLists[start]};
+}
+
+std::span<const u16>
+KCollisionQuery::candidatesAt(const glm::vec3& point) const {
+  const glm::vec3 local = point - mAreaMin;
+  if (local.x < 0.0f || local.y < 0.0f || local.z < 0.0f) {
+    return {};
+  }
+  const glm::uvec3 p(local);
+  if (glm::any(glm::notEqual(p & mAreaMask, glm::uvec3(0)))) {
+    return {};
+  }
+  s32 shift = mBlockShift;
+  u32 node = mNodes[((p.z >> shift) << mXYShift) |
+                    ((p.y >> shift) << mXShift) | (p.x >> shift)];
+  while (!(node & LeafBit)) {
+    --shift;
+    node = mNodes[node + (((p.x >> shift) & 1) | (((p.y >> shift) & 1) << 1) |
+                          (((p.z >> shift) & 1) << 2))];
+  }
+  return leafList(node);
+}
+
+std::optional<float> KCollisionQuery::intersectRay(u16 prism,
+                                                   const glm::vec3& origin,
+                                                   const glm::vec3& dir,
+                                                   float max_distance) const {
+  // Moller-Trumbore
+  const auto& [v0, v1, v2] = mPrisms[prism].verts;
+  const glm::vec3 e1 = v1 - v0, e2 = v2 - v0;
+  const glm::vec3 p = glm::cross(dir, e2);
+  const float det = glm::dot(e1, p);
+  if (std::abs(det) < 1e-12f) {
+    return std::nullopt;
+  }
+  const float inv_det = 1.0f / det;
+  const glm::vec3 s = origin - v0;
+  const float u = glm::dot(s, p) * inv_det;
+  if (u < 0.0f || u > 1.0f) {
+    return std::nullopt;
+  }
+  const glm::vec3 q = glm::cross(s, e1);
+  const float v = glm::dot(dir, q) * inv_det;
+  if (v < 0.0f || u + v > 1.0f) {
+    return std::nullopt;
+  }
+  const float t = glm::dot(e2, q) * inv_det;
+  if (t < 0.0f || t > max_distance) {
+    return std::nullopt;
+  }
+  return t;
+}
+
+std::optional<KclSphereHit>
+KCollisionQuery::intersectSphere(u16 prism, const glm::vec3& center,
+                                 float radius) const {
+  const auto& p = mPrisms[prism];
+  const glm::vec3 rel = center - p.pos;
+  const float dist = glm::dot(rel, p.fnrm);
+  if (dist > radius || dist < -mThickness) {
+    return std::nullopt;
+  }
+  const float d1 = glm::dot(rel, p.enrm[0]);
+  const float d2 = glm::dot(rel, p.enrm[1]);
+  const float d3 = glm::dot(rel, p.enrm[2]) - p.height;
+  if (d1 > radius || d2 > radius || d3 > radius) {
+    return std::nullopt;
+  }
+  if (d1 <= 0.0f && d2 <= 0.0f && d3 <= 0.0f) {
+    // Over the face, or inside the prism: pushed out through the face
+    return KclSphereHit{prism, radius - dist, p.fnrm};
+  }
+  // Beside the face: only its edges and corners can be touched
+  const glm::vec3 closest =
+      ClosestOnTriangle(center, p.verts[0], p.verts[1], p.verts[2]);
+  const glm::vec3 away = center - closest;
+  const float len = glm::length(away);
+  if (len > radius) {
+    return std::nullopt;
+  }
+  return KclSphereHit{prism, radius - len,
+                      len > 1e-6f ? away / len : p.fnrm};
+}
+
+void KCollisionQuery::rayNode(u32 node, const glm::vec3& lo, s32 shift,
+                              float t0, float t1, const glm::vec3& origin,
+                              const glm::vec3& dir, const glm::vec3& inv_dir,
+                              KclTypeMask types,
+                              std::optional<KclRayHit>& best) const {
+  if (node & LeafBit) {
+    for (u16 prism : leafList(node)) {
+      if (!matches(prism, types)) {
+        continue;
+      }
+      // Leaves list prisms near the cube, too, so a hit may lie past it.
+      // rayCast drops hits past its limit.
+      const float max =
+          best ? best->distance : std::numeric_limits<float>::infinity();
+      if (auto t = intersectRay(prism, origin, dir, max);
+          t && (!best || *t < best->distance)) {
+        best = KclRayHit{prism, *t, origin + dir * *t};
+      }
+    }
+    return;
+  }
+
+  const float half = static_cast<float>(1u << (shift - 1));
+  struct Child {
+    u32 index;
+    glm::vec3 lo;
+    float t0, t1;
+  };
+  std::array<Child, 8> order;
+  int count = 0;
+  for (u32 i = 0; i < 8; ++i) {
+    const glm::vec3 child_lo =
+        lo + glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * half;
+    auto [a, b] = Slab(child_lo, child_lo + half, origin, inv_dir);
+    a = std::max(a, t0);
+    b = std::min(b, t1);
+    if (a <= b) {
+      order[count++] = {node + i, child_lo, a, b};
+    }
+  }
+  std::sort(order.begin(), order.begin() + count,
+            [](const Child& x, const Child& y) { return x.t0 < y.t0; });
+  for (int i = 0; i < count; ++i) {
+    // Nearer cubes were visited first, so no later cube can hold a closer hit
+    if (best && best->distance <= order[i].t0) {
+      return;
+    }
+    rayNode(mNodes[order[i].index], order[i].lo, shift - 1, order[i].t0,
+            order[i].t1, origin, dir, inv_dir, types, best);
+  }
+}
+
+std::optional<KclRayHit> KCollisionQuery::rayCast(const glm::vec3& origin,
+                                                  const glm::vec3& dir,
+                                                  float max_distance,
+                                                  KclTypeMask types) const {
+  const glm::vec3 local = origin - mAreaMin;
+  const glm::vec3 inv_dir = 1.0f / dir;
+  const float cube = static_cast<float>(1u << mBlockShift);
+  const glm::vec3 area = glm::vec3(mGrid) * cube;
+  auto [t_enter, t_exit] = Slab(mAreaMin, mAreaMin + area, origin, inv_dir);
+  t_enter = std::max(t_enter, 0.0f);
+  t_exit = std::min(t_exit, max_distance);
+  if (!(t_enter <= t_exit)) {
+    return std::nullopt;
+  }
+
+  // Walk the top-level grid (Amanatides and Woo), then descend each cube
+  const glm::vec3 start = local + dir * t_enter;
+  glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(start / cube)),
+                               glm::ivec3(0), mGrid - 1);
+  glm::ivec3 step;
+  glm::vec3 t_next, t_delta;
+  for (int i = 0; i < 3; ++i) {
+    step[i] = dir[i] > 0.0f ? 1 : -1;
+    t_delta[i] = std::abs(cube * inv_dir[i]);
+    const float boundary = (cell[i] + (dir[i] > 0.0f ? 1 : 0)) * cube;
+    t_next[i] = dir[i] == 0.0f ? std::numeric_limits<float>::infinity()
+                               : (boundary - local[i]) * inv_dir[i];
+  }
+
+  std::optional<KclRayHit> best;
+  float t = t_enter;
+  while (true) {
+    const int axis = t_next.x < t_next.y ? (t_next.x < t_next.z ? 0 : 2)
+                                         : (t_next.y < t_next.z ? 1 : 2);
+    const float cell_exit = std::min(t_next[axis], t_exit);
+    const u32 root =
+        (cell.z << mXYShift) | (cell.y << mXShift) | static_cast<u32>(cell.x);
+    rayNode(mNodes[root], mAreaMin + glm::vec3(cell) * cube, mBlockShift, t,
+            cell_exit, origin, dir, inv_dir, types, best);
+    if (best && best->distance <= cell_exit) {
+      break;
+    }
+    if (cell_exit >= t_exit) {
+      break;
+    }
+    t = cell_exit;
+    cell[axis] += step[axis];
+    if (cell[axis] < 0 || cell[axis] >= mGrid[axis]) {
+      break;
+    }
+    t_next[axis] += t_delta[axis];
+  }
+  if (!best || best->distance > max_distance) {
+    return std::nullopt;
+  }
+  return best;
+}
+
+void KCollisionQuery::boxNode(u32 node, const glm::vec3& lo, s32 shift,
+                              const glm::vec3& box_lo,
+                              const glm::vec3& box_hi,
+                              std::vector<u16>& out) const {
+  const float width = static_cast<float>(1u << shift);
+  if (glm::any(glm::greaterThan(lo, box_hi)) ||
+      glm::any(glm::lessThan(lo + width, box_lo))) {
+    return;
+  }
+  if (node & LeafBit) {
+    const auto list = leafList(node);
+    out.insert(out.end(), list.begin(), list.end());
+    return;
+  }
+  const float half = width * 0.5f;
+  for (u32 i = 0; i < 8; ++i) {
+    const glm::vec3 child_lo =
+        lo + glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * half;
+    boxNode(mNodes[node + i], child_lo, shift - 1, box_lo, box_hi, out);
+  }
+}
+
+void KCollisionQuery::sphereTest(std::vector<KclSphereHit>& out,
+                                 const glm::vec3& center, float radius,
+                                 KclTypeMask types) const {
+  std::vector<u16> candidates;
+  if (radius <= mSphereRadius) {
+    const auto list = candidatesAt(center);
+    candidates.assign(list.begin(), list.end());
+  } else {
+    const glm::vec3 box_lo = center - radius - mAreaMin;
+    const glm::vec3 box_hi = center + radius - mAreaMin;
+    const float cube = static_cast<float>(1u << mBlockShift);
+    for (int z = 0; z < mGrid.z; ++z) {
+      for (int y = 0; y < mGrid.y; ++y) {
+        for (int x = 0; x < mGrid.x; ++x) {
+          const u32 root = (z << mXYShift) | (y << mXShift) | x;
+          boxNode(mNodes[root], glm::vec3(x, y, z) * cube, mBlockShift,
+                  box_lo, box_hi, candidates);
+        }
+      }
+    }
+    std::ranges::sort(candidates);
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+  }
+  for (u16 prism : candidates) {
+    if (!matches(prism, types)) {
+      continue;
+    }
+    if (auto hit = intersectSphere(prism, center, radius)) {
+      out.push_back(*hit);
+    }
+  }
+}
+
+void KCollisionQuery::prismsAt(std::vector<u16>& out, const glm::vec3& point,
+                               KclTypeMask types) const {
+  for (u16 prism : candidatesAt(point)) {
+    if (!matches(prism, types)) {
+      continue;
+    }
+    const auto& p = mPrisms[prism];
+    const glm::vec3 rel = point - p.pos;
+    const float dist = glm::dot(rel, p.fnrm);
+    if (dist <= 0.0f && dist >= -mThickness &&
+        glm::dot(rel, p.enrm[0]) <= 0.0f && glm::dot(rel, p.enrm[1]) <= 0.0f &&
+        glm::dot(rel, p.enrm[2]) <= p.height) {
+      out.push_back(prism);
+    }
+  }
+}
+
+} // namespace librii::kcol
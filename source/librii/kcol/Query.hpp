@@ -0,0 +1,132 @@
+#pragma once
+
+#include <librii/kcol/Model.hpp>
+
+namespace librii::kcol {
+
+//! Bit i selects prisms of type i, the low 5 bits of their attribute.
+using KclTypeMask = u32;
+constexpr KclTypeMask AllKclTypes = 0xffff'ffff;
+
+struct KclRayHit {
+  u16 prism;
+  float distance;
+  glm::vec3 position;
+};
+
+struct KclSphereHit {
+  u16 prism;
+  //! How far the sphere must move along |normal| to stop touching.
+  float depth;
+  glm::vec3 normal;
+};
+
+//! @brief Spatial queries over collision, accelerated by its octree.
+//!
+//! The octree in block_data is decoded once into a flat node array, and the
+//! prisms into their planes and corners. Queries then visit only the leaves
+//! they pass through.
+//!
+//! A prism's volume is its triangle extruded prism_thickness behind the face.
+//!
+class KCollisionQuery {
+public:
+  //! @brief Decode |data|, validating its octree.
+  //!
+  static Result<KCollisionQuery> Make(const KCollisionData& data);
+
+  //! @brief Nearest face hit by a ray. Faces are hit from either side.
+  //!
+  //! @param[in] origin       Start of the ray.
+  //! @param[in] dir          Direction of the ray. Need not be normalized;
+  //!                         distances are in multiples of it.
+  //! @param[in] max_distance Hits further along are ignored.
+  //! @param[in] types        Prisms to consider.
+  //!
+  std::optional<KclRayHit>
+  rayCast(const glm::vec3& origin, const glm::vec3& dir,
+          float max_distance = std::numeric_limits<float>::infinity(),
+          KclTypeMask types = AllKclTypes) const;
+
+  //! @brief Every prism a sphere collides with.
+  //!
+  //! Spheres up to sphere_radius are answered from the one leaf holding their
+  //! center, as the game does; larger ones visit every leaf they overlap.
+  //!
+  void sphereTest(std::vector<KclSphereHit>& out, const glm::vec3& center,
+                  float radius, KclTypeMask types = AllKclTypes) const;
+
+  //! @brief Every prism whose volume holds |point|.
+  //!
+  void prismsAt(std::vector<u16>& out, const glm::vec3& point,
+                KclTypeMask types = AllKclTypes) const;
+
+  //! @brief Prisms listed by the leaf holding |point|. Empty outside the area.
+  //!
+  std::span<const u16> candidatesAt(const glm::vec3& point) const;
+
+  //! @brief Intersect one prism's face with a ray, regardless of octree.
+  //!
+  std::optional<float> intersectRay(u16 prism, const glm::vec3& origin,
+                                    const glm::vec3& dir,
+                                    float max_distance) const;
+
+  //! @brief Collide one prism with a sphere, regardless of octree.
+  //!
+  std::optional<KclSphereHit> intersectSphere(u16 prism,
+                                              const glm::vec3& center,
+                                              float radius) const;
+
+  bool matches(u16 prism, KclTypeMask types) const {
+    return (types >> (mPrisms[prism].attribute & 31)) & 1;
+  }
+
+  u32 numPrisms() const { return mPrisms.size(); }
+
+private:
+  struct Prism {
+    glm::vec3 pos;
+    glm::vec3 fnrm;
+    std::array<glm::vec3, 3> enrm;
+    float height;
+    std::array<glm::vec3, 3> verts;
+    u16 attribute;
+  };
+
+  // Blob offsets already decoded, so shared nodes and lists stay shared
+  struct DecodeState;
+
+  KCollisionQuery() = default;
+
+  Result<u32> decodeNode(DecodeState& state, u32 array_base, u32 entry_offset,
+                         s32 shift);
+  Result<u32> decodeList(DecodeState& state, u32 offset);
+
+  std::span<const u16> leafList(u32 node) const;
+  void rayNode(u32 node, const glm::vec3& lo, s32 shift, float t0, float t1,
+               const glm::vec3& origin, const glm::vec3& dir,
+               const glm::vec3& inv_dir, KclTypeMask types,
+               std::optional<KclRayHit>& best) const;
+  void boxNode(u32 node, const glm::vec3& lo, s32 shift,
+               const glm::vec3& box_lo, const glm::vec3& box_hi,
+               std::vector<u16>& out) const;
+
+  std::vector<Prism> mPrisms;
+  //! Top-level cubes, then groups of eight children. A node is either the
+  //! index of its first child or 0x80000000 | the offset of its list in
+  //! mLists.
+  std::vector<u32> mNodes;
+  //! Each list is its length followed by 0-based prism indices.
+  std::vector<u16> mLists;
+
+  glm::vec3 mAreaMin{0.0f};
+  glm::uvec3 mAreaMask{0};
+  glm::ivec3 mGrid{0};
+  s32 mBlockShift = 0;
+  s32 mXShift = 0;
+  s32 mXYShift = 0;
+  float mThickness = 0.0f;
+  float mSphereRadius = 0.0f;
+};
+
+} // namespace librii::kcol
@@ -11,6 +11,10 @@
 
 #include <coro/generator.hpp>
 
+namespace librii::sched {
+class TaskScheduler;
+}
+
 inline std::partial_ordering operator<=>(const glm::vec4& l,
                                          const glm::vec4& r) {
   if (auto cmp = l.x <=> r.x; cmp != 0) {
@@ -270,6 +274,20 @@ struct MeshOptimizerStats {
   std::string comment;
 };
 
+// How StripifyTriangles chooses between algorithms
+enum class AlgoPolicy {
+  // Run and validate every algorithm. Ties in vertex count go to the algorithm
+  // declared first in Algo.
+  Exhaustive,
+  // Run algorithms cheapest (or predicted winner) first, sharing the best
+  // vertex count so far. Algorithms not yet started are skipped once the best
+  // cannot be beaten, RiiFans skips fan depths that cannot beat it, and only
+  // the winner is validated. Picks the same result as Exhaustive.
+  Adaptive,
+};
+
+constexpr size_t NoVertexLimit = std::numeric_limits<size_t>::max();
+
 // Uses zeux/meshoptimizer
 Result<MeshOptimizerStats>
 StripifyTrianglesMeshOptimizer(MatrixPrimitive& prim);
@@ -290,9 +308,14 @@ Result<MeshOptimizerStats> StripifyTrianglesHaroohie(MatrixPrimitive& prim);
 Result<MeshOptimizerStats> StripifyTrianglesDraco(MatrixPrimitive& prim,
                                                   bool allow_degen);
 
+// Triangles left over after fanning are stripified with |policy|. Gives up
+// with an error, before stripifying them, once the output cannot fit in
+// |max_vertices| vertices.
 Result<MeshOptimizerStats>
 ToFanTriangles(MatrixPrimitive& prim, u32 min_len = 4,
-               size_t max_runs = std::numeric_limits<size_t>::max());
+               size_t max_runs = std::numeric_limits<size_t>::max(),
+               size_t max_vertices = NoVertexLimit,
+               AlgoPolicy policy = AlgoPolicy::Exhaustive);
 
 enum class Algo {
   NvTriStrip,
@@ -303,14 +326,28 @@ enum class Algo {
   DracoDegen,
   RiiFans,
 };
-Result<MeshOptimizerStats> StripifyTrianglesAlgo(MatrixPrimitive& prim,
-                                                 Algo algo);
+// |max_vertices| and |policy| only apply to RiiFans, which stripifies the
+// triangles it cannot fan with the others.
+Result<MeshOptimizerStats>
+StripifyTrianglesAlgo(MatrixPrimitive& prim, Algo algo,
+                      size_t max_vertices = NoVertexLimit,
+                      AlgoPolicy policy = AlgoPolicy::Exhaustive);
+
+// Try every algorithm as allowed by |policy|, keeping the best result
+Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
+                               std::optional<Algo> except = std::nullopt,
+                               std::string_view debug_name = "?",
+                               bool verbose = true,
+                               AlgoPolicy policy = AlgoPolicy::Exhaustive);
 
-// Brute-force every algorithm
+// Each algorithm runs as a task on |scheduler|. Safe to call from a task on the
+// same scheduler.
 Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
+                               sched::TaskScheduler& scheduler,
                                std::optional<Algo> except = std::nullopt,
                                std::string_view debug_name = "?",
-                               bool verbose = true);
+                               bool verbose = true,
+                               AlgoPolicy policy = AlgoPolicy::Exhaustive);
 
 Result<SceneTree> ReadSceneTree(std::span<const u8> file_data);
 
@@ -13,6 +13,7 @@
 #define throw
 #include <fort.hpp>
 #undef throw
+#include <librii/sched/TaskScheduler.hpp>
 #include <rsl/Ranges.hpp>
 
 #if defined(__APPLE__) || defined(__linux__)
@@ -131,6 +132,116 @@ Result<void> ValidateMeshesEqual(const MatrixPrimitive& l,
   return ValidateMeshesEqualImpl(ll, rl);
 }
 
+// Error of an algorithm that gave up because its output grew too large
+const std::string_view OverBudget = "Exceeded vertex budget";
+
+// Running vertex count of the fans, so that ToFanTriangles can skip stripping
+// the leftover triangles once it cannot beat the best result found so far.
+class VertexBudget {
+public:
+  explicit VertexBudget(size_t max_vertices) : remaining_(max_vertices) {}
+
+  // Account for |n| more output vertices.
+  [[nodiscard]] Result<void> Spend(size_t n) {
+    if (n > remaining_) {
+      remaining_ = 0;
+      return std::unexpected(std::string(OverBudget));
+    }
+    remaining_ -= n;
+    return {};
+  }
+
+  size_t Remaining() const { return remaining_; }
+
+private:
+  size_t remaining_;
+};
+
+// Connectivity of an unindexed triangle list, used to order the algorithms
+// and to know when a result cannot be beaten.
+struct TriangleStats {
+  // Degenerate triangles are excluded, as validation ignores them
+  size_t triangles = 0;
+  // Sets of triangles connected by shared edges
+  size_t components = 0;
+  // Triangles touching a vertex shared by at least FanValence triangles
+  size_t fan_triangles = 0;
+
+  static constexpr u32 FanValence = 8;
+
+  // A strip or fan of N triangles takes N + 2 vertices and cannot cross
+  // between components, so no encoding without degenerates beats this.
+  size_t LowerBound() const { return triangles + 2 * components; }
+};
+
+Result<TriangleStats> AnalyzeTriangles(const MatrixPrimitive& prim) {
+  EXPECT(prim.primitives.size() == 1);
+  EXPECT(prim.primitives[0].topology == Topology::Triangles);
+  const auto& vertices = prim.primitives[0].vertices;
+  EXPECT(vertices.size() % 3 == 0);
+
+  // Weld identical vertices. Sorting avoids IndexBuffer's quadratic search.
+  std::vector<u32> order(vertices.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order,
+                    [&](u32 l, u32 r) { return vertices[l] < vertices[r]; });
+  std::vector<u32> ids(vertices.size());
+  u32 num_ids = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i == 0 || vertices[order[i - 1]] != vertices[order[i]]) {
+      ++num_ids;
+    }
+    ids[order[i]] = num_ids - 1;
+  }
+
+  TriangleStats stats;
+  std::vector<std::array<u32, 3>> tris;
+  std::vector<u32> valence(num_ids);
+  // (Welded endpoints, triangle) for every edge
+  std::vector<std::pair<u64, u32>> edges;
+  for (size_t i = 0; i < ids.size(); i += 3) {
+    const std::array<u32, 3> tri{ids[i], ids[i + 1], ids[i + 2]};
+    if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+      continue;
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      const u32 a = tri[j], b = tri[(j + 1) % 3];
+      const u64 key = (static_cast<u64>(std::min(a, b)) << 32) | std::max(a, b);
+      edges.emplace_back(key, static_cast<u32>(tris.size()));
+      ++valence[a];
+    }
+    tris.push_back(tri);
+  }
+  stats.triangles = tris.size();
+
+  // Union triangles that share an edge
+  std::vector<u32> parent(tris.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  const auto find = [&](u32 x) {
+    while (parent[x] != x) {
+      x = parent[x] = parent[parent[x]];
+    }
+    return x;
+  };
+  std::ranges::sort(edges);
+  for (size_t i = 1; i < edges.size(); ++i) {
+    if (edges[i].first == edges[i - 1].first) {
+      parent[find(edges[i].second)] = find(edges[i - 1].second);
+    }
+  }
+  for (u32 i = 0; i < tris.size(); ++i) {
+    if (find(i) == i) {
+      ++stats.components;
+    }
+    if (std::ranges::any_of(tris[i], [&](u32 v) {
+          return valence[v] >= TriangleStats::FanValence;
+        })) {
+      ++stats.fan_triangles;
+    }
+  }
+  return stats;
+}
+
 // Instruments collection of Optimizer stats of a certain primitive encoding
 // algorithm like triangle stripification.
 class MeshOptimizerStatsCollector {
@@ -192,30 +303,38 @@ public:
     return (experiments_[key] = baseline_);
   }
 
+  void RemoveExperiment(KeyT key) {
+    experiments_.erase(key);
+    stats_.erase(key);
+  }
+
   const MatrixPrimitive& GetExperiment(KeyT key) const {
     assert(experiments_.contains(key));
     return experiments_.at(key);
   }
 
-  [[nodiscard]] Result<void> ValidateExperimentWithBaseline(KeyT key) const {
-    assert(experiments_.contains(key));
+  // Build the cached baseline TriList. After this succeeds,
+  // ValidateExperimentWithBaseline may be called from multiple threads.
+  [[nodiscard]] Result<void> PrepareValidation() const {
     // Constructing a TriList is sufficiently expensive to warrant caching.
     if (!baselineList_) {
       TriList list;
       TRY(list.SetFromMPrim(baseline_));
       baselineList_ = std::move(list);
     }
+    return {};
+  }
+
+  [[nodiscard]] Result<void> ValidateExperimentWithBaseline(KeyT key) const {
+    assert(experiments_.contains(key));
+    TRY(PrepareValidation());
     TriList ref;
     TRY(ref.SetFromMPrim(experiments_.at(key)));
     return ValidateMeshesEqualImpl(*baselineList_, ref);
   }
 
   [[nodiscard]] Result<void> ValidateAllWithBaseline() const {
-    if (!baselineList_) {
-      TriList list;
-      TRY(list.SetFromMPrim(baseline_));
-      baselineList_ = std::move(list);
-    }
+    TRY(PrepareValidation());
     for (auto& [key, experiment] : experiments_) {
       TriList ref;
       TRY(ref.SetFromMPrim(experiments_.at(key)));
@@ -569,9 +688,18 @@ Result<MeshOptimizerStats> StripifyTrianglesHaroohie(MatrixPrimitive& prim) {
   return stats.End();
 }
 
+static Result<Algo> StripifyTrianglesImpl(MatrixPrimitive& prim,
+                                          sched::TaskScheduler* scheduler,
+                                          std::optional<Algo> except,
+                                          std::string_view debug_name,
+                                          bool verbose, AlgoPolicy policy,
+                                          size_t max_vertices);
+
 Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
-                                          size_t max_runs) {
+                                          size_t max_runs, size_t max_vertices,
+                                          AlgoPolicy policy) {
   MeshOptimizerStatsCollector stats(prim);
+  VertexBudget budget(max_vertices);
   auto buf = TRY(IndexBuffer<u32>::create(prim));
 
   PrimitiveRestartSplitter splitter(Topology::TriangleFan, buf.vertices, ~0u);
@@ -584,6 +712,7 @@ Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
 
   prim.primitives.clear();
   for (Primitive& p : splitter.Primitives()) {
+    TRY(budget.Spend(p.vertices.size()));
     prim.primitives.push_back(std::move(p));
   }
 #ifndef NDEBUG
@@ -594,10 +723,17 @@ Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
   if (prim.primitives.size() > 0) {
     auto& triangles = prim.primitives[prim.primitives.size() - 1];
     if (triangles.topology == Topology::Triangles) {
+      // Stripping can at best bring N triangles down to N + 2 vertices
+      const size_t leftover_budget =
+          budget.Remaining() + triangles.vertices.size();
+      if (triangles.vertices.size() / 3 + 2 > leftover_budget) {
+        return std::unexpected(std::string(OverBudget));
+      }
       MatrixPrimitive tmp;
       tmp.draw_matrices = prim.draw_matrices;
       tmp.primitives.push_back(triangles);
-      auto algo = TRY(StripifyTriangles(tmp, Algo::RiiFans));
+      auto algo = TRY(StripifyTrianglesImpl(tmp, nullptr, Algo::RiiFans, "?",
+                                            true, policy, leftover_budget));
       prim.primitives.resize(prim.primitives.size() - 1);
       for (auto& x : tmp.primitives) {
         prim.primitives.push_back(x);
@@ -610,7 +746,9 @@ Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
   return stats.End();
 }
 
-Result<MeshOptimizerStats> ToFanTriangles2(MatrixPrimitive& prim) {
+Result<MeshOptimizerStats> ToFanTriangles2(MatrixPrimitive& prim,
+                                           size_t max_vertices,
+                                           AlgoPolicy policy) {
   MeshOptimizerStatsCollector stats(prim);
   auto vc = VertexCount(prim);
   if (vc >= 20'000) {
@@ -622,10 +760,23 @@ Result<MeshOptimizerStats> ToFanTriangles2(MatrixPrimitive& prim) {
   std::array<size_t, 6> depths = {vc, 5, 10, 20, 40, 80};
 
   MeshOptimizerExperimentHolder<size_t> experiments(prim);
+  bool any = false;
   for (auto& d : depths) {
     auto& tmp = experiments.CreateExperiment(d);
-    auto stats = TRY(ToFanTriangles(tmp, 4, d));
-    experiments.SetStats(d, stats);
+    auto stats = ToFanTriangles(tmp, 4, d, max_vertices, policy);
+    if (!stats && stats.error() == OverBudget) {
+      experiments.RemoveExperiment(d);
+      continue;
+    }
+    experiments.SetStats(d, TRY(stats));
+    any = true;
+    if (policy == AlgoPolicy::Adaptive) {
+      // Later depths only need to beat this one
+      max_vertices = std::min(max_vertices, VertexCount(tmp));
+    }
+  }
+  if (!any) {
+    return std::unexpected(std::string(OverBudget));
   }
   // TRY(experiments.ValidateAllWithBaseline());
   prim = experiments.GetFirstWinner();
@@ -705,7 +856,9 @@ Result<MeshOptimizerStats> StripifyTrianglesDraco(MatrixPrimitive& prim,
 }
 
 Result<MeshOptimizerStats> StripifyTrianglesAlgo(MatrixPrimitive& prim,
-                                                 Algo algo) {
+                                                 Algo algo,
+                                                 size_t max_vertices,
+                                                 AlgoPolicy policy) {
   switch (algo) {
   case Algo::MeshOptmzr:
     return StripifyTrianglesMeshOptimizer(prim);
@@ -721,17 +874,57 @@ Result<MeshOptimizerStats> StripifyTrianglesAlgo(MatrixPrimitive& prim,
     return StripifyTrianglesDraco(prim, true);
   case Algo::RiiFans:
     // This calls everything else on result.
-    return ToFanTriangles2(prim);
+    return ToFanTriangles2(prim, max_vertices, policy);
   }
   return std::unexpected("Invalid mesh algorithm");
 }
 
-// Brute-force every algorithm
-Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
-                               std::optional<Algo> except,
-                               std::string_view debug_name, bool verbose) {
+// Rough relative cost of each algorithm on the same input
+static int AlgoCost(Algo algo) {
+  switch (algo) {
+  case Algo::MeshOptmzr:
+    return 0;
+  case Algo::Draco:
+  case Algo::DracoDegen:
+    return 2;
+  case Algo::NvTriStrip:
+    return 4;
+  case Algo::Haroohie:
+    return 6;
+  case Algo::TriStripper:
+    return 8;
+  case Algo::RiiFans:
+    // Fans every triangle six ways, then stripifies what is left each time
+    return 10;
+  }
+  return 10;
+}
+
+// Order |algos| for AlgoPolicy::Adaptive. Cheap algorithms go first to set a
+// tight budget for the rest. When most triangles surround high-valence
+// vertices, fans are likely to win, so they move ahead of the slower
+// stripifiers.
+static void OrderForAdaptive(std::vector<Algo>& algos,
+                             const TriangleStats& stats) {
+  const bool fans_likely = stats.fan_triangles * 2 > stats.triangles;
+  const auto cost = [&](Algo e) {
+    return e == Algo::RiiFans && fans_likely ? 5 : AlgoCost(e);
+  };
+  std::ranges::stable_sort(
+      algos, [&](Algo l, Algo r) { return cost(l) < cost(r); });
+}
+
+// Try the algorithms as allowed by |policy|. With a |scheduler|, each
+// algorithm runs as a separate task; otherwise they run in order on this
+// thread.
+static Result<Algo> StripifyTrianglesImpl(MatrixPrimitive& prim,
+                                          sched::TaskScheduler* scheduler,
+                                          std::optional<Algo> except,
+                                          std::string_view debug_name,
+                                          bool verbose, AlgoPolicy policy,
+                                          size_t max_vertices) {
   MeshOptimizerExperimentHolder<Algo> experiments(prim);
-  u32 ms_on_validate = 0;
+  std::vector<Algo> algos;
   for (auto e : magic_enum::enum_values<Algo>()) {
     if (except && *except == e) {
       // Disabled by user input
@@ -749,27 +942,141 @@ Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
       // This almost *never* wins, and is quite slow at that, but is here so we
       // can never possibly lose to BrawlBox.
     }
-    auto& tmp = experiments.CreateExperiment(e);
-    auto results = StripifyTrianglesAlgo(tmp, e);
-    if (!results) {
-      experiments.CreateExperiment(e);
-      experiments.SetStats(e, {.comment = results.error()});
-      continue;
+    algos.push_back(e);
+  }
+
+  // Experiments are created before any task runs so that tasks only ever
+  // touch their own MatrixPrimitive.
+  struct Outcome {
+    MatrixPrimitive* experiment = nullptr;
+    Result<MeshOptimizerStats> stats;
+    u32 ms_on_validate = 0;
+    bool skipped = false;
+  };
+  const bool adaptive = policy == AlgoPolicy::Adaptive;
+  std::optional<size_t> lower_bound;
+  if (adaptive) {
+    if (auto stats = AnalyzeTriangles(prim)) {
+      OrderForAdaptive(algos, *stats);
+      lower_bound = stats->LowerBound();
+    }
+  }
+  std::vector<Outcome> outcomes(algos.size());
+  for (size_t i = 0; i < algos.size(); ++i) {
+    outcomes[i].experiment = &experiments.CreateExperiment(algos[i]);
+  }
+  // Results are ranked by vertex count, then by declaration order of Algo, so
+  // the winner never depends on which task finished first.
+  constexpr size_t NumAlgos = magic_enum::enum_count<Algo>();
+  const auto rank = [&](size_t i) {
+    return VertexCount(*outcomes[i].experiment) * NumAlgos +
+           *magic_enum::enum_index(algos[i]);
+  };
+  // Adaptive: rank of the best result so far, shared by all tasks
+  std::atomic<size_t> best = NoVertexLimit;
+  // Exhaustive validates every result as soon as it is ready
+  const auto baseline =
+      adaptive ? Result<void>{} : experiments.PrepareValidation();
+
+  const auto run = [&](size_t i) {
+    auto& out = outcomes[i];
+    size_t budget = max_vertices;
+    if (adaptive) {
+      const size_t so_far = best.load(std::memory_order_relaxed);
+      if (so_far != NoVertexLimit) {
+        // Ties only win against algorithms declared after this one
+        const size_t count = so_far / NumAlgos;
+        const bool wins_ties =
+            *magic_enum::enum_index(algos[i]) < so_far % NumAlgos;
+        budget = std::min(budget, wins_ties ? count : count - 1);
+      }
+      if (lower_bound && *lower_bound > budget) {
+        // Nothing can do better
+        out.skipped = true;
+        return;
+      }
+    }
+    out.stats =
+        StripifyTrianglesAlgo(*out.experiment, algos[i], budget, policy);
+    if (!out.stats) {
+      return;
+    }
+    if (adaptive) {
+      if (VertexCount(*out.experiment) > budget) {
+        out.stats = std::unexpected(std::string(OverBudget));
+        return;
+      }
+      const size_t mine = rank(i);
+      size_t so_far = best.load(std::memory_order_relaxed);
+      while (mine < so_far && !best.compare_exchange_weak(so_far, mine)) {
+      }
+      return;
     }
-    // If invalid, reset and comment the error
     rsl::Timer timer;
-    auto ok = experiments.ValidateExperimentWithBaseline(e);
-    ms_on_validate += timer.elapsed();
+    auto ok = baseline ? experiments.ValidateExperimentWithBaseline(algos[i])
+                       : baseline;
+    out.ms_on_validate = timer.elapsed();
     if (!ok) {
+      out.stats = std::unexpected(ok.error());
+    }
+  };
+  if (scheduler != nullptr) {
+    // Spawned in reverse: this thread pops its own queue from the back, so it
+    // starts on the cheapest algorithm while idle workers steal the expensive
+    // ones from the front.
+    sched::TaskGroup group;
+    for (size_t i = algos.size(); i-- > 0;) {
+      scheduler->spawn(group, [&run, i] { run(i); });
+    }
+    scheduler->wait(group);
+  } else {
+    for (size_t i = 0; i < algos.size(); ++i) {
+      run(i);
+    }
+  }
+
+  std::vector<size_t> ranked;
+  for (size_t i = 0; i < algos.size(); ++i) {
+    if (!outcomes[i].skipped && outcomes[i].stats) {
+      ranked.push_back(i);
+    }
+  }
+  std::ranges::sort(ranked,
+                    [&](size_t l, size_t r) { return rank(l) < rank(r); });
+  std::optional<size_t> winner;
+  for (size_t i : ranked) {
+    if (adaptive) {
+      // Validate only the winner, falling back to the runner-up if it is
+      // broken
+      auto& out = outcomes[i];
+      rsl::Timer timer;
+      auto ok = experiments.ValidateExperimentWithBaseline(algos[i]);
+      out.ms_on_validate = timer.elapsed();
+      if (!ok) {
+        out.stats = std::unexpected(ok.error());
+        continue;
+      }
+    }
+    winner = i;
+    break;
+  }
+
+  u32 ms_on_validate = 0;
+  for (size_t i = 0; i < algos.size(); ++i) {
+    const Algo e = algos[i];
+    auto& out = outcomes[i];
+    if (out.skipped) {
+      experiments.RemoveExperiment(e);
+      continue;
+    }
+    ms_on_validate += out.ms_on_validate;
+    // If invalid, reset and comment the error
+    if (!out.stats) {
       experiments.CreateExperiment(e);
-      experiments.SetStats(e, {.comment = ok.error()});
+      experiments.SetStats(e, {.comment = out.stats.error()});
       continue;
     }
-    experiments.SetStats(e, *results);
-  }
-  std::vector<std::string_view> winners;
-  for (Algo e : experiments.CalcWinners()) {
-    winners.push_back(magic_enum::enum_name(e));
+    experiments.SetStats(e, *out.stats);
   }
   if (verbose && !except) {
     auto table = PrintScoresOfExperiment(experiments);
@@ -780,8 +1087,35 @@ Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
                "validation\n---\n",
                debug_name, thread_id.str(), table, ms_on_validate);
   }
-  prim = experiments.GetFirstWinner();
-  return experiments.GetFirstWinnerAlgo();
+  if (!winner) {
+    // Every algorithm failed: keep the triangle list
+    if (experiments.GetBaselineScore() > max_vertices) {
+      return std::unexpected(std::string(OverBudget));
+    }
+    return std::ranges::min(algos);
+  }
+  if (VertexCount(*outcomes[*winner].experiment) > max_vertices) {
+    return std::unexpected(std::string(OverBudget));
+  }
+  prim = *outcomes[*winner].experiment;
+  return algos[*winner];
+}
+
+Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
+                               std::optional<Algo> except,
+                               std::string_view debug_name, bool verbose,
+                               AlgoPolicy policy) {
+  return StripifyTrianglesImpl(prim, nullptr, except, debug_name, verbose,
+                               policy, NoVertexLimit);
+}
+
+Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
+                               sched::TaskScheduler& scheduler,
+                               std::optional<Algo> except,
+                               std::string_view debug_name, bool verbose,
+                               AlgoPolicy policy) {
+  return StripifyTrianglesImpl(prim, &scheduler, except, debug_name, verbose,
+                               policy, NoVertexLimit);
 }
 
 } // namespace librii::rhst
@@ -0,0 +1,134 @@
+#include "TaskScheduler.hpp"
+
+namespace librii::sched {
+
+namespace {
+// Which scheduler (if any) the current thread is a worker of
+thread_local const TaskScheduler* tlScheduler = nullptr;
+thread_local u32 tlQueue = 0;
+} // namespace
+
+TaskScheduler::TaskScheduler(u32 num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  // The waiting thread takes the place of one worker
+  for (u32 i = 0; i < num_threads; ++i) {
+    mQueues.push_back(std::make_unique<Queue>());
+  }
+  for (u32 i = 1; i < num_threads; ++i) {
+    mWorkers.emplace_back([this, i] { workerMain(i); });
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::unique_lock g(mSleepLock);
+    mStopping = true;
+  }
+  mWake.notify_all();
+  for (auto& worker : mWorkers) {
+    worker.join();
+  }
+}
+
+TaskScheduler& TaskScheduler::shared() {
+  static TaskScheduler sScheduler;
+  return sScheduler;
+}
+
+u32 TaskScheduler::localQueue() const {
+  return tlScheduler == this ? tlQueue : 0;
+}
+
+void TaskScheduler::spawn(TaskGroup& group, std::function<void()> task) {
+  group.mPending.fetch_add(1, std::memory_order_relaxed);
+  {
+    // Counted before it is visible so mQueued never underflows. Taking the
+    // lock pairs with the predicate checks in wait() and workerMain().
+    std::unique_lock g(mSleepLock);
+    ++mQueued;
+  }
+  auto& queue = *mQueues[localQueue()];
+  {
+    std::unique_lock g(queue.lock);
+    queue.tasks.push_back(Task{.fn = std::move(task), .group = &group});
+  }
+  mWake.notify_one();
+}
+
+bool TaskScheduler::tryPop(u32 queue, Task& out) {
+  auto& q = *mQueues[queue];
+  std::unique_lock g(q.lock);
+  if (q.tasks.empty()) {
+    return false;
+  }
+  out = std::move(q.tasks.back());
+  q.tasks.pop_back();
+  --mQueued;
+  return true;
+}
+
+bool TaskScheduler::trySteal(u32 thief, Task& out) {
+  const u32 n = mQueues.size();
+  for (u32 i = 1; i < n; ++i) {
+    auto& q = *mQueues[(thief + i) % n];
+    std::unique_lock g(q.lock);
+    if (q.tasks.empty()) {
+      continue;
+    }
+    // Oldest first: those are the largest units of work
+    out = std::move(q.tasks.front());
+    q.tasks.pop_front();
+    --mQueued;
+    return true;
+  }
+  return false;
+}
+
+bool TaskScheduler::tryRunOne() {
+  const u32 self = localQueue();
+  Task task;
+  if (!tryPop(self, task) && !trySteal(self, task)) {
+    return false;
+  }
+  run(task);
+  return true;
+}
+
+void TaskScheduler::run(Task& task) {
+  task.fn();
+  auto* group = task.group;
+  if (group->mPending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // Wake anyone in wait() on this group
+    { std::unique_lock g(mSleepLock); }
+    mWake.notify_all();
+  }
+}
+
+void TaskScheduler::wait(TaskGroup& group) {
+  while (!group.done()) {
+    if (tryRunOne()) {
+      continue;
+    }
+    std::unique_lock g(mSleepLock);
+    mWake.wait(g, [&] { return group.done() || mQueued > 0; });
+  }
+}
+
+void TaskScheduler::workerMain(u32 index) {
+  tlScheduler = this;
+  tlQueue = index;
+  while (true) {
+    if (tryRunOne()) {
+      continue;
+    }
+    std::unique_lock g(mSleepLock);
+    mWake.wait(g, [&] { return mStopping || mQueued > 0; });
+    if (mStopping) {
+      return;
+    }
+  }
+}
+
+} // namespace librii::sched
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <core/common.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace librii::sched {
+
+class TaskScheduler;
+
+//! @brief Set of tasks that can be waited on together.
+//!
+//! Must outlive every task spawned into it; TaskScheduler::wait guarantees
+//! that when called before the group goes out of scope.
+//!
+class TaskGroup {
+public:
+  TaskGroup() = default;
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  bool done() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class TaskScheduler;
+  std::atomic<u32> mPending = 0;
+};
+
+//! @brief Fixed pool of worker threads with per-worker task deques.
+//!
+//! Tasks spawned on a worker go to the back of its own deque and are popped
+//! LIFO, keeping related work on one core. Idle workers steal from the front
+//! of the other deques. Threads in wait() run queued tasks instead of
+//! blocking, so tasks may spawn and wait on subtasks without deadlocking or
+//! adding threads.
+//!
+class TaskScheduler {
+public:
+  //! @param num_threads Total threads running tasks, including the one that
+  //! waits. 0 for one per core.
+  explicit TaskScheduler(u32 num_threads = 0);
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+  //! Queue |task| as part of |group|. Tasks must not throw.
+  void spawn(TaskGroup& group, std::function<void()> task);
+
+  //! Run queued tasks until every task in |group| has finished.
+  void wait(TaskGroup& group);
+
+  u32 numThreads() const { return mQueues.size(); }
+
+  //! Process-wide scheduler with one thread per core.
+  static TaskScheduler& shared();
+
+private:
+  struct Task {
+    std::function<void()> fn;
+    TaskGroup* group = nullptr;
+  };
+  struct Queue {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  // Queue index of the calling thread, or the shared queue for non-workers
+  u32 localQueue() const;
+  bool tryPop(u32 queue, Task& out);
+  bool trySteal(u32 thief, Task& out);
+  bool tryRunOne();
+  void run(Task& task);
+  void workerMain(u32 index);
+
+  // mQueues[0] is fed by threads outside the pool; the rest belong to workers
+  std::vector<std::unique_ptr<Queue>> mQueues;
+  std::vector<std::thread> mWorkers;
+
+  std::mutex mSleepLock;
+  std::condition_variable mWake;
+  std::atomic<u32> mQueued = 0;
+  bool mStopping = false;
+};
+
+} // namespace librii::sched
@@ -1,4 +1,6 @@
 #include "SZS.hpp"
+#include <cstring>
+#include <librii/sched/TaskScheduler.hpp>
 #include <oishii/writer/binary_writer.hxx>
 
 namespace librii::szs {
@@ -11,76 +13,132 @@ Result<u32> getExpandedSize(std::span<const u8> src) {
   return (src[4] << 24) | (src[5] << 16) | (src[6] << 8) | src[7];
 }
 
-Result<void> decode(std::span<u8> dst, std::span<const u8> src) {
-  EXPECT(dst.size() >= TRY(getExpandedSize(src)));
-
-  int in_position = 0x10;
-  int out_position = 0;
-
-  const auto take8 = [&]() {
-    const u8 result = src[in_position];
-    ++in_position;
-    return result;
-  };
-  const auto take16 = [&]() {
-    const u32 high = src[in_position];
-    ++in_position;
-    const u32 low = src[in_position];
-    ++in_position;
-    return (high << 8) | low;
-  };
-  const auto give8 = [&](u8 val) {
-    dst[out_position] = val;
-    ++out_position;
-  };
-
-  const auto read_group = [&](bool raw) {
-    if (raw) {
-      give8(take8());
-      return;
+// Copy a backreference of |len| bytes from |out - dist| to |out|. May write up
+// to 15 bytes past |out + len|; the caller guarantees that space exists.
+static inline void copyBackref(u8* out, u32 dist, u32 len) {
+  const u8* from = out - dist;
+  if (dist >= 16) {
+    // Every 16-byte chunk only reads bytes written before it
+    for (u32 i = 0; i < len; i += 16) {
+      std::memcpy(out + i, from + i, 16);
     }
-
-    const u16 group = take16();
-    const int reverse = (group & 0xfff) + 1;
-    const int g_size = group >> 12;
-
-    int size = g_size ? g_size + 2 : take8() + 18;
-
-    // Invalid data could buffer overflow
-
-    for (int i = 0; i < size; ++i) {
-      give8(dst[out_position - reverse]);
+  } else if (dist >= 8) {
+    for (u32 i = 0; i < len; i += 8) {
+      std::memcpy(out + i, from + i, 8);
     }
-  };
-
-  const auto read_chunk = [&]() {
-    const u8 header = take8();
-
-    for (int i = 0; i < 8; ++i) {
-      if (in_position >= src.size() || out_position >= dst.size())
-        return;
-      read_group(header & (1 << (7 - i)));
+  } else if (dist == 1) {
+    std::memset(out, *from, len);
+  } else {
+    // Replicate the pattern until it spans at least 8 bytes. A pattern of
+    // period |dist| also repeats at any multiple of |dist|.
+    const u32 period = dist * ((8 + dist - 1) / dist);
+    const u32 head = std::min(period, len);
+    for (u32 i = 0; i < head; ++i) {
+      out[i] = from[i];
     }
-  };
-
-  while (in_position < src.size() && out_position < dst.size())
-    read_chunk();
+    for (u32 i = head; i < len; i += 8) {
+      std::memcpy(out + i, out + i - period, 8);
+    }
+  }
+}
 
-  // if (out_position < dst.size())
-  //   return llvm::createStringError(
-  //       std::errc::executable_format_error,
-  //       "Truncated source file: the file could not be decompressed fully");
+Result<void> decode(std::span<u8> dst, std::span<const u8> src) {
+  const u32 expanded_size = TRY(getExpandedSize(src));
+  EXPECT(dst.size() >= expanded_size);
+  EXPECT(src.size() >= 16, "File too small to be a YAZ0 file");
+
+  const u8* in = src.data() + 16;
+  const u8* const in_end = src.data() + src.size();
+  u8* const out_begin = dst.data();
+  u8* out = out_begin;
+  u8* const out_end = out_begin + expanded_size;
+
+  // A group is one header byte and up to eight 3-byte backreferences, each
+  // expanding to at most 273 bytes. Groups that fit entirely, with 15 bytes of
+  // slack for overlong copies, skip all per-token bounds checks.
+  constexpr ptrdiff_t MaxGroupIn = 1 + 8 * 3;
+  constexpr ptrdiff_t MaxGroupOut = 8 * 273 + 15;
+
+  while (out < out_end) {
+    if (in_end - in >= MaxGroupIn && out_end - out >= MaxGroupOut) {
+      u8 header = *in++;
+      for (int i = 0; i < 8; ++i, header <<= 1) {
+        if (header & 0x80) {
+          *out++ = *in++;
+          continue;
+        }
+        const u32 group = (in[0] << 8) | in[1];
+        const u32 dist = (group & 0xfff) + 1;
+        u32 len = group >> 12;
+        in += 2;
+        len = len ? len + 2 : *in++ + 18;
+        if (dist > out - out_begin) [[unlikely]] {
+          return std::unexpected(std::format(
+              "Invalid YAZ0 backreference at 0x{:x}: distance {} exceeds the "
+              "{} bytes decoded so far",
+              in - src.data(), dist, out - out_begin));
+        }
+        copyBackref(out, dist, len);
+        out += len;
+      }
+      continue;
+    }
 
-  // if (in_position != src.size())
-  //   return llvm::createStringError(
-  //       std::errc::no_buffer_space,
-  //       "Invalid YAZ0 header: file is larger than reported");
+    // Near either end of the buffers: check every token
+    if (in == in_end) {
+      return std::unexpected(std::format(
+          "Truncated YAZ0 file: expected {} bytes but only decoded {}",
+          expanded_size, out - out_begin));
+    }
+    u8 header = *in++;
+    for (int i = 0; i < 8 && out < out_end; ++i, header <<= 1) {
+      if (header & 0x80) {
+        if (in == in_end) {
+          return std::unexpected("Truncated YAZ0 file: missing literal");
+        }
+        *out++ = *in++;
+        continue;
+      }
+      if (in_end - in < 2) {
+        return std::unexpected("Truncated YAZ0 file: missing backreference");
+      }
+      const u32 group = (in[0] << 8) | in[1];
+      const u32 dist = (group & 0xfff) + 1;
+      u32 len = group >> 12;
+      in += 2;
+      if (len == 0) {
+        if (in == in_end) {
+          return std::unexpected("Truncated YAZ0 file: missing backreference");
+        }
+        len = *in++ + 18;
+      } else {
+        len += 2;
+      }
+      if (dist > out - out_begin) {
+        return std::unexpected(std::format(
+            "Invalid YAZ0 backreference at 0x{:x}: distance {} exceeds the {} "
+            "bytes decoded so far",
+            in - src.data(), dist, out - out_begin));
+      }
+      if (len > out_end - out) {
+        return std::unexpected(std::format(
+            "Invalid YAZ0 backreference at 0x{:x}: {} bytes would overflow the "
+            "expanded size of {}",
+            in - src.data(), len, expanded_size));
+      }
+      const u8* from = out - dist;
+      for (u32 j = 0; j < len; ++j) {
+        out[j] = from[j];
+      }
+      out += len;
+    }
+  }
 
   return {};
 }
 
 u32 getWorstEncodingSize(std::span<const u8> src) {
-  return 16 + roundUp(src.size(), 8) / 8 * 9 - 1;
+  return 16 + roundUp(src.size(), 8) / 8 * 9;
 }
 std::vector<u8> encodeFast(std::span<const u8> src) {
   std::vector<u8> result(getWorstEncodingSize(src));
@@ -113,19 +171,24 @@ std::vector<u8> encodeFast(std::span<const u8> src) {
   return result;
 }
 
-static u16 sSkipTable[256];
+// Per-call scratch state of the matcher, so that encoders may run concurrently.
+struct BMHState {
+  u16 skipTable[256];
+};
 
-static void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
-                      int* matchSize);
-static int searchWindow(const u8* needle, int needleSize, const u8* haystack,
-                        int haystackSize);
-static void computeSkipTable(const u8* needle, int needleSize);
+static void findMatch(BMHState& state, const u8* src, int srcPos, int maxSize,
+                      int* matchOffset, int* matchSize);
+static int searchWindow(BMHState& state, const u8* needle, int needleSize,
+                        const u8* haystack, int haystackSize);
+static void computeSkipTable(BMHState& state, const u8* needle,
+                             int needleSize);
 
 int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize) {
   int srcPos;
   int groupHeaderPos;
   int dstPos;
   u8 groupHeaderBitRaw;
+  BMHState state;
 
   dst[0] = 'Y';
   dst[1] = 'a';
@@ -144,11 +207,12 @@ int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize) {
   while (srcPos < srcSize) {
     int matchOffset;
     int firstMatchLen;
-    findMatch(src, srcPos, srcSize, &matchOffset, &firstMatchLen);
+    findMatch(state, src, srcPos, srcSize, &matchOffset, &firstMatchLen);
     if (firstMatchLen > 2) {
       int secondMatchOffset;
       int secondMatchLen;
-      findMatch(src, srcPos + 1, srcSize, &secondMatchOffset, &secondMatchLen);
+      findMatch(state, src, srcPos + 1, srcSize, &secondMatchOffset,
+                &secondMatchLen);
       if (firstMatchLen + 1 < secondMatchLen) {
         // Put a single byte
         dst[groupHeaderPos] |= groupHeaderBitRaw;
@@ -194,8 +258,136 @@ int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize) {
   return dstPos;
 }
 
-void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
-               int* matchSize) {
+// Matches of one block of the input, before being packed into groups. Each
+// token is either a literal byte or a 2/3-byte backreference.
+struct EncodedBlock {
+  std::vector<u8> payload;
+  std::vector<bool> is_raw;
+};
+
+// Same greedy strategy as encodeBoyerMooreHorspool, but restricted to
+// [begin, end). Backreferences may still reach into the 4 KiB preceding
+// |begin|, so blocks only lose matches that would cross |end|.
+static void encodeBlockBMH(const u8* src, int begin, int end,
+                           EncodedBlock& out) {
+  BMHState state;
+
+  const auto putRaw = [&](int pos) {
+    out.payload.push_back(src[pos]);
+    out.is_raw.push_back(true);
+  };
+  const auto putRef = [&](int offset, int size) {
+    int dist = offset;
+    if (size < 18) {
+      dist |= ((size - 2) << 12);
+      out.payload.push_back(dist >> 8);
+      out.payload.push_back(dist);
+    } else {
+      out.payload.push_back(dist >> 8);
+      out.payload.push_back(dist);
+      out.payload.push_back(size - 18);
+    }
+    out.is_raw.push_back(false);
+  };
+
+  int srcPos = begin;
+  while (srcPos < end) {
+    int matchOffset;
+    int firstMatchLen;
+    findMatch(state, src, srcPos, end, &matchOffset, &firstMatchLen);
+    if (firstMatchLen <= 2) {
+      putRaw(srcPos++);
+      continue;
+    }
+    int secondMatchOffset;
+    int secondMatchLen;
+    findMatch(state, src, srcPos + 1, end, &secondMatchOffset,
+              &secondMatchLen);
+    if (firstMatchLen + 1 < secondMatchLen) {
+      putRaw(srcPos++);
+      firstMatchLen = secondMatchLen;
+      matchOffset = secondMatchOffset;
+    }
+    putRef(srcPos - matchOffset - 1, firstMatchLen);
+    srcPos += firstMatchLen;
+  }
+}
+
+std::vector<u8> encodeBoyerMooreHorspoolParallel(std::span<const u8> src) {
+  return encodeBoyerMooreHorspoolParallel(src, sched::TaskScheduler::shared());
+}
+
+std::vector<u8>
+encodeBoyerMooreHorspoolParallel(std::span<const u8> src,
+                                 sched::TaskScheduler& scheduler) {
+  // Large enough that the scheduling overhead is negligible, small enough that
+  // a few MiB of input is spread across all cores.
+  constexpr u32 BlockSize = 0x20000;
+
+  const u32 num_blocks = (src.size() + BlockSize - 1) / BlockSize;
+  std::vector<EncodedBlock> blocks(num_blocks);
+
+  sched::TaskGroup group;
+  for (u32 i = 0; i < num_blocks; ++i) {
+    scheduler.spawn(group, [&, i] {
+      const u32 begin = i * BlockSize;
+      const u32 end = std::min<u32>(begin + BlockSize, src.size());
+      blocks[i].payload.reserve(end - begin);
+      blocks[i].is_raw.reserve(end - begin);
+      encodeBlockBMH(src.data(), begin, end, blocks[i]);
+    });
+  }
+  scheduler.wait(group);
+
+  // Stitch the blocks into one stream of 8-token groups
+  size_t num_tokens = 0;
+  size_t payload_size = 0;
+  for (auto& block : blocks) {
+    num_tokens += block.is_raw.size();
+    payload_size += block.payload.size();
+  }
+  std::vector<u8> result(16 + (num_tokens + 7) / 8 + payload_size);
+
+  result[0] = 'Y';
+  result[1] = 'a';
+  result[2] = 'z';
+  result[3] = '0';
+
+  result[4] = (src.size() & 0xff00'0000) >> 24;
+  result[5] = (src.size() & 0x00ff'0000) >> 16;
+  result[6] = (src.size() & 0x0000'ff00) >> 8;
+  result[7] = (src.size() & 0x0000'00ff) >> 0;
+
+  auto* dst = result.data() + 16;
+  u8* header = nullptr;
+  u8 headerBit = 0;
+  for (auto& block : blocks) {
+    const u8* it = block.payload.data();
+    for (bool raw : block.is_raw) {
+      if (!headerBit) {
+        header = dst++;
+        *header = 0;
+        headerBit = 0x80;
+      }
+      if (raw) {
+        *header |= headerBit;
+        *dst++ = *it++;
+      } else {
+        // A zero size nibble indicates the 3-byte form
+        const int len = (*it >> 4) ? 2 : 3;
+        dst = std::copy_n(it, len, dst);
+        it += len;
+      }
+      headerBit >>= 1;
+    }
+  }
+  assert(dst == result.data() + result.size());
+
+  return result;
+}
+
+void findMatch(BMHState& state, const u8* src, int srcPos, int maxSize,
+               int* matchOffset, int* matchSize) {
   // SZS backreference types:
   // (2 bytes) N >= 2:  NR RR    -> maxMatchSize=16+2,    windowOffset=4096+1
   // (3 bytes) N >= 18: 0R RR NN -> maxMatchSize=0xFF+18, windowOffset=4096+1
@@ -211,8 +403,9 @@ void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
   int windowOffset;
   int foundMatchOffset;
   while (window < srcPos &&
-         (windowOffset = searchWindow(&src[srcPos], windowSize, &src[window],
-                                      srcPos + windowSize - window)) <
+         (windowOffset =
+              searchWindow(state, &src[srcPos], windowSize, &src[window],
+                           srcPos + windowSize - window)) <
              srcPos - window) {
     for (; windowSize < maxMatchSize; ++windowSize) {
       if (src[window + windowOffset + windowSize] != src[srcPos + windowSize])
@@ -231,28 +424,28 @@ void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
   *matchSize = windowSize > 3 ? windowSize - 1 : 0;
 }
 
-static int searchWindow(const u8* needle, int needleSize, const u8* haystack,
-                        int haystackSize) {
+static int searchWindow(BMHState& state, const u8* needle, int needleSize,
+                        const u8* haystack, int haystackSize) {
   int itHaystack; // r8
   int itNeedle;   // r9
 
   if (needleSize > haystackSize)
     return haystackSize;
-  computeSkipTable(needle, needleSize);
+  computeSkipTable(state, needle, needleSize);
 
   // Scan forwards for the last character in the needle
   for (itHaystack = needleSize - 1;;) {
     while (1) {
       if (needle[needleSize - 1] == haystack[itHaystack])
         break;
-      itHaystack += sSkipTable[haystack[itHaystack]];
+      itHaystack += state.skipTable[haystack[itHaystack]];
     }
     --itHaystack;
     itNeedle = needleSize - 2;
     break;
   Difference:
     // The entire needle was not found, continue search
-    int skip = sSkipTable[haystack[itHaystack]];
+    int skip = state.skipTable[haystack[itHaystack]];
     if (needleSize - itNeedle > skip)
       skip = needleSize - itNeedle;
     itHaystack += skip;
@@ -270,13 +463,153 @@ static int searchWindow(const u8* needle, int needleSize, const u8* haystack,
   return itHaystack + 1;
 }
 
-static void computeSkipTable(const u8* needle, int needleSize) {
+static void computeSkipTable(BMHState& state, const u8* needle,
+                             int needleSize) {
   for (int i = 0; i < 256; ++i) {
-    sSkipTable[i] = needleSize;
+    state.skipTable[i] = needleSize;
   }
   for (int i = 0; i < needleSize; ++i) {
-    sSkipTable[needle[i]] = needleSize - i - 1;
+    state.skipTable[needle[i]] = needleSize - i - 1;
+  }
+}
+
+std::vector<u8> encodeOptimal(std::span<const u8> src) {
+  // SZS backreferences span 3..273 bytes with a distance of 1..4096.
+  constexpr u32 WindowSize = 0x1000;
+  constexpr u32 MinMatch = 3;
+  constexpr u32 MaxMatch = 0xFF + 18;
+  // Token costs in bits, including the group header bit
+  constexpr u32 RawCost = 1 + 8;
+  constexpr u32 ShortRefCost = 1 + 16;
+  constexpr u32 LongRefCost = 1 + 24;
+
+  constexpr u32 HashBits = 15;
+  const auto hash3 = [&](u32 pos) {
+    const u32 v = (src[pos] << 16) | (src[pos + 1] << 8) | src[pos + 2];
+    return (v * 2654435761u) >> (32 - HashBits);
+  };
+
+  const u32 size = src.size();
+
+  // 1. Find the longest match at every position with a hash chain. Any
+  // shorter length at the same distance is also a valid match, so this is all
+  // the parser needs.
+  std::vector<u16> matchLen(size);
+  std::vector<u16> matchDist(size);
+  {
+    std::vector<s32> head(1 << HashBits, -1);
+    std::vector<s32> prev(WindowSize, -1);
+    for (u32 pos = 0; pos + MinMatch <= size; ++pos) {
+      const u32 h = hash3(pos);
+      const u32 maxLen = std::min(MaxMatch, size - pos);
+      u32 bestLen = 0;
+      u32 bestDist = 0;
+      for (s32 cand = head[h]; cand >= 0 && pos - cand <= WindowSize;
+           cand = prev[cand % WindowSize]) {
+        // The candidate can only improve on |bestLen| if it matches there
+        if (src[cand + bestLen] != src[pos + bestLen]) {
+          continue;
+        }
+        u32 len = 0;
+        while (len < maxLen && src[cand + len] == src[pos + len]) {
+          ++len;
+        }
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = pos - cand;
+          if (len == maxLen) {
+            break;
+          }
+        }
+      }
+      if (bestLen >= MinMatch) {
+        matchLen[pos] = bestLen;
+        matchDist[pos] = bestDist;
+      }
+      prev[pos % WindowSize] = head[h];
+      head[h] = pos;
+    }
+  }
+
+  // 2. Backwards DP over the minimum number of bits to encode each suffix.
+  std::vector<u32> cost(size + 1);
+  std::vector<u16> choice(size + 1);
+  cost[size] = 0;
+  for (u32 pos = size; pos-- > 0;) {
+    u32 best = cost[pos + 1] + RawCost;
+    u32 bestLen = 1;
+    for (u32 len = MinMatch; len <= matchLen[pos]; ++len) {
+      const u32 c = cost[pos + len] + (len < 18 ? ShortRefCost : LongRefCost);
+      if (c <= best) {
+        best = c;
+        bestLen = len;
+      }
+    }
+    cost[pos] = best;
+    choice[pos] = bestLen;
+  }
+
+  // 3. Emit the chosen parse
+  const u32 numTokens = [&] {
+    u32 n = 0;
+    for (u32 pos = 0; pos < size; pos += choice[pos]) {
+      ++n;
+    }
+    return n;
+  }();
+  std::vector<u8> result(16 + (numTokens + 7) / 8 + (cost[0] - numTokens) / 8);
+
+  result[0] = 'Y';
+  result[1] = 'a';
+  result[2] = 'z';
+  result[3] = '0';
+
+  result[4] = (size & 0xff00'0000) >> 24;
+  result[5] = (size & 0x00ff'0000) >> 16;
+  result[6] = (size & 0x0000'ff00) >> 8;
+  result[7] = (size & 0x0000'00ff) >> 0;
+
+  auto* dst = result.data() + 16;
+  u8* header = nullptr;
+  u8 headerBit = 0;
+  for (u32 pos = 0; pos < size; pos += choice[pos]) {
+    if (!headerBit) {
+      header = dst++;
+      *header = 0;
+      headerBit = 0x80;
+    }
+    const u32 len = choice[pos];
+    if (len == 1) {
+      *header |= headerBit;
+      *dst++ = src[pos];
+    } else {
+      const u32 dist = matchDist[pos] - 1;
+      if (len < 18) {
+        *dst++ = ((len - 2) << 4) | (dist >> 8);
+        *dst++ = dist & 0xff;
+      } else {
+        *dst++ = dist >> 8;
+        *dst++ = dist & 0xff;
+        *dst++ = len - 18;
+      }
+    }
+    headerBit >>= 1;
+  }
+  assert(dst == result.data() + result.size());
+
+  return result;
+}
+
+std::vector<u8> encode(std::span<const u8> src, Level level) {
+  switch (level) {
+  case Level::Fast:
+    return encodeFast(src);
+  case Level::BoyerMooreHorspool:
+    return encodeBoyerMooreHorspoolParallel(src);
+  case Level::Optimal:
+    break;
   }
+  return encodeOptimal(src);
 }
 
 } // namespace librii::szs
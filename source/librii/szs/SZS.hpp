@@ -4,6 +4,10 @@
 #include <span>
 #include <vector>
 
+namespace librii::sched {
+class TaskScheduler;
+}
+
 namespace librii::szs {
 
 Result<u32> getExpandedSize(std::span<const u8> src);
@@ -14,4 +18,54 @@ std::vector<u8> encodeFast(std::span<const u8> src);
 
 int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize);
 
+//! @brief Encode |src| with the Boyer-Moore-Horspool matcher, one task per
+//! block on |scheduler|.
+//!
+//! The input is split into fixed-size blocks that are matched independently.
+//! Each block may still reference the 4 KiB of history before it, so the
+//! ratio is within a fraction of a percent of encodeBoyerMooreHorspool.
+//!
+//! Safe to call from a task on the same scheduler.
+//!
+//! @param[in] src       Data to compress.
+//! @param[in] scheduler Scheduler to run the blocks on.
+//!
+//! @return The YAZ0 stream (not padded).
+//!
+std::vector<u8>
+encodeBoyerMooreHorspoolParallel(std::span<const u8> src,
+                                 sched::TaskScheduler& scheduler);
+//! encodeBoyerMooreHorspoolParallel on TaskScheduler::shared().
+std::vector<u8> encodeBoyerMooreHorspoolParallel(std::span<const u8> src);
+
+//! @brief Encode |src| with the smallest possible YAZ0 stream.
+//!
+//! The longest match in the 4 KiB window is found for every position with a
+//! hash chain. A dynamic program then picks the parse minimizing the total
+//! size, over literals and the 2-byte and 3-byte backreference forms.
+//!
+//! Roughly 10 bytes of scratch memory are needed per input byte.
+//!
+//! @param[in] src Data to compress.
+//!
+//! @return The YAZ0 stream (not padded).
+//!
+std::vector<u8> encodeOptimal(std::span<const u8> src);
+
+//! @brief Compression strategies, from fastest to smallest output.
+//!
+enum class Level : u32 {
+  //! encodeFast: Store everything as literals.
+  Fast,
+  //! encodeBoyerMooreHorspoolParallel: Greedy matching with a one-byte
+  //! lookahead.
+  BoyerMooreHorspool,
+  //! encodeOptimal: Optimal parse of all matches.
+  Optimal,
+};
+
+//! @brief Encode |src| with the strategy selected by |level|.
+//!
+std::vector<u8> encode(std::span<const u8> src, Level level);
+
 } // namespace librii::szs
@@ -0,0 +1,227 @@
+#include "SZSStream.hpp"
+
+namespace librii::szs {
+
+Result<void> StreamDecoder::feed(std::span<const u8> chunk) {
+  size_t i = 0;
+  if (mHeaderSize < 16) {
+    while (mHeaderSize < 16 && i < chunk.size()) {
+      mHeader[mHeaderSize++] = chunk[i++];
+    }
+    if (mHeaderSize < 16) {
+      return {};
+    }
+    mExpandedSize = TRY(getExpandedSize(mHeader));
+    mOut.reserve(std::min<size_t>(mExpandedSize, OutChunkSize));
+  }
+
+  while (i < chunk.size() && mProduced < mExpandedSize) {
+    if (mGroupLeft == 0) {
+      mGroupHeader = chunk[i++];
+      mGroupLeft = 8;
+      continue;
+    }
+    if (mGroupHeader & 0x80) {
+      put(chunk[i++]);
+    } else {
+      mToken[mTokenSize++] = chunk[i++];
+      // A zero size nibble indicates the 3-byte form
+      if (mTokenSize < 2 || (mTokenSize == 2 && (mToken[0] >> 4) == 0)) {
+        continue;
+      }
+      const u32 dist = (((mToken[0] & 0xf) << 8) | mToken[1]) + 1;
+      const u32 len = (mToken[0] >> 4) ? (mToken[0] >> 4) + 2 : mToken[2] + 18;
+      mTokenSize = 0;
+      if (dist > mProduced) {
+        return std::unexpected(std::format(
+            "Invalid YAZ0 backreference: distance {} exceeds the {} bytes "
+            "decoded so far",
+            dist, mProduced));
+      }
+      if (len > mExpandedSize - mProduced) {
+        return std::unexpected(std::format(
+            "Invalid YAZ0 backreference: {} bytes would overflow the expanded "
+            "size of {}",
+            len, mExpandedSize));
+      }
+      for (u32 j = 0; j < len; ++j) {
+        put(mHistory[(mProduced - dist) % mHistory.size()]);
+      }
+    }
+    mGroupHeader <<= 1;
+    --mGroupLeft;
+  }
+
+  flush();
+  return {};
+}
+
+Result<void> StreamDecoder::finish() {
+  flush();
+  if (mHeaderSize < 16) {
+    return std::unexpected("File too small to be a YAZ0 file");
+  }
+  if (mProduced < mExpandedSize) {
+    return std::unexpected(std::format(
+        "Truncated YAZ0 file: expected {} bytes but only decoded {}",
+        mExpandedSize, mProduced));
+  }
+  return {};
+}
+
+StreamEncoder::StreamEncoder(u32 expanded_size, StreamSink sink, Level level)
+    : mSink(std::move(sink)), mLevel(level), mExpandedSize(expanded_size),
+      mBuffer(BufferSize) {
+  if (mLevel != Level::Fast) {
+    mHead.resize(1 << HashBits, -1);
+    mPrev.resize(WindowSize, -1);
+  }
+  mOut.reserve(OutChunkSize + 25);
+  mOut = {'Y', 'a', 'z', '0'};
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    mOut.push_back(static_cast<u8>(expanded_size >> shift));
+  }
+  mOut.resize(16, 0);
+}
+
+void StreamEncoder::feed(std::span<const u8> chunk) {
+  while (!chunk.empty()) {
+    if (mEnd - mBase == BufferSize) {
+      // Only the window behind the cursor is still referenced
+      const u32 keep = std::max(mBase, mCursor > WindowSize
+                                           ? mCursor - WindowSize
+                                           : 0);
+      std::memmove(mBuffer.data(), mBuffer.data() + (keep - mBase),
+                   mEnd - keep);
+      mBase = keep;
+    }
+    const size_t n =
+        std::min<size_t>(chunk.size(), BufferSize - (mEnd - mBase));
+    std::copy_n(chunk.data(), n, mBuffer.data() + (mEnd - mBase));
+    mEnd += n;
+    chunk = chunk.subspan(n);
+    encode(mEnd >= mExpandedSize);
+  }
+}
+
+Result<void> StreamEncoder::finish() {
+  if (mEnd != mExpandedSize) {
+    return std::unexpected(
+        std::format("Expected {} bytes of input, got {}", mExpandedSize, mEnd));
+  }
+  encode(true);
+  flush();
+  return {};
+}
+
+u32 StreamEncoder::hash3(u32 pos) const {
+  const u32 v = (at(pos) << 16) | (at(pos + 1) << 8) | at(pos + 2);
+  return (v * 2654435761u) >> (32 - HashBits);
+}
+
+void StreamEncoder::insertUpTo(u32 pos) {
+  for (; mHashed < pos && mHashed + 3 <= mEnd; ++mHashed) {
+    const u32 h = hash3(mHashed);
+    mPrev[mHashed % WindowSize] = mHead[h];
+    mHead[h] = mHashed;
+  }
+}
+
+std::pair<u32, u32> StreamEncoder::longestMatch(u32 pos) {
+  if (pos + 3 > mEnd) {
+    return {0, 0};
+  }
+  insertUpTo(pos);
+  const u32 maxLen = std::min(MaxMatch, mEnd - pos);
+  u32 bestLen = 0;
+  u32 bestDist = 0;
+  for (s32 cand = mHead[hash3(pos)]; cand >= 0 && pos - cand <= WindowSize;
+       cand = mPrev[cand % WindowSize]) {
+    // The candidate can only improve on |bestLen| if it matches there
+    if (at(cand + bestLen) != at(pos + bestLen)) {
+      continue;
+    }
+    u32 len = 0;
+    while (len < maxLen && at(cand + len) == at(pos + len)) {
+      ++len;
+    }
+    if (len > bestLen) {
+      bestLen = len;
+      bestDist = pos - cand;
+      if (len == maxLen) {
+        break;
+      }
+    }
+  }
+  return {bestLen, bestDist};
+}
+
+void StreamEncoder::encode(bool final) {
+  while (mCursor < mEnd && (final || mEnd - mCursor >= Lookahead + 2)) {
+    if (mLevel == Level::Fast) {
+      putRaw(at(mCursor++));
+      continue;
+    }
+    auto [len, dist] = longestMatch(mCursor);
+    if (len <= 2) {
+      putRaw(at(mCursor++));
+      continue;
+    }
+    // Same heuristic as encodeBoyerMooreHorspool: prefer a literal if the
+    // next byte starts a much longer match.
+    auto [len2, dist2] = longestMatch(mCursor + 1);
+    if (len + 1 < len2) {
+      putRaw(at(mCursor++));
+      len = len2;
+      dist = dist2;
+    }
+    putRef(dist, len);
+    mCursor += len;
+  }
+}
+
+void StreamEncoder::beginToken() {
+  if (mGroupTokens < 8) {
+    return;
+  }
+  // Previous groups are complete, so they may be written out
+  if (mOut.size() >= OutChunkSize) {
+    flush();
+  }
+  mGroupHeaderPos = mOut.size();
+  mOut.push_back(0);
+  mGroupTokens = 0;
+}
+
+void StreamEncoder::putRaw(u8 b) {
+  beginToken();
+  mOut[mGroupHeaderPos] |= 0x80 >> mGroupTokens;
+  mOut.push_back(b);
+  ++mGroupTokens;
+}
+
+void StreamEncoder::putRef(u32 dist, u32 len) {
+  beginToken();
+  --dist;
+  if (len < 18) {
+    mOut.push_back(((len - 2) << 4) | (dist >> 8));
+    mOut.push_back(dist & 0xff);
+  } else {
+    mOut.push_back(dist >> 8);
+    mOut.push_back(dist & 0xff);
+    mOut.push_back(len - 18);
+  }
+  ++mGroupTokens;
+}
+
+void StreamEncoder::flush() {
+  if (mOut.empty()) {
+    return;
+  }
+  mSink(mOut);
+  mWritten += mOut.size();
+  mOut.clear();
+  mGroupHeaderPos = 0;
+}
+
+} // namespace librii::szs
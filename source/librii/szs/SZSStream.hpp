@@ -0,0 +1,148 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/szs/SZS.hpp>
+#include <span>
+#include <vector>
+
+namespace librii::szs {
+
+//! Receives output of the stream coders, in order. Chunks are only valid for
+//! the duration of the call.
+using StreamSink = std::function<void(std::span<const u8>)>;
+
+//! @brief Incremental YAZ0 decoder.
+//!
+//! Compressed input is fed in chunks of any size. Only a 4 KiB history ring
+//! and a small output buffer are kept, so memory use does not depend on the
+//! size of the file.
+//!
+class StreamDecoder {
+public:
+  explicit StreamDecoder(StreamSink sink) : mSink(std::move(sink)) {}
+
+  //! @brief Consume the next |chunk| of the YAZ0 file.
+  //!
+  //! Input past the end of the stream (padding) is ignored.
+  //!
+  [[nodiscard]] Result<void> feed(std::span<const u8> chunk);
+
+  //! @brief Flush pending output and check the whole file was decoded.
+  //!
+  [[nodiscard]] Result<void> finish();
+
+  //! Size from the YAZ0 header, once the first 16 bytes have been fed.
+  std::optional<u32> expandedSize() const {
+    if (mHeaderSize < 16)
+      return std::nullopt;
+    return mExpandedSize;
+  }
+
+private:
+  void put(u8 b) {
+    mHistory[mProduced % mHistory.size()] = b;
+    ++mProduced;
+    mOut.push_back(b);
+    if (mOut.size() >= OutChunkSize) {
+      flush();
+    }
+  }
+  void flush() {
+    if (!mOut.empty()) {
+      mSink(mOut);
+      mOut.clear();
+    }
+  }
+
+  static constexpr size_t OutChunkSize = 0x10000;
+
+  StreamSink mSink;
+
+  std::array<u8, 16> mHeader{};
+  u32 mHeaderSize = 0;
+  u32 mExpandedSize = 0;
+
+  // Group header and how many of its tokens remain
+  u8 mGroupHeader = 0;
+  u32 mGroupLeft = 0;
+  // Bytes of a backreference split across two chunks
+  std::array<u8, 3> mToken{};
+  u32 mTokenSize = 0;
+
+  std::array<u8, 0x1000> mHistory{};
+  u32 mProduced = 0;
+  std::vector<u8> mOut;
+};
+
+//! @brief Incremental YAZ0 encoder.
+//!
+//! Only the 4 KiB window and the 273 bytes of lookahead are retained, so input
+//! may be fed in chunks of any size and memory use is constant.
+//!
+//! Level::BoyerMooreHorspool uses the same parse as encodeBoyerMooreHorspool
+//! (longest match, one byte of lookahead) with a hash chain, and produces
+//! output of the same size. Level::Optimal needs the whole input and is not
+//! supported; it behaves as Level::BoyerMooreHorspool.
+//!
+class StreamEncoder {
+public:
+  //! @param[in] expanded_size Total size of the input, for the YAZ0 header.
+  StreamEncoder(u32 expanded_size, StreamSink sink,
+                Level level = Level::BoyerMooreHorspool);
+
+  //! @brief Consume the next |chunk| of the input.
+  //!
+  void feed(std::span<const u8> chunk);
+
+  //! @brief Encode the remaining input and flush all output.
+  //!
+  //! @return Error if the input did not match |expanded_size|.
+  //!
+  [[nodiscard]] Result<void> finish();
+
+  //! Number of bytes passed to the sink so far.
+  u64 written() const { return mWritten; }
+
+private:
+  static constexpr u32 WindowSize = 0x1000;
+  static constexpr u32 MaxMatch = 0xFF + 18;
+  // Lookahead needed to encode the token at the cursor: the longest match at
+  // the cursor and at the byte after.
+  static constexpr u32 Lookahead = 1 + MaxMatch;
+  static constexpr u32 BufferSize = 0x4000;
+  static constexpr u32 HashBits = 15;
+  static constexpr size_t OutChunkSize = 0x10000;
+
+  u8 at(u32 pos) const { return mBuffer[pos - mBase]; }
+  u32 hash3(u32 pos) const;
+  void insertUpTo(u32 pos);
+  std::pair<u32, u32> longestMatch(u32 pos);
+
+  void encode(bool final);
+  void beginToken();
+  void putRaw(u8 b);
+  void putRef(u32 dist, u32 len);
+  void flush();
+
+  StreamSink mSink;
+  Level mLevel;
+  u32 mExpandedSize;
+
+  // Absolute stream positions: mBuffer[0] holds byte |mBase|
+  std::vector<u8> mBuffer;
+  u32 mBase = 0;
+  u32 mEnd = 0;
+  u32 mCursor = 0;
+  u32 mHashed = 0;
+
+  std::vector<s32> mHead;
+  std::vector<s32> mPrev;
+
+  // Group being assembled: header byte, then up to eight tokens
+  std::vector<u8> mOut;
+  size_t mGroupHeaderPos = 0;
+  u32 mGroupTokens = 8;
+  u64 mWritten = 0;
+};
+
+} // namespace librii::szs
@@ -3,6 +3,7 @@
 #include <core/util/oishii.hpp>
 #include <core/util/timestamp.hpp>
 #include <fstream>
+#include <librii/sched/TaskScheduler.hpp>
 #include <rsl/SimpleReader.hpp>
 
 IMPORT_STD;
@@ -40,13 +41,6 @@ struct rvlArchiveNode {
 
 static_assert(sizeof(rvlArchiveNode) == 12);
 
-struct LowU8Archive {
-  rvlArchiveHeader header;
-  std::vector<rvlArchiveNode> nodes;
-  std::string strings;       // One giant string
-  std::vector<u8> file_data; // One giant buffer
-};
-
 #define rvlArchiveNodeIsFolder(node) ((node).packed_type_name & 0xff000000)
 #define rvlArchiveNodeGetName(node) ((node).packed_type_name & 0x00ffffff)
 
@@ -79,62 +73,88 @@ bool RangeContainsInclusive(std::span<const u8> range, const void* ptr) {
   return ptr >= range.data() && ptr <= range.data() + range.size();
 }
 
-Result<void> LoadU8Archive(LowU8Archive& result, std::span<const u8> data) {
-  if (!SafeMemCopy(result.header, data))
+Result<U8ArchiveView> LoadU8ArchiveView(std::span<const u8> data) {
+  U8ArchiveView result;
+
+  rvlArchiveHeader header;
+  if (!SafeMemCopy(header, data))
     return std::unexpected("Invalid header");
+  result.watermark = header.watermark;
 
   const auto* nodes = rvlArchiveHeaderGetNodes(
       reinterpret_cast<const rvlArchiveHeader*>(data.data()));
-  if (!RangeContains(data, nodes))
+  if (!RangeContains(data, nodes) || !RangeContainsInclusive(data, nodes + 1))
     return std::unexpected("Invalid nodes");
 
   const auto node_count = nodes[0].folder.sibling_next;
   if (!RangeContainsInclusive(data, nodes + node_count))
     return std::unexpected("Invalid root node");
 
-  result.nodes = {nodes, nodes + node_count};
-
   const char* strings = reinterpret_cast<const char*>(nodes + node_count);
   if (!RangeContains(data, strings))
     return std::unexpected("Invalid strings");
 
   const char* strings_end =
-      reinterpret_cast<const char*>(nodes) + result.header.nodes.size;
-  if (!RangeContainsInclusive(data, strings_end))
+      reinterpret_cast<const char*>(nodes) + header.nodes.size;
+  if (!RangeContainsInclusive(data, strings_end) || strings_end < strings)
     return std::unexpected("Invalid strings");
 
-  result.strings = {strings, strings_end};
-
   auto* fd_begin = rvlArchiveHeaderGetFileData(
       reinterpret_cast<const rvlArchiveHeader*>(data.data()));
-  if (!RangeContains(data, fd_begin))
+  if (!RangeContainsInclusive(data, fd_begin))
     return std::unexpected("Invalid file data buffer");
 
   // For some reason the FD pointer is actually just the start of the file
-  // fd_begin = data.data();
-  int fd_trans = fd_begin - data.data();
-
-  for (auto& node : result.nodes) {
-    if (!rvlArchiveNodeIsFolder(node)) {
-      node.file.offset = node.file.offset - fd_trans;
+  const u32 fd_trans = fd_begin - data.data();
+  result.file_data = data.subspan(fd_trans);
+
+  result.nodes.resize(node_count);
+  for (u32 i = 0; i < node_count; ++i) {
+    const auto& node = nodes[i];
+    auto& tmp = result.nodes[i];
+
+    const u32 name = rvlArchiveNodeGetName(node);
+    const auto strings_size = strings_end - strings;
+    const void* name_end =
+        name < strings_size
+            ? std::memchr(strings + name, '\0', strings_size - name)
+            : nullptr;
+    if (name_end == nullptr)
+      return std::unexpected(std::format("Invalid name of node {}", i));
+    tmp.name = {strings + name, static_cast<const char*>(name_end)};
+
+    tmp.is_folder = rvlArchiveNodeIsFolder(node);
+    if (tmp.is_folder) {
+      tmp.folder.parent = node.folder.parent;
+      tmp.folder.sibling_next = node.folder.sibling_next;
+      continue;
     }
+    const u32 offset = node.file.offset;
+    const u32 size = node.file.size;
+    if (offset < fd_trans || offset - fd_trans > result.file_data.size() ||
+        size > result.file_data.size() - (offset - fd_trans))
+      return std::unexpected(std::format("Invalid file data of node {}", i));
+    tmp.file.offset = offset - fd_trans;
+    tmp.file.size = size;
   }
 
-  result.file_data = {fd_begin, data.data() + data.size()};
+  return result;
+}
 
-  return {};
+std::span<const u8> U8ArchiveView::getFile(u32 entrynum) const {
+  if (entrynum >= nodes.size() || nodes[entrynum].is_folder)
+    return {};
+  const auto& file = nodes[entrynum].file;
+  return file_data.subspan(file.offset, file.size);
 }
 
-Result<U8Archive> LoadU8Archive(std::span<const u8> data) {
+U8Archive ToU8Archive(const U8ArchiveView& view) {
   U8Archive result;
-  LowU8Archive low;
-  TRY(LoadU8Archive(low, data));
-
-  result.watermark = low.header.watermark;
-  for (auto& node : low.nodes) {
-    U8Archive::Node tmp = {.is_folder = (bool)rvlArchiveNodeIsFolder(node),
-                           .name = low.strings.data() +
-                                   rvlArchiveNodeGetName(node)};
+  result.watermark = view.watermark;
+  result.nodes.reserve(view.nodes.size());
+  for (auto& node : view.nodes) {
+    U8Archive::Node tmp = {.is_folder = node.is_folder,
+                           .name = std::string(node.name)};
     if (tmp.is_folder) {
       tmp.folder.parent = node.folder.parent;
       tmp.folder.sibling_next = node.folder.sibling_next;
@@ -142,14 +162,16 @@ Result<U8Archive> LoadU8Archive(std::span<const u8> data) {
       tmp.file.offset = node.file.offset;
       tmp.file.size = node.file.size;
     }
-
     result.nodes.push_back(tmp);
   }
-
-  result.file_data = std::move(low.file_data);
+  result.file_data = {view.file_data.begin(), view.file_data.end()};
   return result;
 }
 
+Result<U8Archive> LoadU8Archive(std::span<const u8> data) {
+  return ToU8Archive(TRY(LoadU8ArchiveView(data)));
+}
+
 std::vector<u8> SaveU8Archive(const U8Archive& arc) {
   std::string strings;
   std::unordered_map<std::string, std::size_t> strings_map;
@@ -208,7 +230,8 @@ std::vector<u8> SaveU8Archive(const U8Archive& arc) {
 }
 inline bool __rxPathCompare(const char* lhs, const char* rhs) {
   while (rhs[0] != '\0') {
-    if (tolower(*lhs++) != tolower(*rhs++))
+    if (tolower(static_cast<unsigned char>(*lhs++)) !=
+        tolower(static_cast<unsigned char>(*rhs++)))
       return false;
   }
 
@@ -217,7 +240,9 @@ inline bool __rxPathCompare(const char* lhs, const char* rhs) {
 
   return false;
 }
-s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath) {
+template <typename TArchive>
+static s32 PathToEntrynumImpl(const TArchive& arc, const char* path,
+                              u32 currentPath) {
   s32 name_length;      // r7
   u32 it = currentPath; // r8
 
@@ -278,7 +303,8 @@ s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath) {
     while (it < arc.nodes[anchor].folder.sibling_next) {
       while (true) {
         if (arc.nodes[it].is_folder || !name_delimited_by_slash) {
-          auto name = arc.nodes[it].name;
+          // Null-terminated in both archive types
+          std::string_view name = arc.nodes[it].name;
           // Skip empty directories
           if (name == ".") {
             ++it;
@@ -286,7 +312,7 @@ s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath) {
           }
 
           // Advance to the next item in the path
-          if (__rxPathCompare(path, name.c_str())) {
+          if (__rxPathCompare(path, name.data())) {
             goto descend;
           }
         }
@@ -313,13 +339,230 @@ s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath) {
     path += name_length + 1;
   }
 }
+s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath) {
+  return PathToEntrynumImpl(arc, path, currentPath);
+}
+s32 PathToEntrynum(const U8ArchiveView& arc, const char* path,
+                   u32 currentPath) {
+  return PathToEntrynumImpl(arc, path, currentPath);
+}
+
+static u64 HashPath(std::string_view key) {
+  // FNV-1a
+  u64 hash = 0xcbf29ce484222325;
+  for (char c : key) {
+    hash = (hash ^ static_cast<u8>(c)) * 0x100000001b3;
+  }
+  return hash;
+}
 
-Result<void> Extract(const U8Archive& arc, std::filesystem::path out) {
+// Drop a leading "/" and "." components of |path| into |out|, lowercasing it
+// if |fold_case|.
+// Returns the normalized size, or std::nullopt for anything only
+// PathToEntrynum can resolve: "..", "//", trailing "/" or ".", or overlong
+// paths.
+static std::optional<std::size_t>
+NormalizePath(std::string_view path, std::span<char> out, bool fold_case) {
+  std::size_t size = 0;
+  std::size_t pos = 0;
+  while (pos <= path.size()) {
+    std::size_t end = path.find('/', pos);
+    if (end == std::string_view::npos)
+      end = path.size();
+    const auto part = path.substr(pos, end - pos);
+    const bool last = end == path.size();
+    if (part.empty()) {
+      // A leading "/" is the root. Anywhere else it restarts at the root only
+      // after the preceding folders were found, which only the walk can tell.
+      if (pos != 0)
+        return std::nullopt;
+    } else if (part == "..") {
+      return std::nullopt;
+    } else if (part == ".") {
+      if (last && pos != 0)
+        return std::nullopt;
+    } else {
+      if (size + 1 + part.size() > out.size())
+        return std::nullopt;
+      if (size != 0)
+        out[size++] = '/';
+      for (char c : part)
+        out[size++] = fold_case ? static_cast<char>(
+                                      tolower(static_cast<unsigned char>(c)))
+                                : c;
+    }
+    pos = end + 1;
+  }
+  return size;
+}
+
+template <typename TArchive>
+static void BuildPathIndex(PathIndex& index, const TArchive& arc) {
+  if (arc.nodes.empty())
+    return;
+
+  struct Folder {
+    u32 sibling_next;
+    std::size_t path_size;
+    bool reachable;
+  };
+  std::vector<Folder> stack{{arc.nodes[0].folder.sibling_next, 0, true}};
+  // PathToEntrynum only descends into the first folder of a given name
+  PathIndex folders;
+  std::string path;
+  index.insert("", 0);
+  for (u32 i = 1; i < arc.nodes.size() && !stack.empty(); ++i) {
+    while (!stack.empty() && i >= stack.back().sibling_next)
+      stack.pop_back();
+    if (stack.empty())
+      break;
+    path.resize(stack.back().path_size);
+
+    const auto& node = arc.nodes[i];
+    const bool reachable = stack.back().reachable;
+    std::string_view name = node.name;
+    if (name == ".") {
+      // Transparent to lookups: its children belong to the parent
+      if (node.is_folder)
+        stack.push_back({node.folder.sibling_next, path.size(), reachable});
+      continue;
+    }
+    if (!path.empty())
+      path += '/';
+    for (char c : name)
+      path += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+
+    if (reachable)
+      index.insert(path, static_cast<s32>(i));
+    if (node.is_folder) {
+      const bool first = reachable && folders.insert(path, static_cast<s32>(i));
+      stack.push_back({node.folder.sibling_next, path.size(), first});
+    }
+  }
+}
+
+PathIndex::PathIndex(const U8Archive& arc) { BuildPathIndex(*this, arc); }
+PathIndex::PathIndex(const U8ArchiveView& arc) { BuildPathIndex(*this, arc); }
+
+const PathIndex::Slot* PathIndex::findSlot(std::string_view key,
+                                           u64 hash) const {
+  if (mSlots.empty())
+    return nullptr;
+  const std::size_t mask = mSlots.size() - 1;
+  for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = mSlots[i];
+    if (slot.entrynum < 0)
+      return &slot;
+    if (slot.hash == hash &&
+        std::string_view(mKeys).substr(slot.key_offset, slot.key_size) == key)
+      return &slot;
+  }
+}
+
+void PathIndex::grow() {
+  std::vector<Slot> old(std::max<std::size_t>(mSlots.size() * 2, 16));
+  std::swap(old, mSlots);
+  const std::size_t mask = mSlots.size() - 1;
+  for (const Slot& slot : old) {
+    if (slot.entrynum < 0)
+      continue;
+    std::size_t i = slot.hash & mask;
+    while (mSlots[i].entrynum >= 0)
+      i = (i + 1) & mask;
+    mSlots[i] = slot;
+  }
+}
+
+bool PathIndex::insert(std::string_view path, s32 entrynum) {
+  assert(entrynum >= 0);
+  std::array<char, 256> buf;
+  auto size = NormalizePath(path, buf, mMatch == Match::FoldCase);
+  if (!size)
+    return false;
+  const std::string_view key(buf.data(), *size);
+
+  // Keep the load factor at or below 1/2
+  if ((mCount + 1) * 2 > mSlots.size())
+    grow();
+  const u64 hash = HashPath(key);
+  auto* slot = const_cast<Slot*>(findSlot(key, hash));
+  if (slot->entrynum >= 0)
+    return false;
+
+  *slot = {.hash = hash,
+           .key_offset = static_cast<u32>(mKeys.size()),
+           .key_size = static_cast<u32>(key.size()),
+           .entrynum = entrynum};
+  mKeys += key;
+  ++mCount;
+  return true;
+}
+
+std::optional<s32> PathIndex::find(std::string_view path) const {
+  std::array<char, 256> buf;
+  auto size = NormalizePath(path, buf, mMatch == Match::FoldCase);
+  if (!size)
+    return std::nullopt;
+  const std::string_view key(buf.data(), *size);
+  const auto* slot = findSlot(key, HashPath(key));
+  return slot != nullptr ? slot->entrynum : -1;
+}
+
+template <typename TArchive>
+static s32 PathToEntrynumIndexed(const TArchive& arc, const PathIndex& index,
+                                 const char* path, u32 currentPath) {
+  // Relative lookups depend on currentPath, which the index does not model
+  if (currentPath == 0 || path[0] == '/') {
+    if (auto entrynum = index.find(path))
+      return *entrynum;
+  }
+  return PathToEntrynumImpl(arc, path, currentPath);
+}
+s32 PathToEntrynum(const U8Archive& arc, const PathIndex& index,
+                   const char* path, u32 currentPath) {
+  return PathToEntrynumIndexed(arc, index, path, currentPath);
+}
+s32 PathToEntrynum(const U8ArchiveView& arc, const PathIndex& index,
+                   const char* path, u32 currentPath) {
+  return PathToEntrynumIndexed(arc, index, path, currentPath);
+}
+
+// Run job(i) for every i in [0, count) as tasks on |scheduler|. Filesystem
+// calls spend most of their time blocked, so this is worthwhile even for tiny
+// payloads. Returns the error of the lowest failing index so that reports do
+// not depend on scheduling.
+template <typename F>
+static Result<void> ParallelFor(u32 count, sched::TaskScheduler& scheduler,
+                                F&& job) {
+  std::vector<Result<void>> results(count);
+  sched::TaskGroup group;
+  for (u32 i = 0; i < count; ++i) {
+    scheduler.spawn(group, [&, i] { results[i] = job(i); });
+  }
+  scheduler.wait(group);
+
+  for (auto& result : results) {
+    TRY(result);
+  }
+  return {};
+}
+
+template <typename TArchive>
+static Result<void> ExtractImpl(const TArchive& arc, std::filesystem::path out,
+                                sched::TaskScheduler& scheduler) {
+  struct FileJob {
+    std::filesystem::path path;
+    std::span<const u8> data;
+  };
+  std::vector<std::filesystem::path> folders;
+  std::vector<FileJob> files;
+
+  const std::span<const u8> file_data = arc.file_data;
   auto tmp = out;
   std::vector<u32> stack;
   u32 i = 0;
   for (auto& node : arc.nodes) {
-    if (!stack.empty() && stack.back() == i) {
+    while (!stack.empty() && stack.back() == i) {
       stack.resize(stack.size() - 1);
       tmp = tmp.parent_path();
     }
@@ -327,67 +570,115 @@ Result<void> Extract(const U8Archive& arc, std::filesystem::path out) {
     if (node.is_folder) {
       stack.push_back(node.folder.sibling_next);
       tmp /= node.name;
-      std::filesystem::create_directory(tmp);
+      folders.push_back(tmp);
     } else {
-      auto fpath = (tmp / node.name).string();
-      std::ofstream out(fpath);
-      auto data = std::span(arc.file_data.begin(), arc.file_data.end())
-                      .subspan(node.file.offset, node.file.size);
-      EXPECT(data.size() == node.file.size);
-      out.write(reinterpret_cast<const char*>(data.data()), data.size());
+      EXPECT(node.file.offset <= file_data.size() &&
+             node.file.size <= file_data.size() - node.file.offset);
+      files.push_back(FileJob{
+          .path = tmp / node.name,
+          .data = file_data.subspan(node.file.offset, node.file.size),
+      });
     }
   }
-  return {};
+
+  // Parents always precede their children, so this is a single pass
+  for (auto& folder : folders) {
+    std::error_code ec;
+    std::filesystem::create_directory(folder, ec);
+    if (ec) {
+      return std::unexpected(std::format("Failed to create folder {}: {}",
+                                         folder.string(), ec.message()));
+    }
+  }
+
+  return ParallelFor(files.size(), scheduler, [&](u32 i) -> Result<void> {
+    auto& file = files[i];
+    std::ofstream stream(file.path, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(file.data.data()),
+                 file.data.size());
+    if (!stream) {
+      return std::unexpected(
+          std::format("Failed to write file {}", file.path.string()));
+    }
+    return {};
+  });
+}
+
+Result<void> Extract(const U8Archive& arc, std::filesystem::path out,
+                     sched::TaskScheduler& scheduler) {
+  return ExtractImpl(arc, out, scheduler);
+}
+Result<void> Extract(const U8ArchiveView& arc, std::filesystem::path out,
+                     sched::TaskScheduler& scheduler) {
+  return ExtractImpl(arc, out, scheduler);
+}
+Result<void> Extract(const U8Archive& arc, std::filesystem::path out) {
+  return ExtractImpl(arc, out, sched::TaskScheduler::shared());
+}
+Result<void> Extract(const U8ArchiveView& arc, std::filesystem::path out) {
+  return ExtractImpl(arc, out, sched::TaskScheduler::shared());
+}
+
+Result<U8Archive> Create(std::filesystem::path root) {
+  return Create(root, sched::TaskScheduler::shared());
 }
 
 // Insertion into a sorted list would be O(n^2) on a vector structure; a heap or
 // tree structure is probably not meritful. Instead, simply use std::sort
 // (O(nlgn)) to get files in the proper order and then iterate through them.
-Result<U8Archive> Create(std::filesystem::path root) {
+Result<U8Archive> Create(std::filesystem::path root,
+                         sched::TaskScheduler& scheduler) {
   struct Entry {
+    std::filesystem::path rel;
     std::string str;
     bool is_folder = false;
 
-    std::vector<u8> data;
+    std::filesystem::path source;
+    u64 size = 0;
+    u32 offset = 0; // Into U8Archive::file_data
     std::string name;
 
     int depth = -1;
     int parent = 0; // Default files put parent as 0 for root
     int nextAtGreaterDepth = -1;
 
-    bool operator<(const Entry& rhs) const {
-      return str < rhs.str && (is_folder ? 1 : 0) < (rhs.is_folder ? 1 : 0);
-    }
+    // Element-wise, so every folder is directly followed by its contents
+    bool operator<(const Entry& rhs) const { return rel < rhs.rel; }
   };
   std::vector<Entry> paths{{
+      .rel = ".",
       .str = ".",
       .is_folder = true,
   }};
   for (auto&& it : std::filesystem::recursive_directory_iterator{root}) {
     auto path = it.path();
-    bool folder = std::filesystem::is_directory(path);
+    bool folder = it.is_directory();
     if (path.filename() == ".DS_Store") {
       continue;
     }
-    std::vector<u8> data;
+    // Only stat here; the contents are read in parallel below
+    u64 size = 0;
     if (!folder) {
-      auto f = ReadFile(path.string());
-      if (!f) {
+      std::error_code ec;
+      size = it.file_size(ec);
+      if (ec) {
         return std::unexpected(
             std::format("Failed to read file {}", path.string()));
       }
-      data = *f;
     }
-    path = std::filesystem::path(".") / std::filesystem::relative(path, root);
+    auto rel =
+        std::filesystem::path(".") / std::filesystem::relative(path, root);
 
     paths.push_back(Entry{
-        .str = path.string(),
+        .rel = rel,
+        .str = rel.string(),
         .is_folder = folder,
-        .data = data,
-        .name = path.filename().string(),
+        .source = path,
+        .size = size,
+        .name = rel.filename().string(),
     });
   }
-  // They are almost certainly already in sorted order
+  // directory_iterator order is unspecified
   std::sort(paths.begin(), paths.end());
   for (auto& p : paths) {
     for (auto c : p.str) {
@@ -400,7 +691,8 @@ Result<U8Archive> Create(std::filesystem::path root) {
   for (size_t i = 0; i < paths.size(); ++i) {
     auto& p = paths[i];
     if (p.is_folder) {
-      for (int j = i; i < paths.size(); ++j) {
+      p.nextAtGreaterDepth = paths.size();
+      for (size_t j = i + 1; j < paths.size(); ++j) {
         if (paths[j].depth <= p.depth) {
           p.nextAtGreaterDepth = j;
           break;
@@ -419,13 +711,35 @@ Result<U8Archive> Create(std::filesystem::path root) {
   static_assert(result.watermark.size() == watermark.size());
   memcpy(result.watermark.data(), watermark.data(), result.watermark.size());
 
-  u32 size = 0;
-  for (auto&p:paths) {
-    size += p.data.size();
+  // Lay out file data in node order so the output does not depend on which
+  // read finishes first
+  u64 size = 0;
+  std::vector<u32> files;
+  for (u32 i = 0; i < paths.size(); ++i) {
+    auto& p = paths[i];
+    if (p.is_folder)
+      continue;
+    p.offset = size;
+    size += p.size;
+    if (size > std::numeric_limits<u32>::max()) {
+      return std::unexpected("Archive would exceed 4 GiB");
+    }
+    files.push_back(i);
   }
   result.file_data.resize(size);
 
-  u32 i = 0;
+  TRY(ParallelFor(files.size(), scheduler, [&](u32 i) -> Result<void> {
+    auto& p = paths[files[i]];
+    std::ifstream stream(p.source, std::ios::binary);
+    stream.read(reinterpret_cast<char*>(result.file_data.data() + p.offset),
+                p.size);
+    if (!stream || static_cast<u64>(stream.gcount()) != p.size) {
+      return std::unexpected(
+          std::format("Failed to read file {}", p.source.string()));
+    }
+    return {};
+  }));
+
   for (auto& p : paths) {
     U8Archive::Node node;
     node.is_folder = p.is_folder;
@@ -434,10 +748,8 @@ Result<U8Archive> Create(std::filesystem::path root) {
       node.folder.parent = p.parent;
       node.folder.sibling_next = p.nextAtGreaterDepth;
     } else {
-      node.file.offset = result.file_data.size();
-      node.file.size = p.data.size();
-      memcpy(result.file_data.data() + i, p.data.data(), p.data.size());
-      i += p.data.size();
+      node.file.offset = p.offset;
+      node.file.size = p.size;
     }
     result.nodes.push_back(node);
   }
@@ -2,10 +2,16 @@
 
 #include <array>
 #include <core/common.h>
+#include <optional>
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+namespace librii::sched {
+class TaskScheduler;
+}
+
 namespace librii::U8 {
 
 struct U8Archive {
@@ -29,6 +35,38 @@ struct U8Archive {
   std::vector<u8> file_data;
 };
 
+//! Read-only view of a U8 archive. Names and file contents borrow from the
+//! buffer passed to LoadU8ArchiveView, which must outlive the view.
+struct U8ArchiveView {
+  struct Node {
+    bool is_folder = false;
+    std::string_view name; //!< Null-terminated in the source buffer
+
+    union {
+      struct {
+        u32 offset; //!< Relative to file_data
+        u32 size;
+      } file;
+      struct {
+        u32 parent;
+        u32 sibling_next;
+      } folder;
+    };
+  };
+  std::array<u8, 16> watermark{};
+  std::vector<Node> nodes;
+  std::span<const u8> file_data;
+
+  //! Contents of a file node, or an empty span for folders/invalid entries.
+  std::span<const u8> getFile(u32 entrynum) const;
+};
+
+//! Parse the node table without copying any file data. All file ranges are
+//! validated against the buffer.
+Result<U8ArchiveView> LoadU8ArchiveView(std::span<const u8> data);
+//! Materialize an owning archive from a view.
+U8Archive ToU8Archive(const U8ArchiveView& view);
+
 Result<U8Archive> LoadU8Archive(std::span<const u8> data);
 std::vector<u8> SaveU8Archive(const U8Archive& arc);
 
@@ -36,8 +74,71 @@ std::vector<u8> SaveU8Archive(const U8Archive& arc);
 //!
 //! Highly accurate function to game behavior.
 s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath = 0);
+s32 PathToEntrynum(const U8ArchiveView& arc, const char* path,
+                   u32 currentPath = 0);
+
+//! Flat open-addressing hash from a normalized absolute path to a node index.
+//! "." components are ignored. Built from an archive, paths are matched
+//! case-insensitively so that lookups agree with PathToEntrynum.
+class PathIndex {
+public:
+  enum class Match {
+    FoldCase, //!< Compare names case-insensitively, as the game does
+    Exact,
+  };
+
+  explicit PathIndex(Match match = Match::FoldCase) : mMatch(match) {}
+  explicit PathIndex(const U8Archive& arc);
+  explicit PathIndex(const U8ArchiveView& arc);
+
+  //! Register a path (e.g. "Race/Course/course.kmp"). If the path is already
+  //! present, the earlier entry is kept.
+  //! @return Whether the path was newly inserted.
+  bool insert(std::string_view path, s32 entrynum);
+
+  //! @return The node of an absolute path, -1 if there is none, or
+  //! std::nullopt if the path uses ".." or a trailing "/" or "." and must be
+  //! resolved by PathToEntrynum instead.
+  std::optional<s32> find(std::string_view path) const;
+
+  std::size_t size() const { return mCount; }
+
+private:
+  struct Slot {
+    u64 hash = 0;
+    u32 key_offset = 0;
+    u32 key_size = 0;
+    s32 entrynum = -1; //!< -1 marks an empty slot
+  };
+
+  const Slot* findSlot(std::string_view key, u64 hash) const;
+  void grow();
+
+  Match mMatch = Match::FoldCase;
+  std::vector<Slot> mSlots;
+  std::string mKeys; //!< Normalized keys, back to back
+  std::size_t mCount = 0;
+};
+
+//! PathToEntrynum, answered from |index| whenever the path can be normalized.
+s32 PathToEntrynum(const U8Archive& arc, const PathIndex& index,
+                   const char* path, u32 currentPath = 0);
+s32 PathToEntrynum(const U8ArchiveView& arc, const PathIndex& index,
+                   const char* path, u32 currentPath = 0);
 
+//! Write every file in |arc| under |out|. Folders are created up front, then
+//! each file is written by a task on |scheduler| (TaskScheduler::shared() if
+//! omitted). Safe to call from a task on the same scheduler.
+Result<void> Extract(const U8Archive& arc, std::filesystem::path out,
+                     sched::TaskScheduler& scheduler);
+Result<void> Extract(const U8ArchiveView& arc, std::filesystem::path out,
+                     sched::TaskScheduler& scheduler);
 Result<void> Extract(const U8Archive& arc, std::filesystem::path out);
+Result<void> Extract(const U8ArchiveView& arc, std::filesystem::path out);
+//! Pack the folder |root|. Files are read concurrently into their final place
+//! in file_data; the result does not depend on scheduling.
+Result<U8Archive> Create(std::filesystem::path root,
+                         sched::TaskScheduler& scheduler);
 Result<U8Archive> Create(std::filesystem::path root);
 
 } // namespace librii::U8
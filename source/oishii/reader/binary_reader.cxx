@@ -176,15 +176,24 @@ void BinaryReader::warnAt(const char* msg, u32 selectBegin, u32 selectEnd,
 
 BinaryReader::BinaryReader(std::vector<u8>&& view, std::string_view path,
                            std::endian endian)
-    : VectorStream(std::move(view)), m_path(path), mFileEndian(endian) {}
+    : VectorStream(std::move(view)), mView(mBuf), mFileEndian(endian),
+      m_path(path) {}
 BinaryReader::BinaryReader(std::span<const u8> view, std::string_view path,
                            std::endian endian)
-    : VectorStream(std::vector<u8>{view.begin(), view.end()}), m_path(path),
-      mFileEndian(endian) {}
+    : VectorStream(std::vector<u8>{view.begin(), view.end()}), mView(mBuf),
+      mFileEndian(endian), m_path(path) {}
+BinaryReader::BinaryReader(ViewTag, std::span<const u8> view,
+                           std::string_view path, std::endian endian)
+    : mView(view), mFileEndian(endian), m_path(path) {}
 BinaryReader::~BinaryReader() = default;
 
 BinaryReader::BinaryReader(BinaryReader&&) = default;
 
+BinaryReader BinaryReader::ViewOf(const BinaryReader& reader) {
+  return BinaryReader(ViewTag{}, reader.slice(), reader.getFile(),
+                      reader.endian());
+}
+
 std::expected<BinaryReader, std::string>
 BinaryReader::FromFilePath(std::string_view path, std::endian endian) {
   std::ifstream file(std::string(path), std::ios::binary | std::ios::ate);
@@ -45,6 +45,10 @@ public:
   static Result<BinaryReader> FromFilePath(std::string_view path,
                                            std::endian endian);
 
+  //! Read the buffer of |reader| without copying it. Offsets are those of
+  //! |reader|, which must outlive the view.
+  static BinaryReader ViewOf(const BinaryReader& reader);
+
   // The |BinaryReader| keeps track of the files endianness
   std::endian endian() const { return mFileEndian; }
   void setEndian(std::endian endian) noexcept { mFileEndian = endian; }
@@ -53,7 +57,10 @@ public:
   const char* getFile() const noexcept { return m_path.c_str(); }
 
   //! Get a read-only view of the file
-  std::span<const u8> slice() const { return mBuf; }
+  std::span<const u8> slice() const { return mView; }
+
+  u32 endpos() const override { return static_cast<u32>(mView.size()); }
+  const u8* getStreamStart() const { return mView.data(); }
 
   //! Pop a value from the stream (of type |T|)
   template <typename T,                             //
@@ -144,7 +151,7 @@ public:
     }
     readerBpCheck(size, addr - tell());
     std::vector<T> out(size);
-    std::copy_n(mBuf.begin() + addr, size, out.begin());
+    std::copy_n(mView.begin() + addr, size, out.begin());
     return out;
   }
   template <typename T> auto tryReadBuffer(u32 size) -> Result<std::vector<T>> {
@@ -157,6 +164,12 @@ public:
   }
 
 private:
+  struct ViewTag {};
+  BinaryReader(ViewTag, std::span<const u8> view, std::string_view path,
+               std::endian endian);
+
+  // |mBuf| if owned, else the buffer of another reader
+  std::span<const u8> mView;
   std::endian mFileEndian = std::endian::big;
   std::string m_path = "Unknown Path";
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <bit>
+#include <cstring>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -184,6 +186,15 @@ public:
     return start;
   }
 
+  //! Copy |bytes| verbatim at the cursor, e.g. a block encoded separately.
+  void writeBytes(std::span<const u8> bytes) {
+    if (bytes.empty())
+      return;
+    const auto start = reserveNext(static_cast<s32>(bytes.size()));
+    std::memcpy(getDataBlockStart() + start, bytes.data(), bytes.size());
+    skip(static_cast<s32>(bytes.size()));
+  }
+
   void saveToDisk(std::string_view path) const { FlushFile(mBuf, path); }
 
 private:
@@ -23,26 +23,25 @@ namespace oishii {
 // Helpers
 class LinkerHelper {
 public:
-  static const Node* findNamespacedID(const Linker& linker,
-                                      const std::string& symbol,
-                                      const std::string& nameSpace,
-                                      const std::string& blockName,
-                                      std::string& resultName) {
-    // TODO: This can be optimized, no need to check two constructed strings
+  static const Linker::MapEntry* findSymbol(const Linker& linker,
+                                            std::string_view symbol) {
+    const auto it = linker.mSymbolIndex.find(symbol);
+    return it != linker.mSymbolIndex.end() ? &linker.mMap[it->second]
+                                           : nullptr;
+  }
+  static const Linker::MapEntry* findNode(const Linker& linker,
+                                          const Node* node) {
+    const auto it = linker.mNodeIndex.find(node);
+    return it != linker.mNodeIndex.end() ? &linker.mMap[it->second] : nullptr;
+  }
 
+  static const Linker::MapEntry*
+  findNamespacedID(const Linker& linker, const std::string& symbol,
+                   const std::string& nameSpace, const std::string& blockName) {
     // On same level
-    {
-      const std::string nameSpacedSymbol =
-          nameSpace.empty() ? symbol : nameSpace + "::" + symbol;
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) ==
-            nameSpacedSymbol) {
-          // if (resultName)
-          resultName = nameSpacedSymbol;
-          return entry.mNode.get();
-        }
+    if (const auto* entry = findSymbol(
+            linker, nameSpace.empty() ? symbol : nameSpace + "::" + symbol)) {
+      return entry;
     }
     // Children
     {
@@ -53,77 +52,58 @@ public:
       const std::string nameSpacedSymbol =
           nameSpacePrefix + (blockName.empty() ? "" : blockName + "::") +
           symbol;
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) ==
-            nameSpacedSymbol) {
-          // if (resultName)
-          resultName = nameSpacedSymbol;
-          return entry.mNode.get();
-        }
+      if (const auto* entry = findSymbol(linker, nameSpacedSymbol)) {
+        return entry;
+      }
     }
     // Global
-    {
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) == symbol) {
-          // if (resultName)
-          resultName = symbol;
-          return entry.mNode.get();
-        }
+    if (const auto* entry = findSymbol(linker, symbol)) {
+      return entry;
     }
     printf("Search for %s failed!\n", symbol.c_str());
     assert(!"Failed critical namespaced symbol lookup in layout");
     return nullptr;
   }
   // TODO: Offset might be better removed
-  static u32 resolveHook(const Linker& linker, const std::string& symbol,
+  static u32 resolveHook(const Linker& linker, const Linker::MapEntry* block,
                          Hook::RelativePosition pos, int offset = 0) {
-    std::string symbol_ = symbol;
-    // TODO: This can be much more optimized
-    if (pos == Hook::RelativePosition::EndOfChildren) {
-      if (!symbol_.empty())
-        symbol_ += "::";
-      symbol_ += "EndOfChildren";
+    const Linker::MapEntry* entry = block;
+    if (block != nullptr && pos == Hook::RelativePosition::EndOfChildren) {
+      entry = findSymbol(linker, block->symbol.empty()
+                                     ? "EndOfChildren"
+                                     : block->symbol + "::EndOfChildren");
     }
-    for (const auto& entry : linker.mMap) {
-      if (entry.symbol == symbol_) {
-        switch (pos) {
-        case Hook::RelativePosition::Begin:
-        case Hook::RelativePosition::EndOfChildren: // begin of marker node
-        {
-          auto roundDown = [](u32 in, u32 align) -> u32 {
-            return align ? in & ~(align - 1) : in;
-          };
-          auto roundUp = [roundDown](u32 in, u32 align) -> u32 {
-            return align ? roundDown(in + (align - 1), align) : in;
-          };
-          u32 x = entry.begin + offset;
-          // TODO: We don't need to make another pass from the start
-          u32 align = pos == Hook::RelativePosition::Begin
-                          ? entry.restrict.alignment
-                          : std::find_if(linker.mMap.begin(), linker.mMap.end(),
-                                         [symbol](auto& e) {
-                                           return e.symbol == symbol;
-                                         })
-                                ->restrict.alignment;
-          u32 rounded = roundUp(x, align);
-          return rounded;
-        }
-        case Hook::RelativePosition::End:
-          return entry.end + offset;
-        default:
-          printf("Linker Error: Unknown hook type %u -- assuming Begin (no "
-                 "align)\n",
-                 pos);
-          return entry.begin + offset;
-        }
-      }
+    if (entry == nullptr) {
+      printf("Linker Error: Cannot resolve symbol \"%s\"%s!\n",
+             block ? block->symbol.c_str() : "?",
+             pos == Hook::RelativePosition::EndOfChildren ? "::EndOfChildren"
+                                                          : "");
+      return 0xcccccccc;
+    }
+    switch (pos) {
+    case Hook::RelativePosition::Begin:
+    case Hook::RelativePosition::EndOfChildren: // begin of marker node
+    {
+      auto roundDown = [](u32 in, u32 align) -> u32 {
+        return align ? in & ~(align - 1) : in;
+      };
+      auto roundUp = [roundDown](u32 in, u32 align) -> u32 {
+        return align ? roundDown(in + (align - 1), align) : in;
+      };
+      u32 x = entry->begin + offset;
+      // The marker is aligned like the block it ends
+      u32 align = block->restrict.alignment;
+      u32 rounded = roundUp(x, align);
+      return rounded;
+    }
+    case Hook::RelativePosition::End:
+      return entry->end + offset;
+    default:
+      printf("Linker Error: Unknown hook type %u -- assuming Begin (no "
+             "align)\n",
+             pos);
+      return entry->begin + offset;
     }
-    printf("Linker Error: Cannot resolve symbol \"%s\"!\n", symbol_.c_str());
-    return 0xcccccccc;
   }
 };
 
@@ -156,6 +136,19 @@ void Linker::gather(std::unique_ptr<Node> pRoot,
   }
 }
 
+void Linker::buildSymbolTable() {
+  assert(mMap.size() == mLayout.size());
+  mSymbolIndex.clear();
+  mNodeIndex.clear();
+  mSymbolIndex.reserve(mMap.size());
+  mNodeIndex.reserve(mLayout.size());
+  for (std::size_t i = 0; i < mMap.size(); ++i) {
+    // Keep the first: lookups used to scan the layout front to back
+    mSymbolIndex.try_emplace(mMap[i].symbol, i);
+    mNodeIndex.try_emplace(mLayout[i].mNode.get(), i);
+  }
+}
+
 void Linker::shuffle() {
   // TODO: Shuffle and fix
   // TODO: Namespace type + allow ID and name different lookup
@@ -170,6 +163,7 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
   }
 
   // Write data
+  mMap.clear();
   for (const auto& entry : mLayout) {
     // align
     u32 alignment = entry.mNode->getLinkingRestriction().alignment;
@@ -207,7 +201,7 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
     }
   }
 
-  {
+  if (mPrintMap) {
     printf("Begin    End      Size     Align    Static Leaf  Symbol\n");
     for (const auto& entry : mMap) {
       printf("0x%06x 0x%06x 0x%06x 0x%06x %s  %s %s\n", (u32)entry.begin,
@@ -219,6 +213,7 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
   }
 
   // Resolve
+  buildSymbolTable();
 
   // TODO: map::ktpt::...::enpt is map::enpt
   for (const auto& reserve : writer.mLinkReservations) {
@@ -226,67 +221,36 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
     const u32 addr = static_cast<u32>(reserve.addr);
     const Link& link = reserve.mLink;
 
-    std::string fromBlockSymbol;
-    std::string toBlockSymbol;
-
     // #ifdef BUILD_DEBUG
     const std::string& nameSpace =
         reserve.nameSpace.empty() ? "" : reserve.nameSpace + "::";
 
     // Order: local -> children -> global
-
-    MAYBE_UNUSED const Node& from =
-        link.from.mBlock
-            ? *link.from.mBlock
-            : *LinkerHelper::findNamespacedID(*this, link.from.mId, nameSpace,
-                                              reserve.blockName,
-                                              fromBlockSymbol);
-    MAYBE_UNUSED const Node& to =
-        link.to.mBlock
-            ? *link.to.mBlock
-            : *LinkerHelper::findNamespacedID(*this, link.to.mId, nameSpace,
-                                              reserve.blockName, toBlockSymbol);
-    // #endif
-    //  TODO: Generalize all of these from/to methods
-    if (link.from.mBlock) {
-      bool bSuccess = false;
-      for (const auto& entry : mLayout) {
-        if (entry.mNode.get() == link.from.mBlock) {
-          fromBlockSymbol =
-              entry.mNamespace.empty()
-                  ? entry.mNode->getId()
-                  : entry.mNamespace + "::" + entry.mNode->getId();
-          bSuccess = true;
-          break;
-        }
+    const auto find_block = [&](const Hook& hook) -> const MapEntry* {
+      if (hook.mBlock == nullptr) {
+        return LinkerHelper::findNamespacedID(*this, hook.mId, nameSpace,
+                                              reserve.blockName);
       }
-      if (!bSuccess)
+      //  TODO: Generalize all of these from/to methods
+      const auto* entry = LinkerHelper::findNode(*this, hook.mBlock);
+      if (entry == nullptr) {
         printf("Linker Error: Block %s was never written to stream, so canot "
                "be resolved.\n",
-               link.from.mBlock->getId().c_str());
-    }
-    if (link.to.mBlock) {
-      bool bSuccess = false;
-      for (const auto& entry : mLayout) {
-        if (entry.mNode.get() == link.to.mBlock) {
-          toBlockSymbol = entry.mNamespace.empty()
-                              ? entry.mNode->getId()
-                              : entry.mNamespace + "::" + entry.mNode->getId();
-          bSuccess = true;
-          break;
-        }
+               hook.mBlock->getId().c_str());
+        return nullptr;
       }
-      if (!bSuccess)
-        printf("Linker Error: Block %s was never written to stream, so canot "
-               "be resolved.\n",
-               link.to.mBlock->getId().c_str());
-    }
+      // Blocks are resolved by symbol, like IDs
+      return LinkerHelper::findSymbol(*this, entry->symbol);
+    };
+    const MapEntry* fromBlock = find_block(link.from);
+    const MapEntry* toBlock = find_block(link.to);
+    // #endif
     // TODO: Link: EndOfChildren + put that in map + if not all children static
     // and in shuffle, supply random number
     const u32 fromAddr = LinkerHelper::resolveHook(
-        *this, fromBlockSymbol, link.from.mRelation, link.from.mOffset);
+        *this, fromBlock, link.from.mRelation, link.from.mOffset);
     const u32 toAddr = LinkerHelper::resolveHook(
-        *this, toBlockSymbol, link.to.mRelation, link.to.mOffset);
+        *this, toBlock, link.to.mRelation, link.to.mOffset);
 
     writer.seek<Whence::Set>(addr);
 
@@ -8,6 +8,9 @@
 
 #include <core/common.h>
 
+#include <string_view>
+#include <unordered_map>
+
 #include "../types.hxx"
 
 #include "hook.hxx"
@@ -58,6 +61,9 @@ public:
   using PadFunction = void (*)(char* dst, u32 size);
   PadFunction mUserPad = nullptr;
 
+  //! Print the final layout to stdout once written, for debugging.
+  bool mPrintMap = false;
+
 private:
   struct LayoutElement {
     std::unique_ptr<Node> mNode;
@@ -69,6 +75,16 @@ private:
 
   std::vector<LayoutElement> mLayout;
 
+  //! @brief Index the symbols of mMap, so links resolve by hash rather than
+  //! by scanning the layout. Called once the layout has been written.
+  //!
+  void buildSymbolTable();
+
+  //! First entry of mMap with each symbol; keys view MapEntry::symbol.
+  std::unordered_map<std::string_view, std::size_t> mSymbolIndex;
+  //! Entry of mMap written for each node.
+  std::unordered_map<const Node*, std::size_t> mNodeIndex;
+
 public:
   //! Associates namespaced IDs to writer positions.
   //!
@@ -38,47 +38,26 @@ std::span<const glm::vec3> Polygon::getNrm(const libcube::Model& mdl) const {
   return buf->mEntries;
 }
 
-template <typename X, typename Y>
-auto add_to_buffer(const X& entry, Y& buf) -> u16 {
-  const auto found = std::find(buf.mEntries.begin(), buf.mEntries.end(), entry);
-  if (found != buf.mEntries.end()) {
-    return found - buf.mEntries.begin();
-  }
-
-  buf.mEntries.push_back(entry);
-  return buf.mEntries.size() - 1;
-};
-
-u64 Polygon::addPos(libcube::Model& mdl, const glm::vec3& v) {
+std::vector<glm::vec3>* Polygon::getPosBuffer(libcube::Model& mdl) {
   auto* buf =
       reinterpret_cast<Model&>(mdl).getBuf_Pos().findByName(mPositionBuffer);
-  assert(buf);
-  return add_to_buffer(v, *buf);
+  return buf ? &buf->mEntries : nullptr;
 }
-u64 Polygon::addNrm(libcube::Model& mdl, const glm::vec3& v) {
+std::vector<glm::vec3>* Polygon::getNrmBuffer(libcube::Model& mdl) {
   auto* buf =
       reinterpret_cast<Model&>(mdl).getBuf_Nrm().findByName(mNormalBuffer);
-  assert(buf);
-  return add_to_buffer(v, *buf);
+  return buf ? &buf->mEntries : nullptr;
 }
-u64 Polygon::addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) {
+std::vector<librii::gx::Color>* Polygon::getClrBuffer(libcube::Model& mdl,
+                                                      u64 chan) {
   auto* buf =
       reinterpret_cast<Model&>(mdl).getBuf_Clr().findByName(mColorBuffer[chan]);
-  assert(buf);
-
-  librii::gx::ColorF32 fclr;
-  fclr.r = v[0];
-  fclr.g = v[1];
-  fclr.b = v[2];
-  fclr.a = v[3];
-  librii::gx::Color c = fclr;
-  return add_to_buffer(c, *buf);
+  return buf ? &buf->mEntries : nullptr;
 }
-u64 Polygon::addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) {
+std::vector<glm::vec2>* Polygon::getUvBuffer(libcube::Model& mdl, u64 chan) {
   auto* buf = reinterpret_cast<Model&>(mdl).getBuf_Uv().findByName(
       mTexCoordBuffer[chan]);
-  assert(buf);
-  return add_to_buffer(v, *buf);
+  return buf ? &buf->mEntries : nullptr;
 }
 
 glm::mat4 computeBoneMdl(u32 id, kpi::ConstCollectionRange<lib3d::Bone> bones) {
@@ -78,12 +78,13 @@ static Result<void> processModel(librii::g3d::Model& binary_model,
 void ReadBRRES(Collection& collection, oishii::BinaryReader& reader,
                kpi::LightIOTransaction& transaction) {
   librii::g3d::BinaryArchive bin;
-  if (auto r = bin.read(reader, transaction); !r) {
+  if (auto r = bin.read(reader, transaction, /* parallel */ true); !r) {
     transaction.callback(kpi::IOMessageClass::Error, "BRRES", r.error());
     transaction.state = kpi::TransactionState::Failure;
     return;
   }
-  auto archive_ = librii::g3d::Archive::from(bin, transaction);
+  auto archive_ =
+      librii::g3d::Archive::from(bin, transaction, /* parallel */ true);
   if (!archive_) {
     transaction.callback(kpi::IOMessageClass::Error, "BRRES", archive_.error());
     transaction.state = kpi::TransactionState::Failure;
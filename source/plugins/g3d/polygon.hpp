@@ -30,10 +30,11 @@ struct Polygon : public librii::g3d::PolygonData,
                                             u64 chan) const override;
   std::span<const glm::vec3> getPos(const libcube::Model& mdl) const override;
   std::span<const glm::vec3> getNrm(const libcube::Model& mdl) const override;
-  u64 addPos(libcube::Model& mdl, const glm::vec3& v) override;
-  u64 addNrm(libcube::Model& mdl, const glm::vec3& v) override;
-  u64 addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) override;
-  u64 addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) override;
+  std::vector<glm::vec3>* getPosBuffer(libcube::Model& mdl) override;
+  std::vector<glm::vec3>* getNrmBuffer(libcube::Model& mdl) override;
+  std::vector<librii::gx::Color>* getClrBuffer(libcube::Model& mdl,
+                                               u64 chan) override;
+  std::vector<glm::vec2>* getUvBuffer(libcube::Model& mdl, u64 chan) override;
 
   void init(bool skinned, librii::math::AABB* boundingBox) override {
     // TODO: Handle skinning...
@@ -202,4 +202,62 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
       static_cast<u32>(out.mIndices.size()) - vertex_indices.start;
   return vertex_indices;
 }
+
+u16 VertexBufferPool::Mesh::addPos(const glm::vec3& v) {
+  assert(mPos.entries);
+  return mPos.index->add(*mPos.entries, v);
+}
+u16 VertexBufferPool::Mesh::addNrm(const glm::vec3& v) {
+  assert(mNrm.entries);
+  return mNrm.index->add(*mNrm.entries, v);
+}
+u16 VertexBufferPool::Mesh::addClr(u64 chan, const glm::vec4& v) {
+  auto& slot = mClr[chan];
+  assert(slot.entries);
+
+  gx::ColorF32 fclr;
+  fclr.r = v[0];
+  fclr.g = v[1];
+  fclr.b = v[2];
+  fclr.a = v[3];
+  gx::Color c = fclr;
+  return slot.index->add(*slot.entries, c);
+}
+u16 VertexBufferPool::Mesh::addUv(u64 chan, const glm::vec2& v) {
+  auto& slot = mUv[chan];
+  assert(slot.entries);
+  return slot.index->add(*slot.entries, v);
+}
+
+VertexBufferPool::Mesh VertexBufferPool::forMesh(IndexedPolygon& poly,
+                                                 Model& mdl) {
+  const auto& vcd = poly.getMeshData().mVertexDescriptor;
+  const auto resolve = [](auto& slot, auto* entries, auto& indices) {
+    slot.entries = entries;
+    if (entries) {
+      slot.index = &indices[entries];
+    }
+  };
+  Mesh mesh;
+  if (vcd[gx::VertexAttribute::Position]) {
+    resolve(mesh.mPos, poly.getPosBuffer(mdl), mVec3);
+  }
+  if (vcd[gx::VertexAttribute::Normal]) {
+    resolve(mesh.mNrm, poly.getNrmBuffer(mdl), mVec3);
+  }
+  for (size_t i = 0; i < mesh.mClr.size(); ++i) {
+    if (vcd[static_cast<gx::VertexAttribute>(
+            static_cast<int>(gx::VertexAttribute::Color0) + i)]) {
+      resolve(mesh.mClr[i], poly.getClrBuffer(mdl, i), mColor);
+    }
+  }
+  for (size_t i = 0; i < mesh.mUv.size(); ++i) {
+    if (vcd[static_cast<gx::VertexAttribute>(
+            static_cast<int>(gx::VertexAttribute::TexCoord0) + i)]) {
+      resolve(mesh.mUv[i], poly.getUvBuffer(mdl, i), mVec2);
+    }
+  }
+  return mesh;
+}
+
 } // namespace libcube
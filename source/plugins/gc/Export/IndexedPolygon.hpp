@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bit>
 #include <core/3d/i3dmodel.hpp>
 #include <core/common.h>
 #include <librii/gx.h>
@@ -22,10 +23,13 @@ struct IndexedPolygon : public riistudio::lib3d::Polygon {
   virtual std::span<const glm::vec2> getUv(const Model& mdl,
                                            u64 chan) const = 0;
 
-  virtual u64 addPos(libcube::Model& mdl, const glm::vec3& v) = 0;
-  virtual u64 addNrm(libcube::Model& mdl, const glm::vec3& v) = 0;
-  virtual u64 addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) = 0;
-  virtual u64 addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) = 0;
+  //! The buffers new vertices are appended to, or null if missing. Append
+  //! through a VertexBufferPool, which reuses equal entries.
+  virtual std::vector<glm::vec3>* getPosBuffer(Model& mdl) = 0;
+  virtual std::vector<glm::vec3>* getNrmBuffer(Model& mdl) = 0;
+  virtual std::vector<librii::gx::Color>* getClrBuffer(Model& mdl,
+                                                       u64 chan) = 0;
+  virtual std::vector<glm::vec2>* getUvBuffer(Model& mdl, u64 chan) = 0;
 
   void update() override {
     // Split up added primitives if necessary
@@ -44,6 +48,118 @@ struct IndexedPolygon : public riistudio::lib3d::Polygon {
   virtual void setCurMtx(s32 mtx) {}
 };
 
+//! @brief Hash index of a vertex buffer's entries.
+//!
+//! add() returns the index of the first entry equal to a value, appending the
+//! value if there is none, as a linear search would. Entries appended by
+//! other code are indexed on the next call; if the buffer shrank, the index
+//! is rebuilt. Entries edited in place are not noticed, so an index should
+//! only live as long as one compilation.
+template <typename T, typename Hash> class VertexBufferIndex {
+public:
+  u16 add(std::vector<T>& entries, const T& value) {
+    sync(entries);
+    if (!Hash::Indexable(value)) {
+      // NaN equals nothing, so a linear search would append it too
+      entries.push_back(value);
+      ++mIndexed;
+      return static_cast<u16>(entries.size() - 1);
+    }
+    auto [it, added] =
+        mIndex.try_emplace(value, static_cast<u16>(entries.size()));
+    if (added) {
+      entries.push_back(value);
+      ++mIndexed;
+    }
+    return it->second;
+  }
+
+private:
+  void sync(const std::vector<T>& entries) {
+    if (entries.size() < mIndexed) {
+      mIndex.clear();
+      mIndexed = 0;
+    }
+    for (; mIndexed < entries.size(); ++mIndexed) {
+      if (Hash::Indexable(entries[mIndexed])) {
+        mIndex.try_emplace(entries[mIndexed], static_cast<u16>(mIndexed));
+      }
+    }
+  }
+
+  std::unordered_map<T, u16, Hash> mIndex;
+  size_t mIndexed = 0;
+};
+
+struct VertexVecHash {
+  template <glm::length_t L>
+  static bool Indexable(const glm::vec<L, float>& v) {
+    return !glm::any(glm::isnan(v));
+  }
+  template <glm::length_t L>
+  size_t operator()(const glm::vec<L, float>& v) const {
+    u64 h = 0xcbf2'9ce4'8422'2325;
+    for (glm::length_t i = 0; i < L; ++i) {
+      // -0 and 0 compare equal, so must hash equal
+      h = (h ^ std::bit_cast<u32>(v[i] + 0.0f)) * 0x100'0000'01b3;
+    }
+    return h;
+  }
+};
+
+struct VertexColorHash {
+  static bool Indexable(const librii::gx::Color&) { return true; }
+  size_t operator()(const librii::gx::Color& c) const {
+    u64 h = 0xcbf2'9ce4'8422'2325;
+    for (u32 x : {c.r, c.g, c.b, c.a}) {
+      h = (h ^ x) * 0x100'0000'01b3;
+    }
+    return h;
+  }
+};
+
+//! @brief Hash indices of a model's vertex buffers, for the length of one
+//! compilation.
+//!
+//! Buffers are identified by address, and may be shared between meshes.
+//!
+class VertexBufferPool {
+public:
+  //! @brief A mesh's buffers, looked up once, with their indices.
+  //!
+  class Mesh {
+  public:
+    u16 addPos(const glm::vec3& v);
+    u16 addNrm(const glm::vec3& v);
+    u16 addClr(u64 chan, const glm::vec4& v);
+    u16 addUv(u64 chan, const glm::vec2& v);
+
+  private:
+    friend class VertexBufferPool;
+    template <typename T, typename Hash> struct Slot {
+      std::vector<T>* entries = nullptr;
+      VertexBufferIndex<T, Hash>* index = nullptr;
+    };
+    Slot<glm::vec3, VertexVecHash> mPos;
+    Slot<glm::vec3, VertexVecHash> mNrm;
+    std::array<Slot<librii::gx::Color, VertexColorHash>, 2> mClr;
+    std::array<Slot<glm::vec2, VertexVecHash>, 8> mUv;
+  };
+
+  //! @brief Resolve the buffers of |poly|'s enabled attributes.
+  //!
+  Mesh forMesh(IndexedPolygon& poly, Model& mdl);
+
+private:
+  template <typename T, typename Hash>
+  using IndexMap =
+      std::unordered_map<const std::vector<T>*, VertexBufferIndex<T, Hash>>;
+
+  IndexMap<glm::vec3, VertexVecHash> mVec3;
+  IndexMap<glm::vec2, VertexVecHash> mVec2;
+  IndexMap<librii::gx::Color, VertexColorHash> mColor;
+};
+
 template <typename T> struct SafeIndexer {
   SafeIndexer() = default;
   SafeIndexer(std::span<T> s) : span(s) {}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <core/3d/i3dmodel.hpp>
 #include <librii/gx/Texture.hpp>
+#include <librii/image/FormatAnalyzer.hpp>
 #include <librii/image/ImagePlatform.hpp>
 #include <string_view>
 
@@ -15,26 +16,24 @@ struct Texture : public riistudio::lib3d::Texture {
     return librii::gx::computeImageSize(
         getWidth(), getHeight(), getTextureFormat(), mip ? getImageCount() : 0);
   }
-  Result<void> decode(std::vector<u8>& out, bool mip) const override {
-    u32 size = getDecodedSize(mip);
+  Result<void> decodeInto(std::span<u8> out, bool mip) const override {
+    const u32 size = getDecodedSize(mip);
     if (size == 0)
       return std::unexpected("Decoded size is 0");
-    size = std::max(size, u32(1024 * 1024 * 4));
-    // assert(size);
+    if (out.size() < size)
+      return std::unexpected("Decode target is too small");
 
-    if (out.size() < size) {
-      out.resize(size);
-    }
-
-    if (librii::gx::IsPaletteFormat(getTextureFormat())) {
-      // Palettes not supported
-      return std::unexpected("CI formats are unsupported");
+    if (librii::gx::IsPaletteFormat(getTextureFormat()) &&
+        getPaletteData() == nullptr) {
+      return std::unexpected("CI texture has no palette");
     }
 
     return librii::image::transform(
         out, getWidth(), getHeight(), getTextureFormat(),
         librii::gx::TextureFormat::Extension_RawRGBA32, getData(), getWidth(),
-        getHeight(), mip ? getMipmapCount() : 0);
+        getHeight(), mip ? getMipmapCount() : 0,
+        librii::image::ResizingAlgorithm::Lanczos, getPaletteData(),
+        static_cast<librii::gx::PaletteFormat>(getPaletteFormat()));
   }
 
   virtual librii::gx::TextureFormat getTextureFormat() const = 0;
@@ -55,8 +54,45 @@ struct Texture : public riistudio::lib3d::Texture {
   //!
   void setEncoder(bool optimizeForSize, bool color,
                   Occlusion occlusion) override {
-    // TODO
-    setTextureFormat(librii::gx::TextureFormat::CMPR);
+    using librii::gx::TextureFormat;
+    if (!color) {
+      // Intensity formats replicate I into alpha
+      if (occlusion == Occlusion::Opaque) {
+        setTextureFormat(optimizeForSize ? TextureFormat::I4
+                                         : TextureFormat::I8);
+      } else {
+        setTextureFormat(optimizeForSize ? TextureFormat::IA4
+                                         : TextureFormat::IA8);
+      }
+      return;
+    }
+    switch (occlusion) {
+    case Occlusion::Opaque:
+      setTextureFormat(optimizeForSize ? TextureFormat::CMPR
+                                       : TextureFormat::RGB565);
+      break;
+    case Occlusion::Stencil:
+      // CMPR has 1-bit alpha
+      setTextureFormat(optimizeForSize ? TextureFormat::CMPR
+                                       : TextureFormat::RGB5A3);
+      break;
+    case Occlusion::Translucent:
+      setTextureFormat(optimizeForSize ? TextureFormat::RGB5A3
+                                       : TextureFormat::RGBA8);
+      break;
+    }
+  }
+
+  //! @brief Set the image encoder to the smallest format that represents
+  //! |rawRGBA| well. Pixels are not recomputed immediately.
+  //!
+  //! @param[in] rawRGBA  Base level as RGBA32, sized width * height * 4.
+  //! @param[in] min_psnr Least acceptable quality, in dB.
+  //!
+  void setEncoderFor(std::span<const u8> rawRGBA, float min_psnr = 36.0f) {
+    setTextureFormat(librii::image::ChooseTextureFormat(
+        rawRGBA, getWidth(), getHeight(),
+        {.min_psnr = min_psnr, .allow_palette = false}));
   }
 
   //! @brief Encode the texture based on the current encoder, width, height,
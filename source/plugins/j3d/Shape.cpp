@@ -29,35 +29,18 @@ std::span<const librii::gx::Color> Shape::getClr(const libcube::Model& mdl,
   return mMdl.mBufs.color[chan].mData;
 }
 
-template <typename X, typename Y>
-auto add_to_buffer(const X& entry, Y& buf) -> u16 {
-  const auto found = std::find(buf.begin(), buf.end(), entry);
-  if (found != buf.end()) {
-    return found - buf.begin();
-  }
-
-  buf.push_back(entry);
-  return buf.size() - 1;
-};
-
-u64 Shape::addPos(libcube::Model& mdl, const glm::vec3& v) {
-  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.pos.mData);
+std::vector<glm::vec3>* Shape::getPosBuffer(libcube::Model& mdl) {
+  return &reinterpret_cast<Model&>(mdl).mBufs.pos.mData;
 }
-u64 Shape::addNrm(libcube::Model& mdl, const glm::vec3& v) {
-  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.norm.mData);
+std::vector<glm::vec3>* Shape::getNrmBuffer(libcube::Model& mdl) {
+  return &reinterpret_cast<Model&>(mdl).mBufs.norm.mData;
 }
-u64 Shape::addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) {
-  librii::gx::ColorF32 fclr;
-  fclr.r = v[0];
-  fclr.g = v[1];
-  fclr.b = v[2];
-  fclr.a = v[3];
-  librii::gx::Color c = fclr;
-  return add_to_buffer(c,
-                       reinterpret_cast<Model&>(mdl).mBufs.color[chan].mData);
+std::vector<librii::gx::Color>* Shape::getClrBuffer(libcube::Model& mdl,
+                                                    u64 chan) {
+  return &reinterpret_cast<Model&>(mdl).mBufs.color[chan].mData;
 }
-u64 Shape::addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) {
-  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.uv[chan].mData);
+std::vector<glm::vec2>* Shape::getUvBuffer(libcube::Model& mdl, u64 chan) {
+  return &reinterpret_cast<Model&>(mdl).mBufs.uv[chan].mData;
 }
 
 glm::mat4 computeBoneMdl(u32 id, kpi::ConstCollectionRange<lib3d::Bone> bones) {
@@ -8,7 +8,9 @@
 #include <librii/hx/PixMode.hpp>
 #include <librii/hx/TextureFilter.hpp>
 #include <librii/image/CheckerBoard.hpp>
+#include <librii/image/FormatAnalyzer.hpp>
 #include <librii/rhst/RHST.hpp>
+#include <librii/sched/TaskScheduler.hpp>
 
 #include <oishii/reader/binary_reader.hxx>
 
@@ -19,8 +21,6 @@
 #include <rsl/FsDialog.hpp>
 #include <rsl/Stb.hpp>
 
-#include <future>
-
 // XXX: Hack, though we'll refactor all of this way soon
 std::string rebuild_dest;
 
@@ -185,7 +185,7 @@ void compileBone(libcube::IBoneDelegate& out, const librii::rhst::Bone& in) {
 
 void compileVert(librii::gx::IndexedVertex& dst,
                  const librii::rhst::Vertex& src, libcube::IndexedPolygon& poly,
-                 libcube::Model& mdl) {
+                 libcube::VertexBufferPool::Mesh& bufs) {
   u32 vcd_cursor = 0;
 
   auto& data = poly.getMeshData();
@@ -208,25 +208,24 @@ void compileVert(librii::gx::IndexedVertex& dst,
       continue;
     }
     if (cur_attr == 9) {
-      dst[librii::gx::VertexAttribute::Position] =
-          poly.addPos(mdl, src.position);
+      dst[librii::gx::VertexAttribute::Position] = bufs.addPos(src.position);
       continue;
     }
     if (cur_attr == 10) {
-      dst[librii::gx::VertexAttribute::Normal] = poly.addNrm(mdl, src.normal);
+      dst[librii::gx::VertexAttribute::Normal] = bufs.addNrm(src.normal);
       continue;
     }
 
     if (cur_attr >= 11 && cur_attr <= 12) {
       const int color_index = cur_attr - 11;
       dst[(librii::gx::VertexAttribute)cur_attr] =
-          poly.addClr(mdl, color_index, src.colors[color_index]);
+          bufs.addClr(color_index, src.colors[color_index]);
       continue;
     }
     if (cur_attr >= 13 && cur_attr <= 20) {
       const int uv_index = cur_attr - 13;
       dst[(librii::gx::VertexAttribute)cur_attr] =
-          poly.addUv(mdl, uv_index, src.uvs[uv_index]);
+          bufs.addUv(uv_index, src.uvs[uv_index]);
       continue;
     }
   }
@@ -234,7 +233,8 @@ void compileVert(librii::gx::IndexedVertex& dst,
 
 void compilePrim(librii::gx::IndexedPrimitive& dst,
                  const librii::rhst::Primitive& src,
-                 libcube::IndexedPolygon& poly, libcube::Model& model) {
+                 libcube::IndexedPolygon& poly,
+                 libcube::VertexBufferPool::Mesh& bufs) {
   switch (src.topology) {
   case librii::rhst::Topology::Triangles:
     dst.mType = librii::gx::PrimitiveType::Triangles;
@@ -249,15 +249,15 @@ void compilePrim(librii::gx::IndexedPrimitive& dst,
 
   dst.mVertices.reserve(src.vertices.size());
   for (auto& vert : src.vertices) {
-    compileVert(dst.mVertices.emplace_back(), vert, poly, model);
+    compileVert(dst.mVertices.emplace_back(), vert, poly, bufs);
   }
 }
 
 [[nodiscard]] Result<void>
 compileMatrixPrim(librii::gx::MatrixPrimitive& dst,
                   const librii::rhst::MatrixPrimitive& src, s32 current_matrix,
-                  libcube::IndexedPolygon& poly, libcube::Model& model,
-                  bool optimize) {
+                  libcube::IndexedPolygon& poly,
+                  libcube::VertexBufferPool::Mesh& bufs, bool optimize) {
   dst.mCurrentMatrix = current_matrix;
   std::array<s32, 10> empty{
       -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
@@ -286,7 +286,7 @@ compileMatrixPrim(librii::gx::MatrixPrimitive& dst,
   }
 
   for (auto& prim : tmp.primitives) {
-    compilePrim(dst.mPrimitives.emplace_back(), prim, poly, model);
+    compilePrim(dst.mPrimitives.emplace_back(), prim, poly, bufs);
   }
 
   return {};
@@ -399,7 +399,8 @@ Result<librii::rhst::Mesh> decompileMesh(const libcube::IndexedPolygon& src,
 
 Result<void> compileMesh(libcube::IndexedPolygon& dst,
                          const librii::rhst::Mesh& src, libcube::Model& model,
-                         bool optimize, bool reinit_bufs) {
+                         bool optimize, bool reinit_bufs,
+                         libcube::VertexBufferPool* pool) {
   dst.setName(src.name);
 
   // No skinning/BB
@@ -430,9 +431,11 @@ Result<void> compileMesh(libcube::IndexedPolygon& dst,
     dst.setCurMtx(src.current_matrix);
   }
 
+  libcube::VertexBufferPool local_pool;
+  auto bufs = (pool ? *pool : local_pool).forMesh(dst, model);
   for (auto& matrix_prim : src.matrix_primitives) {
     TRY(compileMatrixPrim(data.mMatrixPrimitives.emplace_back(), matrix_prim,
-                          src.current_matrix, dst, model, optimize));
+                          src.current_matrix, dst, bufs, optimize));
   }
 
   for (auto& [attr, format] : data.mVertexDescriptor.mAttributes) {
@@ -465,45 +468,29 @@ static inline std::string getFileShort(const std::string& path) {
   return tmp;
 }
 Result<void> importTextureImpl(libcube::Texture& data, std::span<u8> image,
-                               std::vector<u8>& scratch, int num_mip, int width,
-                               int height, int source_w, int source_h,
+                               int num_mip, int width, int height,
+                               int source_w, int source_h,
                                librii::gx::TextureFormat fmt,
-                               librii::image::ResizingAlgorithm resize) {
+                               librii::image::ResizingAlgorithm resize,
+                               librii::image::MipGenOptions mip_options,
+                               librii::image::CmprQuality cmpr_quality) {
   data.setTextureFormat(fmt);
   data.setWidth(width);
   data.setHeight(height);
   data.setMipmapCount(num_mip);
   data.setLod(false, 0.0f, static_cast<f32>(data.getImageCount()));
   data.resizeData();
-  if (num_mip == 0) {
-    std::vector<u8> scratch(4 * width * height);
-    librii::image::resize(scratch, width, height, image, source_w, source_h,
-                          resize);
-    TRY(data.encode(scratch));
-  } else {
-    rsl::trace("Width: {}, Height: {}.", width, height);
-    u32 size = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      size += (width >> i) * (height >> i) * 4;
-      rsl::trace("Image {}: {}, {}. -> Total Size: {}", i, width >> i,
-                 height >> i, size);
-    }
-    scratch.resize(size);
-
-    u32 slide = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      librii::image::resize(std::span(scratch).subspan(slide), width >> i,
-                            height >> i, image, source_w, source_h, resize);
-      slide += (width >> i) * (height >> i) * 4;
-    }
-
-    TRY(data.encode(scratch));
-  }
-  return {};
+  rsl::trace("Width: {}, Height: {}, Mips: {}.", width, height, num_mip);
+  return librii::image::encodeMipChain(data.getData(), width, height, fmt,
+                                       num_mip, image, source_w, source_h,
+                                       resize, mip_options, cmpr_quality);
 }
 Result<void> importTexture(libcube::Texture& data, std::span<u8> image,
-                           std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                           int max_mip, int width, int height, int channels) {
+                           bool mip_gen, int min_dim, int max_mip, int width,
+                           int height, int channels,
+                           librii::image::MipGenOptions mip_options,
+                           librii::image::CmprQuality cmpr_quality,
+                           std::optional<librii::gx::TextureFormat> format) {
   if (image.empty()) {
     return std::unexpected(
         "STB failed to parse image. Unsupported file format?");
@@ -531,48 +518,101 @@ Result<void> importTexture(libcube::Texture& data, std::span<u8> image,
       ++num_mip;
   }
 
-  return importTextureImpl(data, image, scratch, num_mip, width, height, width,
-                           height, librii::gx::TextureFormat::CMPR);
+  if (!format.has_value()) {
+    format = librii::image::ChooseTextureFormat(image, width, height);
+  }
+  return importTextureImpl(data, image, num_mip, width, height, width, height,
+                           *format, librii::image::ResizingAlgorithm::Lanczos,
+                           mip_options, cmpr_quality);
 }
 
 Result<void> importTextureFromMemory(libcube::Texture& data,
-                                     std::span<const u8> span,
-                                     std::vector<u8>& scratch, bool mip_gen,
-                                     int min_dim, int max_mip) {
+                                     std::span<const u8> span, bool mip_gen,
+                                     int min_dim, int max_mip,
+                                     librii::image::MipGenOptions mip_options,
+                                     librii::image::CmprQuality cmpr_quality,
+                                     std::optional<librii::gx::TextureFormat>
+                                         format) {
   BEGINTRY
   auto image = TRY(rsl::stb::load_from_memory(span));
-  return importTexture(data, image.data, scratch, mip_gen, min_dim, max_mip,
-                       image.width, image.height, image.channels);
+  return importTexture(data, image.data, mip_gen, min_dim, max_mip,
+                       image.width, image.height, image.channels, mip_options,
+                       cmpr_quality, format);
   ENDTRY
 }
+static Result<void> importTEX0(libcube::Texture& data,
+                               const librii::g3d::TextureData& tex) {
+  data.setTextureFormat(tex.format);
+  data.setWidth(tex.width);
+  data.setHeight(tex.height);
+  data.setImageCount(tex.number_of_images);
+  data.setLod(false, 0.0f, static_cast<f32>(data.getImageCount()));
+  data.resizeData();
+  auto span = data.getData();
+  EXPECT(span.size() == tex.data.size());
+  memcpy(span.data(), tex.data.data(), span.size());
+  return {};
+}
+static librii::g3d::TextureData exportTEX0(const libcube::Texture& data) {
+  librii::g3d::TextureData tex{
+      .format = data.getTextureFormat(),
+      .width = data.getWidth(),
+      .height = data.getHeight(),
+      .number_of_images = data.getImageCount(),
+      .data = {},
+  };
+  auto span = data.getData();
+  tex.data.assign(span.begin(), span.begin() + data.getEncodedSize(true));
+  return tex;
+}
+
 Result<void> importTextureFromFile(libcube::Texture& data,
-                                   std::string_view path,
-                                   std::vector<u8>& scratch, bool mip_gen,
-                                   int min_dim, int max_mip) {
+                                   std::string_view path, bool mip_gen,
+                                   int min_dim, int max_mip,
+                                   librii::image::MipGenOptions mip_options,
+                                   librii::image::CmprQuality cmpr_quality,
+                                   std::optional<librii::gx::TextureFormat>
+                                       format,
+                                   const TextureCache* cache) {
+  auto obuf = ReadFile(path);
+  if (!obuf) {
+    return std::unexpected("Failed to read file");
+  }
   if (path.ends_with(".tex0")) {
-    auto obuf = ReadFile(path);
-    if (!obuf) {
-      return std::unexpected("Failed to read file");
-    }
     auto tex = TRY(librii::crate::ReadTEX0(*obuf));
-    data.setTextureFormat(tex.format);
-    data.setWidth(tex.width);
-    data.setHeight(tex.height);
-    data.setImageCount(tex.number_of_images);
-    data.setLod(false, 0.0f, static_cast<f32>(data.getImageCount()));
-    data.resizeData();
-    auto span = data.getData();
-    EXPECT(span.size() == tex.data.size());
-    memcpy(span.data(), tex.data.data(), span.size());
-    return {};
-  }
-  auto image = TRY(rsl::stb::load(path));
-  return importTexture(data, image.data, scratch, mip_gen, min_dim, max_mip,
-                       image.width, image.height, image.channels);
+    return importTEX0(data, tex);
+  }
+  u64 key = 0;
+  if (cache != nullptr) {
+    const TextureEncodeParams params{
+        .format = format,
+        .mip_gen = mip_gen,
+        .min_dim = min_dim,
+        .max_mip = max_mip,
+        .mip_options = mip_options,
+        .cmpr_quality = cmpr_quality,
+    };
+    key = TextureCache::computeKey(*obuf, params);
+    if (auto tex = cache->find(key)) {
+      rsl::trace("Texture cache hit: {}", path);
+      return importTEX0(data, *tex);
+    }
+  }
+  auto image = TRY(rsl::stb::load_from_memory(*obuf));
+  TRY(importTexture(data, image.data, mip_gen, min_dim, max_mip, image.width,
+                    image.height, image.channels, mip_options, cmpr_quality,
+                    format));
+  if (cache != nullptr) {
+    cache->store(key, exportTEX0(data));
+  }
+  return {};
 }
 
 void import_texture(std::string tex, libcube::Texture* pdata,
-                    std::filesystem::path file_path) {
+                    std::filesystem::path file_path,
+                    librii::image::CmprQuality cmpr_quality,
+                    std::optional<librii::gx::TextureFormat> format,
+                    const TextureCache* cache) {
   libcube::Texture& data = *pdata;
   std::vector<u8> scratch;
   bool mip_gen = true;
@@ -589,8 +629,8 @@ void import_texture(std::string tex, libcube::Texture* pdata,
 
   for (const auto& path : search_paths) {
 #ifdef __clang__
-    if (importTextureFromFile(data, path.string().c_str(), scratch, mip_gen,
-                              min_dim, max_mip)) {
+    if (importTextureFromFile(data, path.string().c_str(), mip_gen, min_dim,
+                              max_mip, {}, cmpr_quality, format, cache)) {
       return;
     }
 #endif
@@ -605,7 +645,11 @@ void import_texture(std::string tex, libcube::Texture* pdata,
   // Make a basic checkerboard
   librii::image::generateCheckerboard(scratch, dummy_width, dummy_height);
   data.setMipmapCount(0);
-  data.setTextureFormat(librii::gx::TextureFormat::CMPR);
+  if (format.has_value()) {
+    data.setTextureFormat(*format);
+  } else {
+    data.setEncoderFor(scratch);
+  }
   data.encode(scratch);
   // unresolved.emplace(i, tex);
 }
@@ -614,7 +658,10 @@ bool CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
                  std::string path,
                  std::function<void(std::string, std::string)> info,
                  std::function<void(std::string_view, float)> progress,
-                 bool tristrip, bool verbose) {
+                 bool tristrip, bool verbose,
+                 const TextureCache* texture_cache,
+                 librii::image::CmprQuality cmpr_quality,
+                 bool auto_texture_format) {
   std::set<std::string> textures_needed;
 
   for (auto& mat : rhst.materials) {
@@ -646,14 +693,22 @@ bool CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
   // Favor PNG, and the current directory
   auto file_path = std::filesystem::path(path);
 
-  std::vector<std::future<void>> futures;
+  // Textures and meshes share one bounded pool rather than a thread each
+  auto& scheduler = librii::sched::TaskScheduler::shared();
+  librii::sched::TaskGroup texture_tasks;
 
+  // Unset to choose each texture's format from its content
+  std::optional<librii::gx::TextureFormat> texture_format;
+  if (!auto_texture_format) {
+    texture_format = librii::gx::TextureFormat::CMPR;
+  }
   for (int i = 0; i < scene.getTextures().size(); ++i) {
     libcube::Texture* data = &scene.getTextures()[i];
 
-    futures.push_back(std::async(std::launch::async, [=] {
-      import_texture(data->getName(), data, file_path);
-    }));
+    scheduler.spawn(texture_tasks, [=] {
+      import_texture(data->getName(), data, file_path, cmpr_quality,
+                     texture_format, texture_cache);
+    });
   }
 
   // Optimize meshes
@@ -662,45 +717,58 @@ bool CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
     std::atomic<int> so_far = 0;
     int total = rhst.meshes.size();
     progress(std::format("Optimizing meshes ({} / {})", 0, total), 0.0f);
+    const auto mesh_done = [&] {
+      int x = ++so_far;
+      progress(std::format("Optimizing meshes ({} / {})", x, total),
+               static_cast<float>(x) / static_cast<float>(total));
+    };
 
     rsl::Timer timer;
-    for (auto& mesh : rhst.meshes) {
-      auto task = [&](librii::rhst::Mesh* mesh) {
-        assert(mesh != nullptr);
-        int i = 0;
-        for (auto& mp : mesh->matrix_primitives) {
+    // One task per matrix primitive, each of which spawns a task per
+    // algorithm; Adaptive shares the best result between those tasks. A mesh
+    // is reported once all of its primitives are done.
+    librii::sched::TaskGroup mesh_tasks;
+    std::vector<std::atomic<size_t>> remaining(rhst.meshes.size());
+    for (size_t m = 0; m < rhst.meshes.size(); ++m) {
+      auto* mesh = &rhst.meshes[m];
+      remaining[m] = mesh->matrix_primitives.size();
+      if (mesh->matrix_primitives.empty()) {
+        mesh_done();
+        continue;
+      }
+      for (size_t i = 0; i < mesh->matrix_primitives.size(); ++i) {
+        auto task = [&, m, i, mesh] {
           auto ok = librii::rhst::StripifyTriangles(
-              mp, std::nullopt,
+              mesh->matrix_primitives[i], scheduler, std::nullopt,
               mesh->matrix_primitives.size() > 1
                   ? std::format("{}::{}", mesh->name, i)
                   : mesh->name,
-              verbose);
-          ++i;
+              verbose, librii::rhst::AlgoPolicy::Adaptive);
           if (!ok) {
             rsl::error("Error: Failed to stripify mesh {}. {}", mesh->name,
                        ok.error());
           }
-        }
-        ++so_far;
-        int x = static_cast<int>(so_far);
-        progress(std::format("Optimizing meshes ({} / {})", x, total),
-                 static_cast<float>(x) / static_cast<float>(total));
-      };
-      futures.push_back(std::async(std::launch::async, std::bind(task, &mesh)));
+          if (--remaining[m] == 0) {
+            mesh_done();
+          }
+        };
+        scheduler.spawn(mesh_tasks, task);
+      }
     }
 
-    futures.clear();
-    rsl::error("Elapsed stripping time (multicore) (or texture import time if "
-               "greater): {}ms",
-               timer.elapsed());
+    scheduler.wait(mesh_tasks);
+    rsl::error("Elapsed stripping time (multicore): {}ms", timer.elapsed());
   }
+  scheduler.wait(texture_tasks);
 
   progress(std::format("Compiling meshes {}/{}", 0, rhst.meshes.size()), 0.0f);
+  libcube::VertexBufferPool vertex_pool;
   for (auto&& [i, mesh] : rsl::enumerate(rhst.meshes)) {
     progress(std::format("Compiling meshes {}/{}", i, rhst.meshes.size()),
              static_cast<float>(i) / static_cast<float>(rhst.meshes.size()));
     // Already optimized (and in parallel)
-    auto ok = compileMesh(mdl.getMeshes().add(), mesh, mdl, false);
+    auto ok = compileMesh(mdl.getMeshes().add(), mesh, mdl, false, true,
+                          &vertex_pool);
     if (!ok) {
       rsl::error("ERROR: Failed to compile mesh: {}", ok.error().c_str());
       continue;
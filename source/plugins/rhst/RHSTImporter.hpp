@@ -5,46 +5,74 @@
 #include <librii/rhst/RHST.hpp>
 #include <plugins/gc/Export/Scene.hpp>
 #include <plugins/gc/Export/Texture.hpp>
+#include <plugins/rhst/TextureCache.hpp>
 
 namespace riistudio::rhst {
 
 [[nodiscard]] Result<void>
-importTextureImpl(libcube::Texture& data, std::span<u8> image,
-                  std::vector<u8>& scratch, int num_mip, int width, int height,
-                  int first_w, int first_h, librii::gx::TextureFormat fmt,
+importTextureImpl(libcube::Texture& data, std::span<u8> image, int num_mip,
+                  int width, int height, int first_w, int first_h,
+                  librii::gx::TextureFormat fmt,
                   librii::image::ResizingAlgorithm resize =
-                      librii::image::ResizingAlgorithm::Lanczos);
-
-[[nodiscard]] Result<void> importTexture(libcube::Texture& data,
-                                         std::span<u8> image,
-                                         std::vector<u8>& scratch, bool mip_gen,
-                                         int min_dim, int max_mip, int width,
-                                         int height, int channels);
-[[nodiscard]] Result<void> importTextureFromMemory(libcube::Texture& data,
-                                                   std::span<const u8> span,
-                                                   std::vector<u8>& scratch,
-                                                   bool mip_gen, int min_dim,
-                                                   int max_mip);
-[[nodiscard]] Result<void> importTextureFromFile(libcube::Texture& data,
-                                                 std::string_view path,
-                                                 std::vector<u8>& scratch,
-                                                 bool mip_gen, int min_dim,
-                                                 int max_mip);
+                      librii::image::ResizingAlgorithm::Lanczos,
+                  librii::image::MipGenOptions mip_options = {},
+                  librii::image::CmprQuality cmpr_quality =
+                      librii::image::CmprQuality::Wimgt);
 
+//! @param[in] format Format to encode to. If std::nullopt, the smallest format
+//!                   that represents |image| well is chosen instead.
+//!
+[[nodiscard]] Result<void>
+importTexture(libcube::Texture& data, std::span<u8> image, bool mip_gen,
+              int min_dim, int max_mip, int width, int height, int channels,
+              librii::image::MipGenOptions mip_options = {},
+              librii::image::CmprQuality cmpr_quality =
+                  librii::image::CmprQuality::Wimgt,
+              std::optional<librii::gx::TextureFormat> format =
+                  librii::gx::TextureFormat::CMPR);
+[[nodiscard]] Result<void>
+importTextureFromMemory(libcube::Texture& data, std::span<const u8> span,
+                        bool mip_gen, int min_dim, int max_mip,
+                        librii::image::MipGenOptions mip_options = {},
+                        librii::image::CmprQuality cmpr_quality =
+                            librii::image::CmprQuality::Wimgt,
+                        std::optional<librii::gx::TextureFormat> format =
+                            librii::gx::TextureFormat::CMPR);
+//! If |cache| is given, images are looked up in it before being decoded, and
+//! newly encoded ones are added to it.
+[[nodiscard]] Result<void>
+importTextureFromFile(libcube::Texture& data, std::string_view path,
+                      bool mip_gen, int min_dim, int max_mip,
+                      librii::image::MipGenOptions mip_options = {},
+                      librii::image::CmprQuality cmpr_quality =
+                          librii::image::CmprQuality::Wimgt,
+                      std::optional<librii::gx::TextureFormat> format =
+                          librii::gx::TextureFormat::CMPR,
+                      const TextureCache* cache = nullptr);
+
+//! @param[in] auto_texture_format Encode each texture to the smallest format
+//!                                that represents it well, rather than CMPR.
+//!
 [[nodiscard]] bool
 CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
             std::string path,
             std::function<void(std::string, std::string)> info,
             std::function<void(std::string_view, float)> progress,
-            bool tristrip = true, bool verbose = true);
+            bool tristrip = true, bool verbose = true,
+            const TextureCache* texture_cache = nullptr,
+            librii::image::CmprQuality cmpr_quality =
+                librii::image::CmprQuality::Wimgt,
+            bool auto_texture_format = false);
 
 [[nodiscard]] Result<librii::rhst::Mesh>
 decompileMesh(const libcube::IndexedPolygon& src, const libcube::Model& mdl);
 
-[[nodiscard]] Result<void> compileMesh(libcube::IndexedPolygon& dst,
-                                       const librii::rhst::Mesh& src,
-                                       libcube::Model& model,
-                                       bool optimize = true,
-                                       bool reinit_bufs = true);
+//! @param[in] pool Vertex buffer indices to share across the meshes of one
+//!                 model. A temporary one is used if null.
+//!
+[[nodiscard]] Result<void>
+compileMesh(libcube::IndexedPolygon& dst, const librii::rhst::Mesh& src,
+            libcube::Model& model, bool optimize = true,
+            bool reinit_bufs = true, libcube::VertexBufferPool* pool = nullptr);
 
 } // namespace riistudio::rhst
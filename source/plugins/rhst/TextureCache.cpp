@@ -0,0 +1,105 @@
+#include "TextureCache.hpp"
+
+#include <core/util/oishii.hpp>
+#include <librii/crate/g3d_crate.hpp>
+#include <random>
+
+namespace riistudio::rhst {
+
+namespace {
+
+// Bump when encoder output changes, so stale entries are never hit
+constexpr u32 TextureCacheVersion = 3;
+
+// 64-bit FNV-1a
+struct Fnv1a {
+  u64 hash = 0xcbf2'9ce4'8422'2325;
+
+  void feed(std::span<const u8> bytes) {
+    for (u8 b : bytes) {
+      hash = (hash ^ b) * 0x100'0000'01b3;
+    }
+  }
+  void feed(u64 value) {
+    u8 bytes[8];
+    for (int i = 0; i < 8; ++i) {
+      bytes[i] = static_cast<u8>(value >> (i * 8));
+    }
+    feed(bytes);
+  }
+};
+
+} // namespace
+
+TextureCache::TextureCache(std::filesystem::path folder)
+    : mFolder(std::move(folder)) {}
+
+u64 TextureCache::computeKey(std::span<const u8> source,
+                             const TextureEncodeParams& params) {
+  Fnv1a h;
+  h.feed(TextureCacheVersion);
+  h.feed(source.size());
+  h.feed(source);
+  h.feed(params.format ? static_cast<u64>(*params.format) : ~u64{0});
+  h.feed(params.mip_gen);
+  h.feed(static_cast<u64>(params.min_dim));
+  h.feed(static_cast<u64>(params.max_mip));
+  h.feed(static_cast<u64>(params.mip_options.filter));
+  h.feed(params.mip_options.gamma_correct);
+  h.feed(static_cast<u64>(params.cmpr_quality));
+  return h.hash;
+}
+
+std::filesystem::path TextureCache::entryPath(u64 key) const {
+  return mFolder / std::format("{:016x}.tex0", key);
+}
+
+std::optional<librii::g3d::TextureData> TextureCache::find(u64 key) const {
+  const auto path = entryPath(key);
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    return std::nullopt;
+  }
+  auto file = ReadFile(path.string());
+  if (!file) {
+    return std::nullopt;
+  }
+  auto tex = librii::crate::ReadTEX0(*file);
+  if (!tex || tex->data.size() != librii::g3d::ComputeImageSize(*tex)) {
+    rsl::error("Ignoring corrupt texture cache entry {}", path.string());
+    return std::nullopt;
+  }
+  return std::move(*tex);
+}
+
+void TextureCache::store(u64 key, const librii::g3d::TextureData& tex) const {
+  const auto path = entryPath(key);
+  std::error_code ec;
+  std::filesystem::create_directories(mFolder, ec);
+  if (ec) {
+    rsl::error("Cannot create texture cache {}: {}", mFolder.string(),
+               ec.message());
+    return;
+  }
+  const auto buf = librii::crate::WriteTEX0(tex);
+  // Readers only ever see complete entries: write aside, then rename
+  auto tmp = path;
+  tmp += std::format(".{:08x}.tmp", std::random_device{}());
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+    if (!out) {
+      rsl::error("Cannot write texture cache entry {}", tmp.string());
+      out.close();
+      std::filesystem::remove(tmp, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    // Another import stored it first
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+} // namespace riistudio::rhst
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <core/common.h>
+#include <filesystem>
+#include <librii/g3d/data/TextureData.hpp>
+#include <librii/image/ImagePlatform.hpp>
+
+namespace riistudio::rhst {
+
+//! Everything besides the source image that determines an encoded texture.
+struct TextureEncodeParams {
+  //! Unset if the format is chosen from the image.
+  std::optional<librii::gx::TextureFormat> format =
+      librii::gx::TextureFormat::CMPR;
+  bool mip_gen = true;
+  int min_dim = 0;
+  int max_mip = 0;
+  librii::image::MipGenOptions mip_options = {};
+  librii::image::CmprQuality cmpr_quality = librii::image::CmprQuality::Wimgt;
+};
+
+//! @brief Encoded textures from earlier imports, kept on disk.
+//!
+//! Entries are TEX0 files named by a hash of the source file and its
+//! TextureEncodeParams, so an unchanged texture skips decoding and encoding
+//! entirely. Entries are written atomically, so one folder may be shared by
+//! concurrent imports and processes.
+//!
+class TextureCache {
+public:
+  explicit TextureCache(std::filesystem::path folder);
+
+  //! @brief Hash a source file's bytes with the settings it is encoded with.
+  //!
+  static u64 computeKey(std::span<const u8> source,
+                        const TextureEncodeParams& params);
+
+  //! @return The cached texture, or std::nullopt on a miss.
+  //!
+  std::optional<librii::g3d::TextureData> find(u64 key) const;
+
+  //! @brief Save an encoded texture. Failures are logged and otherwise
+  //! ignored, as the texture can always be encoded again.
+  //!
+  void store(u64 key, const librii::g3d::TextureData& tex) const;
+
+private:
+  std::filesystem::path entryPath(u64 key) const;
+
+  std::filesystem::path mFolder;
+};
+
+} // namespace riistudio::rhst
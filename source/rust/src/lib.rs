@@ -188,6 +188,18 @@ pub struct ImportCommand {
     #[clap(long)]
     preset_path: Option<String>,
 
+    /// Reuse encoded textures from this folder, adding new ones to it
+    #[clap(long)]
+    texture_cache: Option<String>,
+
+    /// CMPR encoder quality: 0 (fast), 1 (default), 2 (cluster fit, slowest)
+    #[arg(long, default_value = "1", value_parser = clap::value_parser!(u32).range(0..=2))]
+    cmpr_quality: u32,
+
+    /// Pick each texture's format from its content rather than always CMPR
+    #[clap(long, default_value="false")]
+    auto_texture_format: bool,
+
     #[clap(short, long, default_value="false")]
     verbose: bool,
 }
@@ -216,6 +228,10 @@ pub struct CompressCommand {
     /// Output file for compressed file (.szs)
     to: Option<String>,
 
+    /// Compression level: 0 (no compression, fastest), 1 (Boyer-Moore-Horspool), 2 (optimal parse, smallest)
+    #[arg(long, default_value = "1", value_parser = clap::value_parser!(u32).range(0..=2))]
+    level: u32,
+
     #[clap(short, long, default_value="false")]
     verbose: bool,
 }
@@ -276,6 +292,21 @@ pub struct CreateCommand {
     verbose: bool,
 }
 
+/// Run jobs from a manifest on a pool of worker threads.
+#[derive(Parser, Debug)]
+pub struct BatchCommand {
+    /// Manifest with one JSON job per line, e.g. {"command": "compress", "from": "a.arc", "level": 2}
+    #[arg(required=true)]
+    from: String,
+
+    /// Number of jobs to run at once (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
+
+    #[clap(short, long, default_value="false")]
+    verbose: bool,
+}
+
 #[derive(Subcommand, Debug)]
 pub enum Commands {
     /// Import a .dae/.fbx file as .brres
@@ -298,6 +329,9 @@ pub enum Commands {
 
     /// Create a .szs file from a folder.
     Create(CreateCommand),
+
+    /// Run jobs from a manifest on a pool of worker threads.
+    Batch(BatchCommand),
 }
 
 #[repr(C)]
@@ -327,6 +361,18 @@ pub struct CliOptions {
 
     // TYPE 2: "decompress"
     // Uses "from", "to" and "verbose" above
+
+    // TYPE 3: "compress"
+    pub szs_level: c_uint,
+
+    // TYPE 8: "batch"
+    // Manifest path is "from"
+    pub batch_jobs: c_uint,
+
+    // TYPE 1: "import-command"
+    pub texture_cache: [c_char; 256],
+    pub cmpr_quality: c_uint,
+    pub auto_texture_format: c_uint,
 }
 
 fn is_valid_hexcode(value: String) -> Result<(), String> {
@@ -354,9 +400,13 @@ impl MyArgs {
                 let to_bytes = i.to.as_ref().unwrap_or(&default_str).as_bytes();
                 let default_str2 = String::new();
                 let preset_str_bytes = i.preset_path.as_ref().unwrap_or(&default_str2).as_bytes();
+                let mut texture_cache2 : [i8; 256] = [0; 256];
+                let default_str3 = String::new();
+                let texture_cache_bytes = i.texture_cache.as_ref().unwrap_or(&default_str3).as_bytes();
                 from2[..from_bytes.len()].copy_from_slice(unsafe { &*(from_bytes as *const _ as *const [i8]) });
                 to2[..to_bytes.len()].copy_from_slice(unsafe { &*(to_bytes as *const _ as *const [i8]) });
                 preset_path2[..preset_str_bytes.len()].copy_from_slice(unsafe { &*(preset_str_bytes as *const _ as *const [i8]) });
+                texture_cache2[..texture_cache_bytes.len()].copy_from_slice(unsafe { &*(texture_cache_bytes as *const _ as *const [i8]) });
                 CliOptions {
                     c_type: 1,
                     from: from2,
@@ -378,6 +428,11 @@ impl MyArgs {
                     no_tristrip: i.no_tristrip as c_uint,
                     ai_json: i.ai_json as c_uint,
                     verbose: i.verbose as c_uint,
+                    szs_level: 0 as c_uint,
+                    batch_jobs: 0 as c_uint,
+                    texture_cache: texture_cache2,
+                    cmpr_quality: i.cmpr_quality as c_uint,
+                    auto_texture_format: i.auto_texture_format as c_uint,
                 }
             },
             Commands::Decompress(i) => {
@@ -411,6 +466,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_level: 0 as c_uint,
+                    batch_jobs: 0 as c_uint,
+                    texture_cache: [0; 256],
+                    cmpr_quality: 0 as c_uint,
+                    auto_texture_format: 0 as c_uint,
                 }
             },
             Commands::Compress(i) => {
@@ -444,6 +504,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_level: i.level as c_uint,
+                    batch_jobs: 0 as c_uint,
+                    texture_cache: [0; 256],
+                    cmpr_quality: 0 as c_uint,
+                    auto_texture_format: 0 as c_uint,
                 }
             },
             Commands::Rhst2Brres(i) => {
@@ -477,6 +542,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_level: 0 as c_uint,
+                    batch_jobs: 0 as c_uint,
+                    texture_cache: [0; 256],
+                    cmpr_quality: 0 as c_uint,
+                    auto_texture_format: 0 as c_uint,
                 }
             },
             Commands::Rhst2Bmd(i) => {
@@ -510,6 +580,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_level: 0 as c_uint,
+                    batch_jobs: 0 as c_uint,
+                    texture_cache: [0; 256],
+                    cmpr_quality: 0 as c_uint,
+                    auto_texture_format: 0 as c_uint,
                 }
             },
             Commands::Extract(i) => {
@@ -543,6 +618,11 @@ impl MyArgs {
                   fuse_vertices: 0 as c_uint,
                   no_tristrip: 0 as c_uint,
                   ai_json: 0 as c_uint,
+                  szs_level: 0 as c_uint,
+                  batch_jobs: 0 as c_uint,
+                  texture_cache: [0; 256],
+                  cmpr_quality: 0 as c_uint,
+                  auto_texture_format: 0 as c_uint,
               }
             },
             Commands::Create(i) => {
@@ -576,6 +656,45 @@ impl MyArgs {
                   fuse_vertices: 0 as c_uint,
                   no_tristrip: 0 as c_uint,
                   ai_json: 0 as c_uint,
+                  szs_level: 0 as c_uint,
+                  batch_jobs: 0 as c_uint,
+                  texture_cache: [0; 256],
+                  cmpr_quality: 0 as c_uint,
+                  auto_texture_format: 0 as c_uint,
+              }
+          },
+            Commands::Batch(i) => {
+              let mut from2 : [i8; 256]= [0; 256];
+              let from_bytes = i.from.as_bytes();
+              from2[..from_bytes.len()].copy_from_slice(unsafe { &*(from_bytes as *const _ as *const [i8]) });
+              CliOptions {
+                  c_type: 8,
+                  from: from2,
+                  verbose: i.verbose as c_uint,
+                  batch_jobs: i.jobs as c_uint,
+
+                  // Junk fields
+                  to: [0; 256],
+                  preset_path:  [0; 256],
+                  scale: 0.0 as c_float,
+                  brawlbox_scale: 0 as c_uint,
+                  mipmaps: 0 as c_uint,
+                  min_mip: 0 as c_uint,
+                  max_mips: 0 as c_uint,
+                  auto_transparency: 0 as c_uint,
+                  merge_mats: 0 as c_uint,
+                  bake_uvs: 0 as c_uint,
+                  tint: 0 as c_uint,
+                  cull_degenerates: 0 as c_uint,
+                  cull_invalid: 0 as c_uint,
+                  recompute_normals: 0 as c_uint,
+                  fuse_vertices: 0 as c_uint,
+                  no_tristrip: 0 as c_uint,
+                  ai_json: 0 as c_uint,
+                  szs_level: 0 as c_uint,
+                  texture_cache: [0; 256],
+                  cmpr_quality: 0 as c_uint,
+                  auto_texture_format: 0 as c_uint,
               }
           },
         }
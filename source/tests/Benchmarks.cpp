@@ -0,0 +1,698 @@
+#include "Benchmarks.hpp"
+
+// Defines the libcube types librii/j3d/J3dIo.hpp refers to
+#include <plugins/j3d/Scene.hpp>
+
+#include <core/common.h>
+#include <core/util/oishii.hpp>
+#include <librii/image/CmprEncoder.hpp>
+#include <librii/image/ImagePlatform.hpp>
+#include <librii/image/TexelEncoder.hpp>
+#include <librii/j3d/J3dIo.hpp>
+#include <librii/kcol/Builder.hpp>
+#include <librii/kcol/Query.hpp>
+#include <librii/rhst/MeshUtils.hpp>
+#include <librii/rhst/RHST.hpp>
+#include <librii/sched/TaskScheduler.hpp>
+#include <librii/szs/SZS.hpp>
+#include <librii/u8/U8.hpp>
+#include <rsl/Stb.hpp>
+
+#include <chrono>
+#include <random>
+
+IMPORT_STD;
+
+namespace {
+
+using BenchFn = int (*)(std::span<const std::string> args);
+
+// Average wall time of |f| in milliseconds
+template <typename F> double MeasureMs(F&& f, int iterations) {
+  using clock_t = std::chrono::steady_clock;
+  const auto start = clock_t::now();
+  for (int i = 0; i < iterations; ++i) {
+    f();
+  }
+  const std::chrono::duration<double, std::milli> elapsed =
+      clock_t::now() - start;
+  return elapsed.count() / iterations;
+}
+
+// Expand folders (non-recursively) into the files they contain
+std::vector<std::string> CollectFiles(std::span<const std::string> paths) {
+  std::vector<std::string> result;
+  for (auto& path : paths) {
+    if (!std::filesystem::is_directory(path)) {
+      result.push_back(path);
+      continue;
+    }
+    for (auto& it : std::filesystem::directory_iterator(path)) {
+      if (it.is_regular_file()) {
+        result.push_back(it.path().string());
+      }
+    }
+  }
+  return result;
+}
+
+// The byte-at-a-time decoder librii::szs::decode replaced. It does not check
+// backreferences, so it is only fed streams we encoded ourselves.
+void DecodeSZSReference(std::span<u8> dst, std::span<const u8> src) {
+  size_t in_position = 0x10;
+  size_t out_position = 0;
+  while (in_position < src.size() && out_position < dst.size()) {
+    const u8 header = src[in_position++];
+    for (int i = 0; i < 8; ++i) {
+      if (in_position >= src.size() || out_position >= dst.size())
+        break;
+      if (header & (1 << (7 - i))) {
+        dst[out_position++] = src[in_position++];
+        continue;
+      }
+      const u32 group = (src[in_position] << 8) | src[in_position + 1];
+      in_position += 2;
+      const u32 reverse = (group & 0xfff) + 1;
+      const u32 size =
+          (group >> 12) ? (group >> 12) + 2 : src[in_position++] + 18;
+      for (u32 j = 0; j < size; ++j, ++out_position) {
+        dst[out_position] = dst[out_position - reverse];
+      }
+    }
+  }
+}
+
+// bench szs-decode <files or folders...>
+//
+// Files that are not YAZ0 already are compressed with encodeOptimal first.
+int BenchSZSDecode(std::span<const std::string> args) {
+  constexpr int Iterations = 20;
+  double total_ref = 0.0, total_new = 0.0;
+  size_t total_bytes = 0;
+  for (auto& path : CollectFiles(args)) {
+    auto file = ReadFile(path);
+    if (!file) {
+      fmt::print(stderr, "{}\n", file.error());
+      return -1;
+    }
+    auto szs = *file;
+    if (!librii::szs::getExpandedSize(szs)) {
+      szs = librii::szs::encodeOptimal(*file);
+    }
+    const u32 size = *librii::szs::getExpandedSize(szs);
+    std::vector<u8> expected(size), actual(size);
+
+    const double ms_ref =
+        MeasureMs([&] { DecodeSZSReference(expected, szs); }, Iterations);
+    bool ok = true;
+    const double ms_new = MeasureMs(
+        [&] { ok &= librii::szs::decode(actual, szs).has_value(); },
+        Iterations);
+    if (!ok || actual != expected) {
+      fmt::print(stderr, "{}: decoders disagree\n", path);
+      return -1;
+    }
+    const auto mbps = [&](double ms) { return size / 1'000'000.0 / ms * 1e3; };
+    fmt::print("{:<48} {:>10} bytes  reference {:>8.2f} ms ({:>7.1f} MB/s)  "
+               "decode {:>8.2f} ms ({:>7.1f} MB/s)\n",
+               std::filesystem::path(path).filename().string(), size, ms_ref,
+               mbps(ms_ref), ms_new, mbps(ms_new));
+    total_ref += ms_ref;
+    total_new += ms_new;
+    total_bytes += size;
+  }
+  fmt::print(
+      "Total: {} bytes, reference {:.2f} ms, decode {:.2f} ms ({:.2f}x)\n",
+      total_bytes, total_ref, total_new, total_ref / total_new);
+  return 0;
+}
+
+// Full path of every node, as a game would query it
+std::vector<std::string> ListU8Paths(const librii::U8::U8ArchiveView& arc) {
+  std::vector<std::string> result;
+  std::vector<std::pair<u32, std::string>> stack{
+      {arc.nodes[0].folder.sibling_next, ""}};
+  for (u32 i = 1; i < arc.nodes.size(); ++i) {
+    while (stack.size() > 1 && i >= stack.back().first)
+      stack.pop_back();
+    const auto& node = arc.nodes[i];
+    const auto path = stack.back().second + std::string(node.name);
+    result.push_back(path);
+    if (node.is_folder)
+      stack.emplace_back(node.folder.sibling_next, path + "/");
+  }
+  return result;
+}
+
+// bench u8-path <files or folders...>
+//
+// Resolves every path in each archive (plus as many misses) through the
+// linear PathToEntrynum walk and through a PathIndex.
+int BenchU8Path(std::span<const std::string> args) {
+  constexpr int Iterations = 200;
+  double total_walk = 0.0, total_index = 0.0;
+  for (auto& path : CollectFiles(args)) {
+    auto file = ReadFile(path);
+    if (!file) {
+      fmt::print(stderr, "{}\n", file.error());
+      return -1;
+    }
+    auto u8 = *file;
+    if (auto size = librii::szs::getExpandedSize(u8)) {
+      u8.resize(*size);
+      if (!librii::szs::decode(u8, *file)) {
+        fmt::print(stderr, "{}: invalid YAZ0\n", path);
+        return -1;
+      }
+    }
+    auto arc = librii::U8::LoadU8ArchiveView(u8);
+    if (!arc || arc->nodes.empty()) {
+      fmt::print(stderr, "{}: not a U8 archive\n", path);
+      continue;
+    }
+    auto queries = ListU8Paths(*arc);
+    for (size_t i = 0, n = queries.size(); i < n; ++i) {
+      queries.push_back(queries[i] + ".missing");
+    }
+
+    librii::U8::PathIndex index;
+    const double ms_build = MeasureMs(
+        [&] { index = librii::U8::PathIndex(*arc); }, Iterations);
+    std::vector<s32> expected(queries.size()), actual(queries.size());
+    const double ms_walk = MeasureMs(
+        [&] {
+          for (size_t i = 0; i < queries.size(); ++i)
+            expected[i] = librii::U8::PathToEntrynum(*arc, queries[i].c_str());
+        },
+        Iterations);
+    const double ms_index = MeasureMs(
+        [&] {
+          for (size_t i = 0; i < queries.size(); ++i)
+            actual[i] =
+                librii::U8::PathToEntrynum(*arc, index, queries[i].c_str());
+        },
+        Iterations);
+    if (actual != expected) {
+      fmt::print(stderr, "{}: index and PathToEntrynum disagree\n", path);
+      return -1;
+    }
+    fmt::print("{:<48} {:>6} nodes {:>6} lookups  walk {:>8.4f} ms  "
+               "index {:>8.4f} ms (+{:.4f} ms build)\n",
+               std::filesystem::path(path).filename().string(),
+               arc->nodes.size(), queries.size(), ms_walk, ms_index,
+               ms_build);
+    total_walk += ms_walk;
+    total_index += ms_index;
+  }
+  fmt::print("Total: walk {:.4f} ms, index {:.4f} ms ({:.2f}x)\n", total_walk,
+             total_index, total_walk / total_index);
+  return 0;
+}
+
+// bench rhst-strip <.rhst files or folders...>
+//
+// Stripifies every matrix primitive with the exhaustive and the adaptive
+// policy, one primitive at a time on the shared scheduler, like the importer.
+int BenchRHSTStrip(std::span<const std::string> args) {
+  using namespace librii::rhst;
+  auto& scheduler = librii::sched::TaskScheduler::shared();
+  double total_exhaustive = 0.0, total_adaptive = 0.0;
+  for (auto& path : CollectFiles(args)) {
+    auto file = ReadFile(path);
+    if (!file) {
+      fmt::print(stderr, "{}\n", file.error());
+      return -1;
+    }
+    auto tree = ReadSceneTree(*file);
+    if (!tree) {
+      fmt::print(stderr, "{}: {}\n", path, tree.error());
+      continue;
+    }
+    size_t prims = 0, vertices = 0;
+    double ms_exhaustive = 0.0, ms_adaptive = 0.0;
+    for (auto& mesh : tree->meshes) {
+      auto triangulated = MeshUtils::TriangulateMesh(mesh);
+      if (!triangulated) {
+        fmt::print(stderr, "{}: {}\n", mesh.name, triangulated.error());
+        return -1;
+      }
+      for (auto& mp : triangulated->matrix_primitives) {
+        MatrixPrimitive exhaustive = mp, adaptive = mp;
+        ms_exhaustive += MeasureMs(
+            [&] {
+              (void)StripifyTriangles(exhaustive, scheduler, std::nullopt,
+                                      mesh.name, false,
+                                      AlgoPolicy::Exhaustive);
+            },
+            1);
+        ms_adaptive += MeasureMs(
+            [&] {
+              (void)StripifyTriangles(adaptive, scheduler, std::nullopt,
+                                      mesh.name, false, AlgoPolicy::Adaptive);
+            },
+            1);
+        if (VertexCount(exhaustive) != VertexCount(adaptive)) {
+          fmt::print(stderr, "{}: policies disagree ({} vs {} vertices)\n",
+                     mesh.name, VertexCount(exhaustive),
+                     VertexCount(adaptive));
+          return -1;
+        }
+        ++prims;
+        vertices += VertexCount(adaptive);
+      }
+    }
+    fmt::print("{:<48} {:>5} prims {:>8} vertices  exhaustive {:>10.2f} ms  "
+               "adaptive {:>10.2f} ms\n",
+               std::filesystem::path(path).filename().string(), prims,
+               vertices, ms_exhaustive, ms_adaptive);
+    total_exhaustive += ms_exhaustive;
+    total_adaptive += ms_adaptive;
+  }
+  fmt::print("Total: exhaustive {:.2f} ms, adaptive {:.2f} ms ({:.2f}x)\n",
+             total_exhaustive, total_adaptive,
+             total_exhaustive / total_adaptive);
+  return 0;
+}
+
+// bench tex-encode [width height]
+//
+// Encodes a random image to every direct color format with each instruction
+// set the CPU supports, checking them against the scalar reference.
+int BenchTexEncode(std::span<const std::string> args) {
+  using librii::image::EncoderIsa;
+  constexpr int Iterations = 20;
+  const u32 width = args.size() >= 2 ? std::stoul(args[0]) : 1024;
+  const u32 height = args.size() >= 2 ? std::stoul(args[1]) : 1024;
+  // Whole blocks are read past the last row
+  std::vector<u8> image((width + 8) * (height + 8) * 4);
+  std::mt19937 rng(0);
+  for (auto& x : image) {
+    x = static_cast<u8>(rng());
+  }
+
+  using enum librii::gx::TextureFormat;
+  const auto best = librii::image::GetBestEncoderIsa();
+  for (auto format : {I4, I8, IA4, IA8, RGB565, RGB5A3, RGBA8}) {
+    const auto size = librii::image::getEncodedSize(width, height, format);
+    std::vector<u8> expected(size), actual(size);
+    std::string line = std::format("{:<8}", magic_enum::enum_name(format));
+    double ms_scalar = 0.0;
+    for (auto isa : magic_enum::enum_values<EncoderIsa>()) {
+      if (isa > best) {
+        break;
+      }
+      auto& out = isa == EncoderIsa::Scalar ? expected : actual;
+      const double ms = MeasureMs(
+          [&] {
+            librii::image::EncodeTexels(out.data(), image.data(), width,
+                                        height, format, isa);
+          },
+          Iterations);
+      if (isa == EncoderIsa::Scalar) {
+        ms_scalar = ms;
+      } else if (actual != expected) {
+        fmt::print(stderr, "{}: {} disagrees with scalar\n",
+                   magic_enum::enum_name(format), magic_enum::enum_name(isa));
+        return -1;
+      }
+      line += std::format("  {} {:>8.3f} ms ({:.2f}x)",
+                          magic_enum::enum_name(isa), ms, ms_scalar / ms);
+    }
+    fmt::print("{}\n", line);
+  }
+  return 0;
+}
+
+// Gradients, fine noise and a transparent hole, so every sub-block mode and
+// a range of block complexities are exercised
+std::vector<u8> MakeCmprTestImage(u32 width, u32 height) {
+  std::vector<u8> image(width * height * 4);
+  std::mt19937 rng(0);
+  for (u32 y = 0; y < height; ++y) {
+    for (u32 x = 0; x < width; ++x) {
+      u8* px = &image[(y * width + x) * 4];
+      const int noise = static_cast<int>(rng() % 24) - 12;
+      const int dx = static_cast<int>(x) - static_cast<int>(width / 2);
+      const int dy = static_cast<int>(y) - static_cast<int>(height / 2);
+      const int r = static_cast<int>(x * 255 / width) + noise;
+      const int g = static_cast<int>(y * 255 / height) + noise;
+      px[0] = static_cast<u8>(std::clamp(r, 0, 255));
+      px[1] = static_cast<u8>(std::clamp(g, 0, 255));
+      px[2] = static_cast<u8>((x ^ y) & 0xff);
+      px[3] = dx * dx + dy * dy < static_cast<int>(width * height / 16) ? 0
+                                                                        : 0xff;
+    }
+  }
+  return image;
+}
+
+// Pad to whole 8x8 blocks by repeating the last column and row, as
+// librii::image::encodeMipChain does for CMPR levels
+std::vector<u8> PadCmprImage(std::span<const u8> image, u32 width, u32 height,
+                             u32 padded_width, u32 padded_height) {
+  std::vector<u8> padded(padded_width * padded_height * 4);
+  for (u32 y = 0; y < padded_height; ++y) {
+    for (u32 x = 0; x < padded_width; ++x) {
+      const u32 sx = std::min(x, width - 1), sy = std::min(y, height - 1);
+      memcpy(&padded[(y * padded_width + x) * 4],
+             &image[(sy * width + sx) * 4], 4);
+    }
+  }
+  return padded;
+}
+
+// PSNR of the RGB channels of the opaque pixels
+double CmprPSNR(std::span<const u8> expected, std::span<const u8> actual) {
+  double sse = 0.0;
+  size_t samples = 0;
+  for (size_t i = 0; i + 3 < expected.size(); i += 4) {
+    if (!(expected[i + 3] & 0x80)) {
+      continue;
+    }
+    for (size_t c = 0; c < 3; ++c) {
+      const double d = double(expected[i + c]) - double(actual[i + c]);
+      sse += d * d;
+    }
+    samples += 3;
+  }
+  if (sse == 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return 10.0 * std::log10(255.0 * 255.0 * samples / sse);
+}
+
+// bench cmpr [image files or folders...]
+//
+// Encodes each image (or a generated 1024x1024 one) with every CMPR quality
+// tier, serially and sharded across the task scheduler, and reports the
+// throughput and PSNR of each.
+int BenchCMPR(std::span<const std::string> args) {
+  using librii::image::CmprQuality;
+  constexpr int Iterations = 3;
+  struct Image {
+    std::string name;
+    std::vector<u8> data;
+    u32 width, height;
+  };
+  std::vector<Image> images;
+  for (auto& path : CollectFiles(args)) {
+    auto loaded = rsl::stb::load(path);
+    if (!loaded) {
+      fmt::print(stderr, "{}: {}\n", path, loaded.error());
+      return -1;
+    }
+    images.push_back(Image{
+        .name = std::filesystem::path(path).filename().string(),
+        .data = std::move(loaded->data),
+        .width = static_cast<u32>(loaded->width),
+        .height = static_cast<u32>(loaded->height),
+    });
+  }
+  if (images.empty()) {
+    images.push_back(Image{.name = "(generated)",
+                           .data = MakeCmprTestImage(1024, 1024),
+                           .width = 1024,
+                           .height = 1024});
+  }
+
+  for (auto& image : images) {
+    const u32 width = roundUp(image.width, 8);
+    const u32 height = roundUp(image.height, 8);
+    const auto source =
+        PadCmprImage(image.data, image.width, image.height, width, height);
+    const auto size = librii::image::getEncodedSize(
+        width, height, librii::gx::TextureFormat::CMPR);
+    std::vector<u8> serial(size), parallel(size);
+    std::vector<u8> decoded(width * height * 4);
+    fmt::print("{} ({}x{})\n", image.name, image.width, image.height);
+    for (auto quality : magic_enum::enum_values<CmprQuality>()) {
+      const double ms_serial = MeasureMs(
+          [&] {
+            librii::image::EncodeDXT1(serial.data(), source.data(), width,
+                                      height, quality, false);
+          },
+          Iterations);
+      const double ms_parallel = MeasureMs(
+          [&] {
+            librii::image::EncodeDXT1(parallel.data(), source.data(), width,
+                                      height, quality, true);
+          },
+          Iterations);
+      if (serial != parallel) {
+        fmt::print(stderr, "{}: serial and parallel output differ\n",
+                   magic_enum::enum_name(quality));
+        return -1;
+      }
+      librii::image::decode(decoded.data(), serial.data(), width, height,
+                            librii::gx::TextureFormat::CMPR);
+      const auto mpps = [&](double ms) {
+        return width * height / 1'000'000.0 / ms * 1e3;
+      };
+      fmt::print("  {:<8} serial {:>9.2f} ms ({:>7.2f} MP/s)  parallel "
+                 "{:>9.2f} ms ({:>7.2f} MP/s)  PSNR {:>6.2f} dB\n",
+                 magic_enum::enum_name(quality), ms_serial, mpps(ms_serial),
+                 ms_parallel, mpps(ms_parallel), CmprPSNR(source, decoded));
+    }
+  }
+  return 0;
+}
+
+// Rolling hills of about 32k triangles, with attributes in stripes
+librii::kcol::KCollisionData MakeKclTestCourse() {
+  constexpr int Cells = 128;
+  constexpr float Spacing = 100.0f;
+  const auto height = [](float x, float z) {
+    return 800.0f * std::sin(x * 0.0007f) * std::cos(z * 0.0005f) +
+           300.0f * std::sin(x * 0.003f + z * 0.002f);
+  };
+  const auto vertex = [&](int i, int j) {
+    const float x = i * Spacing, z = j * Spacing;
+    return glm::vec3(x, height(x, z), z);
+  };
+  std::vector<librii::kcol::KclTriangle> triangles;
+  for (int i = 0; i < Cells; ++i) {
+    for (int j = 0; j < Cells; ++j) {
+      const u16 attribute = static_cast<u16>((i / 16) % 8);
+      triangles.push_back(
+          {{vertex(i, j), vertex(i, j + 1), vertex(i + 1, j)}, attribute});
+      triangles.push_back({{vertex(i + 1, j), vertex(i, j + 1),
+                            vertex(i + 1, j + 1)},
+                           attribute});
+    }
+  }
+  return *librii::kcol::BuildKCollisionData(triangles);
+}
+
+// bench kcl-query [course.kcl]
+//
+// Casts rays and tests spheres against the collision through
+// KCollisionQuery's octree and by testing every prism, checking that they
+// agree. Without a file, a generated course is used.
+int BenchKclQuery(std::span<const std::string> args) {
+  using namespace librii::kcol;
+  constexpr int Queries = 2000;
+  KCollisionData kcl;
+  if (!args.empty()) {
+    auto file = ReadFile(args[0]);
+    if (!file) {
+      fmt::print(stderr, "{}\n", file.error());
+      return -1;
+    }
+    if (auto err = ReadKCollisionData(kcl, *file, file->size());
+        !err.empty()) {
+      fmt::print(stderr, "{}: {}\n", args[0], err);
+      return -1;
+    }
+  } else {
+    kcl = MakeKclTestCourse();
+  }
+  std::optional<KCollisionQuery> query;
+  const double ms_decode = MeasureMs(
+      [&] {
+        auto q = KCollisionQuery::Make(kcl);
+        if (q) {
+          query = std::move(*q);
+        } else {
+          fmt::print(stderr, "{}\n", q.error());
+        }
+      },
+      1);
+  if (!query) {
+    return -1;
+  }
+
+  glm::vec3 lo = kcl.pos_data.empty() ? glm::vec3(0.0f) : kcl.pos_data[0];
+  glm::vec3 hi = lo;
+  for (auto& p : kcl.pos_data) {
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+  std::mt19937 rng(0);
+  const auto in_bounds = [&] {
+    glm::vec3 p;
+    for (int i = 0; i < 3; ++i) {
+      p[i] = std::uniform_real_distribution<float>(lo[i], hi[i])(rng);
+    }
+    return p;
+  };
+  struct Ray {
+    glm::vec3 origin, dir;
+  };
+  std::vector<Ray> rays(Queries);
+  for (auto& ray : rays) {
+    // From above, mostly downward, as an editor's picking rays are
+    ray.origin = in_bounds();
+    ray.origin.y = hi.y + 1000.0f;
+    ray.dir = glm::normalize(in_bounds() - ray.origin);
+  }
+  std::vector<glm::vec3> spheres(Queries);
+  std::ranges::generate(spheres, in_bounds);
+  const float radius = kcl.sphere_radius;
+
+  const u32 num_prisms = query->numPrisms();
+  std::vector<float> expected(Queries), actual(Queries);
+  const double ms_ray_brute = MeasureMs(
+      [&] {
+        for (int i = 0; i < Queries; ++i) {
+          float best = -1.0f;
+          for (u32 p = 0; p < num_prisms; ++p) {
+            auto t = query->intersectRay(p, rays[i].origin, rays[i].dir,
+                                         best < 0.0f ? 1e30f : best);
+            if (t) {
+              best = *t;
+            }
+          }
+          expected[i] = best;
+        }
+      },
+      1);
+  const double ms_ray = MeasureMs(
+      [&] {
+        for (int i = 0; i < Queries; ++i) {
+          auto hit = query->rayCast(rays[i].origin, rays[i].dir);
+          actual[i] = hit ? hit->distance : -1.0f;
+        }
+      },
+      1);
+  if (actual != expected) {
+    fmt::print(stderr, "Ray casts disagree with brute force\n");
+    return -1;
+  }
+
+  std::vector<std::vector<KclSphereHit>> brute(Queries), tree(Queries);
+  const double ms_sphere_brute = MeasureMs(
+      [&] {
+        for (int i = 0; i < Queries; ++i) {
+          brute[i].clear();
+          for (u32 p = 0; p < num_prisms; ++p) {
+            if (auto hit = query->intersectSphere(p, spheres[i], radius)) {
+              brute[i].push_back(*hit);
+            }
+          }
+        }
+      },
+      1);
+  const double ms_sphere = MeasureMs(
+      [&] {
+        for (int i = 0; i < Queries; ++i) {
+          tree[i].clear();
+          query->sphereTest(tree[i], spheres[i], radius);
+        }
+      },
+      1);
+  // Files from other encoders may omit prisms the game never needed
+  int sphere_mismatches = 0;
+  for (int i = 0; i < Queries; ++i) {
+    const auto prisms = [](const std::vector<KclSphereHit>& hits) {
+      std::vector<u16> result;
+      for (auto& hit : hits) {
+        result.push_back(hit.prism);
+      }
+      std::ranges::sort(result);
+      return result;
+    };
+    sphere_mismatches += prisms(brute[i]) != prisms(tree[i]);
+  }
+
+  fmt::print("{} prisms, decoded in {:.2f} ms\n", num_prisms, ms_decode);
+  fmt::print("  {} rays     brute force {:>9.2f} ms  octree {:>8.2f} ms "
+             "({:.1f}x)\n",
+             Queries, ms_ray_brute, ms_ray, ms_ray_brute / ms_ray);
+  fmt::print("  {} spheres  brute force {:>9.2f} ms  octree {:>8.2f} ms "
+             "({:.1f}x), {} differ\n",
+             Queries, ms_sphere_brute, ms_sphere, ms_sphere_brute / ms_sphere,
+             sphere_mismatches);
+  return 0;
+}
+
+// bench bmd-write <files or folders...>
+//
+// Rewrites each BMD/BDL through the oishii Linker, which resolves every
+// section offset by symbol. Other files in the folders are skipped. Run at
+// two revisions to compare writer time.
+int BenchBMDWrite(std::span<const std::string> args) {
+  constexpr int Iterations = 5;
+  double total_ms = 0.0;
+  for (auto& path : CollectFiles(args)) {
+    const auto ext = std::filesystem::path(path).extension().string();
+    if (ext != ".bmd" && ext != ".bdl") {
+      continue;
+    }
+    auto file = ReadFile(path);
+    if (!file) {
+      fmt::print(stderr, "{}\n", file.error());
+      return -1;
+    }
+    oishii::BinaryReader reader(*file, path, std::endian::big);
+    kpi::LightIOTransaction trans;
+    trans.callback = [](auto, auto, auto) {};
+    auto model = librii::j3d::J3dModel::read(reader, trans);
+    if (!model) {
+      fmt::print(stderr, "{}: {}\n", path, model.error());
+      return -1;
+    }
+
+    std::vector<u8> out;
+    bool ok = true;
+    const double ms = MeasureMs(
+        [&] {
+          oishii::Writer writer(0);
+          ok &= model->write(writer).has_value();
+          out = writer.takeBuf();
+        },
+        Iterations);
+    if (!ok) {
+      fmt::print(stderr, "{}: failed to write\n", path);
+      return -1;
+    }
+    fmt::print("{:<48} {:>10} bytes  write {:>8.2f} ms\n",
+               std::filesystem::path(path).filename().string(), out.size(),
+               ms);
+    total_ms += ms;
+  }
+  fmt::print("Total: write {:.2f} ms\n", total_ms);
+  return 0;
+}
+
+const std::map<std::string_view, BenchFn> sBenchmarks{
+    {"bmd-write", BenchBMDWrite},
+    {"cmpr", BenchCMPR},
+    {"kcl-query", BenchKclQuery},
+    {"rhst-strip", BenchRHSTStrip},
+    {"szs-decode", BenchSZSDecode},
+    {"tex-encode", BenchTexEncode},
+    {"u8-path", BenchU8Path},
+};
+
+} // namespace
+
+int RunBenchmark(std::span<const std::string> args) {
+  if (args.empty() || !sBenchmarks.contains(args[0])) {
+    fmt::print(stderr, "Usage: tests bench <name> [args...]\nBenchmarks:\n");
+    for (auto& [name, _] : sBenchmarks) {
+      fmt::print(stderr, "  {}\n", name);
+    }
+    return -1;
+  }
+  return sBenchmarks.at(args[0])(args.subspan(1));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+//! @brief Run a named benchmark: `tests bench <name> [args...]`.
+//!
+//! @return Process exit code.
+//!
+int RunBenchmark(std::span<const std::string> args);
@@ -1,3 +1,4 @@
+#include "Benchmarks.hpp"
 #include <core/util/oishii.hpp>
 #include <librii/egg/BDOF.hpp>
 #include <librii/egg/Blight.hpp>
@@ -228,6 +229,14 @@ int main(int argc, const char** argv) {
   ANNOUNCE("Initializing plugins");
   InitAPI();
 
+  if (argc > 1 && !strcmp(argv[1], "bench")) {
+    ANNOUNCE("Running benchmark");
+    std::vector<std::string> args(argv + 2, argv + argc);
+    int result = RunBenchmark(args);
+    DeinitAPI();
+    return result;
+  }
+
   ANNOUNCE("Performing tasks");
   if (argc < 3) {
     fprintf(stderr,